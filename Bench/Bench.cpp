@@ -0,0 +1,154 @@
+/// \file Bench.cpp
+/// \brief Code for the benchmark task descriptors and the benchmark report
+/// CReport.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <iomanip>
+
+#include "Bench.h"
+#include "Timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Task descriptors.
+
+/// Perform the empty task, which means doing nothing at all.
+
+void CEmptyTask::Perform(){
+} //Perform
+
+/// Constructor.
+/// \param n Amount of work in units, see CalibrateSpin().
+
+CSpinTask::CSpinTask(uint64_t n): m_nWork(n){
+} //constructor
+
+/// Perform the spin task.
+
+void CSpinTask::Perform(){
+  m_nResult = Spin(m_nWork);
+} //Perform
+
+/// Reader function for the result.
+/// \return The result of the work.
+
+const uint64_t CSpinTask::GetResult() const{
+  return m_nResult;
+} //GetResult
+
+/// Do some work that uses the CPU but not memory. Each unit of work is one
+/// step of a linear congruential generator, which depends on the last, so
+/// the compiler can neither skip it nor do the steps in parallel.
+/// \param n Amount of work in units.
+/// \return Result of the work.
+
+uint64_t Spin(uint64_t n){
+  uint64_t x = n; //state
+
+  for(uint64_t i=0; i<n; i++)
+    x = x*6364136223846793005ULL + 1442695040888963407ULL;
+
+  return x;
+} //Spin
+
+/// Measure how many units of work Spin() does per microsecond on this
+/// machine, so that the benchmarks can ask for tasks of a given duration.
+/// \return Units of work per microsecond, at least 1.
+
+uint64_t CalibrateSpin(){
+  const uint64_t n = 1 << 22; //units of work
+  volatile uint64_t x = 0; //result, to keep the work from being optimized away
+
+  const uint64_t t = GetSteadyTimeNs(); //start time
+  x = Spin(n);
+  const uint64_t dt = GetSteadyTimeNs() - t; //elapsed time
+  (void)x;
+
+  return std::max<uint64_t>(1, 1000*n/std::max<uint64_t>(1, dt));
+} //CalibrateSpin
+
+///////////////////////////////////////////////////////////////////////////////
+// CReport code.
+
+/// Constructor.
+/// \param nCpus Number of CPUs available, for the record.
+
+CReport::CReport(size_t nCpus): m_nCpus(nCpus){
+} //constructor
+
+/// Add a result to the report.
+/// \param r A result.
+
+void CReport::Add(const CResult& r){
+  m_vResult.push_back(r);
+} //Add
+
+/// Write the report as comma-separated values, with a header line.
+/// \param out Output stream.
+
+void CReport::WriteCSV(std::ostream& out) const{
+  out << "bench,variant,threads,cpus,ops,elapsed_ns,cpu_ns,ns_per_op,"
+    "cpu_ns_per_op,ops_per_sec,speedup,efficiency,imbalance" << std::endl;
+
+  out << std::fixed << std::setprecision(3);
+
+  for(const CResult& r: m_vResult){
+    const double nOps = (double)std::max<uint64_t>(1, r.m_nOps); //ops
+    const double t = (double)std::max<uint64_t>(1, r.m_nElapsedNs); //time
+
+    out << r.m_strBench << ',' << r.m_strVariant << ',' << r.m_nThreads << 
+      ',' << m_nCpus << ',' << r.m_nOps << ',' << r.m_nElapsedNs << ',' << 
+      r.m_nCpuNs << ',' << r.m_nElapsedNs/nOps << ',' << r.m_nCpuNs/nOps <<
+      ',' << 1e9*nOps/t << ',' << r.m_fSpeedup << ',' << r.m_fEfficiency << 
+      ',' << r.m_fImbalance << std::endl;
+  } //for
+} //WriteCSV
+
+/// Write the report as JSON, an object containing the number of CPUs and
+/// an array of results.
+/// \param out Output stream.
+
+void CReport::WriteJSON(std::ostream& out) const{
+  out << std::fixed << std::setprecision(3);
+  out << "{\n  \"cpus\": " << m_nCpus << ",\n  \"results\": [";
+
+  for(size_t i=0; i<m_vResult.size(); i++){
+    const CResult& r = m_vResult[i]; //current result
+    const double nOps = (double)std::max<uint64_t>(1, r.m_nOps); //ops
+    const double t = (double)std::max<uint64_t>(1, r.m_nElapsedNs); //time
+
+    out << (i > 0? ",": "") << "\n    {\"bench\": \"" << r.m_strBench << 
+      "\", \"variant\": \"" << r.m_strVariant << "\", \"threads\": " << 
+      r.m_nThreads << ", \"ops\": " << r.m_nOps << ", \"elapsed_ns\": " << 
+      r.m_nElapsedNs << ", \"cpu_ns\": " << r.m_nCpuNs << 
+      ", \"ns_per_op\": " << r.m_nElapsedNs/nOps << 
+      ", \"cpu_ns_per_op\": " << r.m_nCpuNs/nOps << 
+      ", \"ops_per_sec\": " << 1e9*nOps/t << 
+      ", \"speedup\": " << r.m_fSpeedup << 
+      ", \"efficiency\": " << r.m_fEfficiency << 
+      ", \"imbalance\": " << r.m_fImbalance << "}";
+  } //for
+
+  out << "\n  ]\n}" << std::endl;
+} //WriteJSON
@@ -0,0 +1,122 @@
+/// \file Bench.h
+/// \brief Interface for the benchmark task descriptors, the benchmark
+/// report CReport, and the benchmarks.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef __Bench_h__
+#define __Bench_h__
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+#include "BaseTask.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Task descriptors.
+
+/// \brief Empty task.
+///
+/// A task descriptor whose Perform() does nothing, so that the time taken
+/// to insert, perform, and process it is all overhead. It derives from
+/// CStaticTask so that Perform() is called directly.
+
+class CEmptyTask final: public CBaseTask, public CStaticTask<CEmptyTask>{
+  public:
+    void Perform(); ///< Perform the task.
+}; //CEmptyTask
+
+/// \brief Spin task.
+///
+/// A task descriptor whose Perform() spins for a given amount of work,
+/// without touching memory, so that it costs CPU time but nothing else.
+
+class CSpinTask final: public CBaseTask, public CStaticTask<CSpinTask>{
+  private:
+    uint64_t m_nWork = 0; ///< Amount of work in units.
+    uint64_t m_nResult = 0; ///< Result, to keep the work from being optimized away.
+
+  public:
+    CSpinTask(uint64_t); ///< Constructor.
+
+    void Perform(); ///< Perform the task.
+    const uint64_t GetResult() const; ///< Get result.
+}; //CSpinTask
+
+uint64_t Spin(uint64_t); ///< Do some work.
+uint64_t CalibrateSpin(); ///< Units of work per microsecond.
+
+///////////////////////////////////////////////////////////////////////////////
+// CReport definition.
+
+/// \brief Benchmark result.
+///
+/// The result of running one variant of one benchmark with a given number
+/// of threads. The speedup, efficiency, and imbalance are 0 when they do not
+/// apply to the benchmark.
+
+struct CResult{
+  std::string m_strBench; ///< Benchmark name.
+  std::string m_strVariant; ///< Variant name.
+  size_t m_nThreads = 0; ///< Number of threads.
+  uint64_t m_nOps = 0; ///< Number of tasks or queue operations.
+  uint64_t m_nElapsedNs = 0; ///< Elapsed time.
+  uint64_t m_nCpuNs = 0; ///< CPU time used by the process.
+  double m_fSpeedup = 0; ///< Speedup over 1 thread.
+  double m_fEfficiency = 0; ///< Speedup divided by number of threads.
+  double m_fImbalance = 0; ///< Busiest thread over average, from CStats.
+}; //CResult
+
+/// \brief Benchmark report.
+///
+/// A list of benchmark results that can be written as CSV, with one line
+/// per result after a header line, or as JSON, with an array of objects.
+/// Both include the elapsed time per operation and the throughput, so that
+/// the output of different runs can be compared by a script to catch
+/// regressions.
+
+class CReport{
+  private:
+    std::vector<CResult> m_vResult; ///< Results.
+    size_t m_nCpus = 0; ///< Number of CPUs available.
+
+  public:
+    CReport(size_t); ///< Constructor.
+
+    void Add(const CResult&); ///< Add a result.
+    void WriteCSV(std::ostream&) const; ///< Write as CSV.
+    void WriteJSON(std::ostream&) const; ///< Write as JSON.
+}; //CReport
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmarks.
+
+void BenchOverhead(CReport&, const std::vector<size_t>&, size_t); ///< Empty tasks.
+void BenchQueue(CReport&, const std::vector<size_t>&, size_t); ///< Queues.
+void BenchScaling(CReport&, const std::vector<size_t>&, size_t, uint64_t); ///< Scaling.
+void BenchSkew(CReport&, size_t, size_t, uint64_t); ///< Skewed costs.
+
+#endif //__Bench_h__
@@ -0,0 +1,294 @@
+/// \file Benchmarks.cpp
+/// \brief Code for the benchmarks.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+#include "Bench.h"
+#include "Timer.h"
+#include "BaseThreadManager.h"
+#include "ThreadSafeQueue.h"
+#include "LockFreeQueue.h"
+#include "PriorityQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helper functions.
+
+/// Perform a list of task descriptors with a thread manager and time it.
+/// The threads are spawned in persistent mode and results are processed by
+/// a consumer thread in streaming mode while the task descriptors are
+/// inserted, so that the bounded CLockFreeQueue never fills up. The task
+/// descriptors are deleted as they are processed.
+/// \tparam CThreadManager Thread manager.
+/// \tparam CTaskClass Task descriptor.
+/// \param tm Thread manager, with its settings already made.
+/// \param vTask Task descriptors.
+/// \param bBatch true to insert all of the task descriptors at once.
+/// \param r [OUT] Result, whose elapsed and CPU times are filled in.
+
+template <class CThreadManager, class CTaskClass>
+void Run(CThreadManager& tm, std::vector<CTaskClass*>& vTask, bool bBatch,
+  CResult& r)
+{
+  CTimer timer; //timer for elapsed and CPU time
+
+  tm.SetPersistent(true);
+  tm.Spawn();
+  tm.StartStreaming();
+
+  if(bBatch)
+    tm.InsertBatch(vTask.begin(), vTask.end());
+
+  else for(CTaskClass* p: vTask)
+    tm.Insert(p);
+
+  tm.Stop();
+  tm.Wait();
+  tm.StopStreaming();
+  tm.Process(); //anything that arrived after streaming stopped
+
+  r.m_nElapsedNs = timer.GetElapsedTimeNs();
+  r.m_nCpuNs = timer.GetCPUTimeNs();
+  r.m_nOps = vTask.size();
+  vTask.clear();
+} //Run
+
+/// Run the empty task benchmark for one variant and one number of threads.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param report Report that the result is added to.
+/// \param strVariant Name of variant.
+/// \param nThreads Number of threads.
+/// \param n Number of task descriptors.
+/// \param nBatch Batch size, see CBaseThreadManager::SetBatchSize().
+/// \param bStealing true for work-stealing mode.
+/// \param bBuffers true for per-thread result buffers.
+
+template <class CQueueClass>
+void RunOverhead(CReport& report, const std::string& strVariant, 
+  size_t nThreads, size_t n, size_t nBatch, bool bStealing, bool bBuffers)
+{
+  CBaseThreadManager<CEmptyTask, CQueueClass> tm; //thread manager
+  tm.SetNumThreads(nThreads);
+  tm.SetBatchSize(nBatch);
+  tm.SetWorkStealing(bStealing);
+  tm.SetResultBuffers(bBuffers);
+
+  std::vector<CEmptyTask*> vTask(n); //task descriptors
+
+  for(CEmptyTask*& p: vTask)
+    p = new CEmptyTask;
+
+  CResult r; //result
+  r.m_strBench = "overhead";
+  r.m_strVariant = strVariant;
+  r.m_nThreads = nThreads;
+  Run(tm, vTask, nBatch > 1, r);
+  report.Add(r);
+} //RunOverhead
+
+/// Run the queue benchmark for one queue and one number of threads. Half
+/// of the threads insert into the queue as fast as they can and half
+/// delete from it as fast as they can, so that every operation contends
+/// with the others.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param report Report that the result is added to.
+/// \param strVariant Name of variant.
+/// \param nPairs Number of producer threads and of consumer threads.
+/// \param n Number of insertions per producer.
+
+template <class CQueueClass>
+void RunQueue(CReport& report, const std::string& strVariant, 
+  size_t nPairs, size_t n)
+{
+  CQueueClass q; //the queue
+  CEmptyTask task; //the same task descriptor is inserted over and over
+  const size_t nTotal = nPairs*n; //total number of insertions
+  std::atomic<size_t> nDeleted(0); //number of deletions so far
+  std::vector<std::thread> vThread; //producers and consumers
+
+  CTimer timer; //timer for elapsed and CPU time
+
+  for(size_t i=0; i<nPairs; i++){
+    vThread.push_back(std::thread([&](){ //producer
+      for(size_t j=0; j<n; j++)
+        q.Insert(&task);
+    }));
+
+    vThread.push_back(std::thread([&](){ //consumer
+      CEmptyTask* p = nullptr; //deleted task descriptor
+
+      while(nDeleted.load(std::memory_order_relaxed) < nTotal)
+        if(q.Delete(p))nDeleted++;
+        else std::this_thread::yield();
+    }));
+  } //for
+
+  for(std::thread& t: vThread)
+    t.join();
+
+  CResult r; //result
+  r.m_strBench = "queue";
+  r.m_strVariant = strVariant;
+  r.m_nThreads = 2*nPairs;
+  r.m_nOps = 2*nTotal; //insertions and deletions
+  r.m_nElapsedNs = timer.GetElapsedTimeNs();
+  r.m_nCpuNs = timer.GetCPUTimeNs();
+  report.Add(r);
+} //RunQueue
+
+/// Make a list of spin task descriptors.
+/// \param n Number of task descriptors.
+/// \param nWork Amount of work in each.
+/// \param v [OUT] Task descriptors.
+
+static void MakeSpinTasks(size_t n, uint64_t nWork, std::vector<CSpinTask*>& v){
+  v.resize(n);
+
+  for(CSpinTask*& p: v)
+    p = new CSpinTask(nWork);
+} //MakeSpinTasks
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmarks.
+
+/// Measure the overhead of inserting, performing, and processing empty task
+/// descriptors, for the shared request queue, the lock-free queue, batches,
+/// work-stealing mode, and per-thread result buffers.
+/// \param report Report that the results are added to.
+/// \param vThreads Numbers of threads to try.
+/// \param n Number of task descriptors.
+
+void BenchOverhead(CReport& report, const std::vector<size_t>& vThreads,
+  size_t n)
+{
+  typedef CThreadSafeQueue<CEmptyTask*> CQueue; //shorthand
+  typedef CLockFreeQueue<CEmptyTask*> CLFQueue; //shorthand
+
+  for(size_t t: vThreads){
+    RunOverhead<CQueue>(report, "queue", t, n, 1, false, false);
+    RunOverhead<CLFQueue>(report, "lockfree", t, n, 1, false, false);
+    RunOverhead<CQueue>(report, "batch64", t, n, 64, false, false);
+    RunOverhead<CQueue>(report, "stealing", t, n, 1, true, false);
+    RunOverhead<CQueue>(report, "buffers", t, n, 1, false, true);
+  } //for
+} //BenchOverhead
+
+/// Measure the throughput of the queues under contention from producer and
+/// consumer threads.
+/// \param report Report that the results are added to.
+/// \param vThreads Numbers of threads to try, which are rounded up to even.
+/// \param n Number of insertions per producer.
+
+void BenchQueue(CReport& report, const std::vector<size_t>& vThreads, 
+  size_t n)
+{
+  size_t nLast = 0; //last number of pairs tried
+
+  for(size_t t: vThreads){
+    const size_t nPairs = std::max<size_t>(1, (t + 1)/2); //producer-consumer pairs
+    if(nPairs == nLast)continue; //already done
+    nLast = nPairs;
+
+    RunQueue<CThreadSafeQueue<CEmptyTask*>>(report, "threadsafe", nPairs, n);
+    RunQueue<CLockFreeQueue<CEmptyTask*>>(report, "lockfree", nPairs, n);
+    RunQueue<CPriorityQueue<CEmptyTask*>>(report, "priority", nPairs, n);
+  } //for
+} //BenchQueue
+
+/// Measure how the time taken to perform a fixed amount of work scales with
+/// the number of threads. The speedup is relative to the first number of
+/// threads tried, which should be 1.
+/// \param report Report that the results are added to.
+/// \param vThreads Numbers of threads to try, in increasing order.
+/// \param n Number of task descriptors.
+/// \param nWork Amount of work in each task.
+
+void BenchScaling(CReport& report, const std::vector<size_t>& vThreads,
+  size_t n, uint64_t nWork)
+{
+  uint64_t nBase = 0; //elapsed time for the first number of threads
+
+  for(size_t t: vThreads){
+    CBaseThreadManager<CSpinTask> tm; //thread manager
+    tm.SetNumThreads(t);
+
+    std::vector<CSpinTask*> vTask; //task descriptors
+    MakeSpinTasks(n, nWork, vTask);
+
+    CResult r; //result
+    r.m_strBench = "scaling";
+    r.m_strVariant = "spin";
+    r.m_nThreads = t;
+    Run(tm, vTask, false, r);
+
+    if(nBase == 0) 
+      nBase = r.m_nElapsedNs*vThreads[0];
+
+    r.m_fSpeedup = (double)nBase/std::max<uint64_t>(1, r.m_nElapsedNs);
+    r.m_fEfficiency = r.m_fSpeedup/t;
+    report.Add(r);
+  } //for
+} //BenchScaling
+
+/// Measure how well the thread manager copes with tasks of very different
+/// costs. Task costs are drawn from a heavy-tailed distribution in which
+/// a few tasks cost a hundred times as much as most, and in which the
+/// expensive tasks are bunched together, for the shared request queue,
+/// large batches, and work-stealing mode. Statistics are collected so that
+/// the load imbalance can be reported.
+/// \param report Report that the results are added to.
+/// \param nThreads Number of threads.
+/// \param n Number of task descriptors.
+/// \param nWork Amount of work in most tasks.
+
+void BenchSkew(CReport& report, size_t nThreads, size_t n, uint64_t nWork){
+  const char* strVariant[3] = {"queue", "batch16", "stealing"}; //variant names
+
+  for(size_t v=0; v<3; v++){
+    CBaseThreadManager<CSpinTask> tm; //thread manager
+    tm.SetNumThreads(nThreads);
+    tm.SetBatchSize(v == 1? 16: 1);
+    tm.SetWorkStealing(v == 2);
+    tm.SetStats(true);
+
+    std::minstd_rand prng(12345); //same costs for every variant
+    std::vector<CSpinTask*> vTask(n); //task descriptors
+
+    for(size_t i=0; i<n; i++){ //every 16th run of 16 has a heavy tail
+      const bool bHeavy = (i/16)%16 == 0 && prng()%4 == 0; //expensive task
+      vTask[i] = new CSpinTask(bHeavy? 100*nWork: nWork);
+    } //for
+
+    CResult r; //result
+    r.m_strBench = "skew";
+    r.m_strVariant = strVariant[v];
+    r.m_nThreads = nThreads;
+    Run(tm, vTask, v == 1, r);
+    r.m_fImbalance = tm.GetStats().GetImbalance();
+    report.Add(r);
+  } //for
+} //BenchSkew
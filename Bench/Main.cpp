@@ -0,0 +1,90 @@
+/// \file Main.cpp
+/// \brief Every program has to have a `main()`.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include "Bench.h"
+#include "Affinity.h"
+
+/// \brief Main.
+///
+/// Run the benchmarks and write the results to the standard output as CSV,
+/// or as JSON if the command line includes `-json`. The numbers of threads
+/// tried are the powers of 2 up to the number of CPUs available, and the
+/// number of CPUs itself, which can be overridden with `-threads n`. The
+/// command line option `-quick` makes every benchmark ten times smaller.
+/// Progress is reported to the standard error so that the standard output
+/// can be redirected to a file, for example
+///
+///     ./Bench -json > results.json
+///
+/// \param argc Number of command line arguments.
+/// \param argv Command line arguments.
+/// \return 0 (What could possibly go wrong?)
+
+int main(int argc, char* argv[]){
+  bool bJSON = false; //true for JSON, false for CSV
+  size_t nScale = 10; //size of benchmarks
+  size_t nMaxThreads = GetNumAvailableCpus(); //max number of threads
+
+  for(int i=1; i<argc; i++){ //parse command line
+    const std::string s = argv[i]; //current argument
+
+    if(s == "-json")bJSON = true;
+    else if(s == "-quick")nScale = 1;
+    else if(s == "-threads" && i + 1 < argc)
+      nMaxThreads = std::max(1, atoi(argv[++i]));
+  } //for
+
+  std::vector<size_t> vThreads; //numbers of threads to try
+
+  for(size_t t=1; t<nMaxThreads; t*=2)
+    vThreads.push_back(t);
+
+  vThreads.push_back(nMaxThreads);
+
+  const uint64_t nPerUs = CalibrateSpin(); //units of work per microsecond
+  CReport report(GetNumAvailableCpus()); //benchmark report
+
+  std::cerr << "Overhead" << std::endl;
+  BenchOverhead(report, vThreads, 20000*nScale);
+
+  std::cerr << "Queue" << std::endl;
+  BenchQueue(report, vThreads, 20000*nScale);
+
+  std::cerr << "Scaling" << std::endl;
+  BenchScaling(report, vThreads, 200*nScale*nMaxThreads, 20*nPerUs);
+
+  std::cerr << "Skew" << std::endl;
+  BenchSkew(report, nMaxThreads, 200*nScale*nMaxThreads, 5*nPerUs);
+
+  if(bJSON)report.WriteJSON(std::cout);
+  else report.WriteCSV(std::cout);
+
+  return 0;
+} //main
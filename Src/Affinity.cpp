@@ -0,0 +1,439 @@
+/// \file Affinity.cpp
+/// \brief Code for the CPU topology class CTopology and the thread
+/// placement and node-local memory functions.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <new>
+#include <cmath>
+
+#include "Affinity.h"
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  #include <windows.h>
+#else //g++, *nix
+  #include <sched.h>
+  #include <pthread.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+#endif
+
+static thread_local size_t g_nCurrentNode = max_size_t; ///< Node of thread.
+
+///////////////////////////////////////////////////////////////////////////////
+// Helper functions.
+
+#if !defined(_MSC_VER) //g++, *nix
+
+/// Parse a Linux CPU or node list such as "0-3,8,10-11".
+/// \param s List as a string.
+/// \return List of numbers in it.
+
+static std::vector<size_t> ParseList(const std::string& s){
+  std::vector<size_t> v; //result
+  std::istringstream in(s); //for reading s
+  std::string item; //one comma-separated item
+
+  while(std::getline(in, item, ',')){
+    size_t lo = 0, hi = 0; //range
+    char dash = 0; //dash between lo and hi
+    std::istringstream range(item); //for reading item
+
+    if(!(range >> lo))continue; //skip blanks
+
+    if(range >> dash >> hi && dash == '-')
+      for(size_t i=lo; i<=hi; i++)v.push_back(i);
+    else v.push_back(lo);
+  } //while
+
+  return v;
+} //ParseList
+
+/// Read the first line of a file.
+/// \param path Path to the file.
+/// \param s [OUT] The first line.
+/// \return true if the file could be read.
+
+static bool ReadLine(const std::string& path, std::string& s){
+  std::ifstream in(path);
+  return (bool)std::getline(in, s);
+} //ReadLine
+
+/// Read a number from a file.
+/// \param path Path to the file.
+/// \param n [OUT] The number.
+/// \return true if the file could be read.
+
+static bool ReadNumber(const std::string& path, size_t& n){
+  std::ifstream in(path);
+  return (bool)(in >> n);
+} //ReadNumber
+
+#endif //g++, *nix
+
+///////////////////////////////////////////////////////////////////////////////
+// CTopology code.
+
+/// Constructor.
+
+CTopology::CTopology(){
+  Detect();
+} //constructor
+
+/// Detect the topology.
+
+void CTopology::Detect(){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  const size_t n = std::min<size_t>(64, std::thread::hardware_concurrency());
+
+  for(size_t i=0; i<n; i++){ //one group of up to 64 CPUs
+    m_vCpu.push_back(i);
+    m_vNode.push_back(0);
+    m_vCore.push_back(i);
+    m_vSibling.push_back(0);
+  } //for
+
+  ULONG nHighest = 0; //highest node number
+
+  if(GetNumaHighestNodeNumber(&nHighest))
+    for(ULONG node=0; node<=nHighest; node++){
+      ULONGLONG mask = 0; //CPUs in node
+
+      if(GetNumaNodeProcessorMask((UCHAR)node, &mask))
+        for(size_t i=0; i<n; i++)
+          if(mask & (1ULL << i))m_vNode[i] = node;
+    } //for
+
+#else //g++, *nix
+  cpu_set_t set; //allowed CPUs
+  CPU_ZERO(&set);
+
+  if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    for(size_t i=0; i<CPU_SETSIZE; i++)
+      if(CPU_ISSET(i, &set))m_vCpu.push_back(i);
+
+  if(m_vCpu.empty()) //fall back to all of them
+    for(size_t i=0; i<std::thread::hardware_concurrency(); i++)
+      m_vCpu.push_back(i);
+
+  const size_t n = m_vCpu.size(); //number of CPUs
+  const std::string strSys = "/sys/devices/system/"; //sysfs root
+
+  m_vNode.assign(n, 0);
+  m_vCore.resize(n);
+  m_vSibling.assign(n, 0);
+
+  std::string s; //line read from file
+
+  if(ReadLine(strSys + "node/online", s))
+    for(size_t node: ParseList(s))
+      if(ReadLine(strSys + "node/node" + std::to_string(node) + "/cpulist", s))
+        for(size_t cpu: ParseList(s))
+          for(size_t i=0; i<n; i++)
+            if(m_vCpu[i] == cpu)m_vNode[i] = node;
+
+  for(size_t i=0; i<n; i++){ //cores
+    const std::string strTop = strSys + "cpu/cpu" + 
+      std::to_string(m_vCpu[i]) + "/topology/"; //topology directory
+    size_t package = 0, core = 0; //package and core identifiers
+
+    if(ReadNumber(strTop + "physical_package_id", package) && 
+      ReadNumber(strTop + "core_id", core))
+      m_vCore[i] = (package << 20) | core;
+    else m_vCore[i] = ((size_t)1 << 40) | m_vCpu[i]; //own core
+
+    for(size_t j=0; j<i; j++) //count earlier siblings
+      if(m_vCore[j] == m_vCore[i])m_vSibling[i]++;
+  } //for
+#endif
+
+  m_vNodeId = m_vNode;
+  std::sort(m_vNodeId.begin(), m_vNodeId.end());
+  m_vNodeId.erase(std::unique(m_vNodeId.begin(), m_vNodeId.end()), 
+    m_vNodeId.end());
+} //Detect
+
+/// Reader function for the number of CPUs this process may run on.
+/// \return Number of allowed CPUs.
+
+const size_t CTopology::GetNumCpus() const{
+  return m_vCpu.size();
+} //GetNumCpus
+
+/// Reader function for the number of NUMA nodes that have CPUs that this
+/// process may run on.
+/// \return Number of nodes.
+
+const size_t CTopology::GetNumNodes() const{
+  return m_vNodeId.size();
+} //GetNumNodes
+
+/// Get the NUMA node of a CPU.
+/// \param cpu CPU number.
+/// \return Node number, or max_size_t if the CPU is not allowed.
+
+const size_t CTopology::GetNode(size_t cpu) const{
+  for(size_t i=0; i<m_vCpu.size(); i++)
+    if(m_vCpu[i] == cpu)return m_vNode[i];
+
+  return max_size_t;
+} //GetNode
+
+/// Plan where to place a number of threads. Compact placement puts
+/// consecutive threads on hyperthreads of the same core, then on cores of
+/// the same node, so that threads that share data share caches. Scatter
+/// placement puts consecutive threads on different nodes, then on
+/// different cores, using second hyperthreads only when the cores run out,
+/// so that each thread gets as much cache and memory bandwidth as
+/// possible. Explicit placement pins each thread to the next CPU in a
+/// given list. Per-node placement splits the threads into one contiguous
+/// block per node and lets each thread run anywhere in its node. If there
+/// are more threads than CPUs, then the plan wraps around.
+/// \param e Placement policy.
+/// \param nThreads Number of threads.
+/// \param vExplicit CPU list for explicit placement.
+/// \param vCpuSet [OUT] CPUs for each thread, empty for no pinning.
+/// \param vNode [OUT] Node for each thread, max_size_t if unknown.
+
+void CTopology::Plan(eAffinity e, size_t nThreads, 
+  const std::vector<size_t>& vExplicit, 
+  std::vector<std::vector<size_t>>& vCpuSet, std::vector<size_t>& vNode) const
+{
+  const size_t n = m_vCpu.size(); //number of CPUs
+  const size_t nNodes = m_vNodeId.size(); //number of nodes
+
+  vCpuSet.assign(nThreads, std::vector<size_t>());
+  vNode.assign(nThreads, nNodes == 1? m_vNodeId[0]: max_size_t);
+
+  if(n == 0)return; //safety
+
+  std::vector<size_t> vOrder(n); //CPU indices in placement order
+
+  for(size_t i=0; i<n; i++)
+    vOrder[i] = i;
+
+  switch(e){
+    case eAffinity::None: 
+      return;
+
+    case eAffinity::Compact: 
+      std::sort(vOrder.begin(), vOrder.end(), [&](size_t a, size_t b){
+        if(m_vNode[a] != m_vNode[b])return m_vNode[a] < m_vNode[b];
+        if(m_vCore[a] != m_vCore[b])return m_vCore[a] < m_vCore[b];
+        return m_vSibling[a] < m_vSibling[b];
+      });
+    break;
+
+    case eAffinity::Scatter: {
+      std::vector<size_t> vRank(n, 0); //rank within node among siblings
+
+      for(size_t i=0; i<n; i++)
+        for(size_t j=0; j<n; j++)
+          if(m_vNode[j] == m_vNode[i] && m_vSibling[j] == m_vSibling[i] &&
+            m_vCore[j] < m_vCore[i])vRank[i]++;
+
+      std::sort(vOrder.begin(), vOrder.end(), [&](size_t a, size_t b){
+        if(m_vSibling[a] != m_vSibling[b])return m_vSibling[a] < m_vSibling[b];
+        if(vRank[a] != vRank[b])return vRank[a] < vRank[b];
+        return m_vNode[a] < m_vNode[b];
+      });
+    } //case
+    break;
+
+    case eAffinity::Explicit: 
+      for(size_t i=0; i<nThreads && !vExplicit.empty(); i++){
+        const size_t cpu = vExplicit[i%vExplicit.size()]; //next CPU
+        vCpuSet[i].push_back(cpu);
+        vNode[i] = GetNode(cpu);
+      } //for
+    return;
+
+    case eAffinity::PerNode: 
+      for(size_t i=0; i<nThreads; i++){
+        vNode[i] = m_vNodeId[i*nNodes/nThreads]; //contiguous blocks
+
+        for(size_t j=0; j<n; j++)
+          if(m_vNode[j] == vNode[i])vCpuSet[i].push_back(m_vCpu[j]);
+      } //for
+    return;
+  } //switch
+
+  for(size_t i=0; i<nThreads; i++){ //compact or scatter
+    const size_t j = vOrder[i%n]; //CPU index
+    vCpuSet[i].push_back(m_vCpu[j]);
+    vNode[i] = m_vNode[j];
+  } //for
+} //Plan
+
+///////////////////////////////////////////////////////////////////////////////
+// Placement and node-local memory functions.
+
+/// Get the number of CPUs that this process can actually use. This is the
+/// number of CPUs in its affinity mask, further limited under Linux by any
+/// CPU quota imposed by its control group, as is usual in containers. Both
+/// cgroup v2 (`cpu.max`) and cgroup v1 (`cpu.cfs_quota_us` and
+/// `cpu.cfs_period_us`) quotas are understood, and a fractional quota is
+/// rounded up. If nothing is known, then this is the number of hardware
+/// threads, and it is always at least 1.
+/// \return Number of available CPUs.
+
+const size_t GetNumAvailableCpus(){
+  size_t n = std::thread::hardware_concurrency(); //number of CPUs
+
+#if !defined(_MSC_VER) //g++, *nix
+  cpu_set_t set; //allowed CPUs
+  CPU_ZERO(&set);
+
+  if(sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+    n = (size_t)CPU_COUNT(&set);
+
+  double quota = 0, period = 0; //CPU quota and period
+  std::string s; //line read from file
+  std::string strPath; //path to this process's cgroup
+
+  std::ifstream in("/proc/self/cgroup");
+
+  while(std::getline(in, s)) //look for the cgroup v2 entry
+    if(s.compare(0, 3, "0::") == 0)
+      strPath = s.substr(3);
+
+  if((ReadLine("/sys/fs/cgroup" + strPath + "/cpu.max", s) ||
+    ReadLine("/sys/fs/cgroup/cpu.max", s)) && s.compare(0, 3, "max") != 0)
+  { //cgroup v2
+    std::istringstream line(s);
+    line >> quota >> period;
+  } //if
+
+  else{ //cgroup v1
+    std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+    std::ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    quotaFile >> quota;
+    periodFile >> period;
+  } //else
+
+  if(quota > 0 && period > 0) //limited by quota
+    n = std::min(n, (size_t)std::ceil(quota/period));
+#endif
+
+  return std::max<size_t>(1, n);
+} //GetNumAvailableCpus
+
+/// Pin the calling thread to a set of CPUs.
+/// \param vCpu List of CPUs.
+/// \return true if it succeeded.
+
+bool PinCurrentThread(const std::vector<size_t>& vCpu){
+  if(vCpu.empty())return false;
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  DWORD_PTR mask = 0; //affinity mask
+
+  for(size_t cpu: vCpu)
+    if(cpu < 8*sizeof(DWORD_PTR))mask |= (DWORD_PTR)1 << cpu;
+
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+
+#else //g++, *nix
+  cpu_set_t set; //affinity set
+  CPU_ZERO(&set);
+
+  for(size_t cpu: vCpu)
+    if(cpu < CPU_SETSIZE)CPU_SET(cpu, &set);
+
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+} //PinCurrentThread
+
+/// Set the NUMA node that the calling thread runs on. This is called by
+/// threads spawned with a placement policy, after pinning themselves.
+/// \param node Node number, or max_size_t if unknown.
+
+void SetCurrentNode(size_t node){
+  g_nCurrentNode = node;
+} //SetCurrentNode
+
+/// Get the NUMA node that the calling thread runs on, as set by
+/// SetCurrentNode().
+/// \return Node number, or max_size_t if unknown.
+
+const size_t GetCurrentNode(){
+  return g_nCurrentNode;
+} //GetCurrentNode
+
+/// Allocate memory whose pages are placed on a given NUMA node, as far as
+/// the operating system allows. Under Linux the memory is mapped directly
+/// and bound to the node with the `mbind` system call, so no NUMA library
+/// is needed. Under Windows `VirtualAllocExNuma` is used. The memory is
+/// page-aligned, so this is meant for large blocks such as slabs.
+/// \param n Number of bytes.
+/// \param node Node number, or max_size_t for no preference.
+/// \return Pointer to the memory. Throws `std::bad_alloc` on failure.
+
+void* AllocateOnNode(size_t n, size_t node){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  void* p = node == max_size_t?
+    VirtualAlloc(nullptr, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE):
+    VirtualAllocExNuma(GetCurrentProcess(), nullptr, n, 
+      MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD)node);
+
+  if(p == nullptr)
+    throw std::bad_alloc();
+
+#else //g++, *nix
+  void* p = mmap(nullptr, n, PROT_READ | PROT_WRITE, 
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if(p == MAP_FAILED)
+    throw std::bad_alloc();
+
+  #if defined(SYS_mbind)
+    const unsigned long MPOL_PREFERRED = 1; //from linux/mempolicy.h
+
+    if(node < 8*sizeof(unsigned long)){ //bind, ignoring failure
+      const unsigned long mask = 1UL << node; //node mask
+      syscall(SYS_mbind, p, n, MPOL_PREFERRED, &mask, 8*sizeof(mask) + 1, 0);
+    } //if
+  #endif
+#endif
+
+  return p;
+} //AllocateOnNode
+
+/// Free memory allocated by AllocateOnNode().
+/// \param p Pointer to the memory.
+/// \param n Number of bytes, as passed to AllocateOnNode().
+
+void FreeOnNode(void* p, size_t n){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  VirtualFree(p, 0, MEM_RELEASE);
+#else //g++, *nix
+  munmap(p, n);
+#endif
+} //FreeOnNode
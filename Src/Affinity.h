@@ -0,0 +1,96 @@
+/// \file Affinity.h
+/// \brief Interface for the CPU topology class CTopology and the thread
+/// placement and node-local memory functions.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __Affinity_h__
+#define __Affinity_h__
+
+#include <vector>
+#include <cstddef>
+
+#include "BaseTask.h"
+
+constexpr size_t MAX_NUMA_NODES = 16; ///< Max NUMA nodes with own pools.
+
+/// \brief Thread placement policy.
+///
+/// How CBaseThreadManager::Spawn() pins its threads to CPUs.
+
+enum class eAffinity{
+  None, ///< Leave placement to the operating system.
+  Compact, ///< Fill one core, then one node, before moving to the next.
+  Scatter, ///< Spread across nodes first, then cores, then hyperthreads.
+  Explicit, ///< Pin to a given list of CPUs in turn.
+  PerNode ///< Split threads evenly among nodes, each free within its node.
+}; //eAffinity
+
+///////////////////////////////////////////////////////////////////////////////
+// CTopology definition.
+
+/// \brief CPU topology.
+///
+/// The CPUs that this process is allowed to run on, and for each of them
+/// its NUMA node, its core, and its index among the hyperthreads of that
+/// core. Under Linux this is read from `/sys/devices/system`, and under
+/// Windows from the NUMA node processor masks. Anything that cannot be
+/// found is assumed to be the simplest case, that is, one node and one
+/// hyperthread per core.
+
+class CTopology{
+  private:
+    std::vector<size_t> m_vCpu; ///< Allowed CPUs.
+    std::vector<size_t> m_vNode; ///< Node of each allowed CPU.
+    std::vector<size_t> m_vCore; ///< Core of each allowed CPU.
+    std::vector<size_t> m_vSibling; ///< Index of CPU within its core.
+    std::vector<size_t> m_vNodeId; ///< Nodes that have allowed CPUs.
+
+    void Detect(); ///< Detect topology.
+
+  public:
+    CTopology(); ///< Constructor.
+
+    const size_t GetNumCpus() const; ///< Get number of allowed CPUs.
+    const size_t GetNumNodes() const; ///< Get number of nodes with CPUs.
+    const size_t GetNode(size_t) const; ///< Get node of a CPU.
+
+    void Plan(eAffinity, size_t, const std::vector<size_t>&, 
+      std::vector<std::vector<size_t>>&, 
+      std::vector<size_t>&) const; ///< Plan thread placement.
+}; //CTopology
+
+///////////////////////////////////////////////////////////////////////////////
+// Placement and node-local memory functions.
+
+const size_t GetNumAvailableCpus(); ///< Get number of usable CPUs.
+bool PinCurrentThread(const std::vector<size_t>&); ///< Pin to CPUs.
+
+void SetCurrentNode(size_t); ///< Set NUMA node of this thread.
+const size_t GetCurrentNode(); ///< Get NUMA node of this thread.
+
+void* AllocateOnNode(size_t, size_t); ///< Allocate memory on a node.
+void FreeOnNode(void*, size_t); ///< Free memory from AllocateOnNode().
+
+#endif //__Affinity_h__
@@ -27,12 +27,48 @@
 
 std::atomic<size_t> CBaseTask::m_nNumTasks{0}; ///< Number of tasks
 
+static thread_local const std::atomic<bool>* g_pStopFlag = nullptr; ///< Stop.
+
+///////////////////////////////////////////////////////////////////////////////
+// CStopToken code.
+
+/// The default constructor makes a stop token that never reports a stop.
+
+CStopToken::CStopToken(){
+} //constructor
+
+/// Constructor.
+/// \param p Pointer to the stop flag.
+
+CStopToken::CStopToken(const std::atomic<bool>* p): m_pStop(p){
+} //constructor
+
+/// Check whether a stop has been requested. The load is relaxed, since
+/// only the flag itself matters and not anything written before it was set.
+/// \return true if a stop has been requested.
+
+const bool CStopToken::StopRequested() const{
+  return m_pStop != nullptr && m_pStop->load(std::memory_order_relaxed);
+} //StopRequested
+
+///////////////////////////////////////////////////////////////////////////////
+// CBaseTask code.
+
 /// The default constructor.
 
-CBaseTask::CBaseTask(){
+CBaseTask::CBaseTask(): m_nNumPending(1){
   m_nTaskId = m_nNumTasks++; //set task identifier to next task
 } //constructor
 
+/// The destructor is virtual so that `delete` calls the destructor of the
+/// most derived class, and the sized `operator delete` of CPooledTask is
+/// given the size of the most derived class. It deletes the list of
+/// successors, if there is one.
+
+CBaseTask::~CBaseTask(){
+  delete m_pSuccessor;
+} //destructor
+
 /// Perform the task. This function is a stub that is to be overridden in
 /// derived classes.
 
@@ -61,3 +97,109 @@ void CBaseTask::SetThreadId(const size_t id){
 const size_t CBaseTask::GetThreadId() const{
   return m_nThreadId;
 } //GetThreadId
+
+/// Set the NUMA node identifier. This is to be called by the processing
+/// thread.
+/// \param id Identifier of the NUMA node of the processing thread.
+
+void CBaseTask::SetNodeId(const size_t id){
+  m_nNodeId = id;
+} //SetNodeId
+
+/// Reader function for the NUMA node identifier. If the processing thread
+/// was not placed on a node, then this will be a very large number.
+/// \return The NUMA node identifier.
+
+const size_t CBaseTask::GetNodeId() const{
+  return m_nNodeId;
+} //GetNodeId
+
+/// Set the priority. This must be called before the task descriptor is
+/// inserted into the thread manager.
+/// \param n Priority, higher is more urgent.
+
+void CBaseTask::SetPriority(const size_t n){
+  m_nPriority = n;
+} //SetPriority
+
+/// Reader function for the priority.
+/// \return The priority.
+
+const size_t CBaseTask::GetPriority() const{
+  return m_nPriority;
+} //GetPriority
+
+/// Set the enqueue time. This is to be called by the thread manager or by
+/// a thread when the task descriptor becomes ready to be performed, and
+/// only if statistics are being collected.
+/// \param t Steady clock time in nanoseconds, from GetSteadyTimeNs().
+
+void CBaseTask::SetEnqueueTime(const uint64_t t){
+  m_nEnqueueTime = t;
+} //SetEnqueueTime
+
+/// Reader function for the enqueue time. This is zero unless the thread
+/// manager is collecting statistics.
+/// \return Steady clock time in nanoseconds when this task became ready.
+
+const uint64_t CBaseTask::GetEnqueueTime() const{
+  return m_nEnqueueTime;
+} //GetEnqueueTime
+
+/// Add a task that must not be performed until this one has been. This
+/// must be called before either task is inserted into the thread manager.
+/// The list of successors is allocated when the first one is added.
+/// \param p Pointer to the task that depends on this one.
+
+void CBaseTask::AddSuccessor(CBaseTask* p){
+  p->m_nNumPending++;
+
+  if(m_pSuccessor == nullptr) //first successor
+    m_pSuccessor = new std::vector<CBaseTask*>;
+
+  m_pSuccessor->push_back(p);
+} //AddSuccessor
+
+/// Reader function for the tasks that depend on this one.
+/// \return Reference to the list of pointers to successor tasks, which is
+/// empty if there are none.
+
+const std::vector<CBaseTask*>& CBaseTask::GetSuccessors() const{
+  static const std::vector<CBaseTask*> vNone; //no successors
+
+  return m_pSuccessor? *m_pSuccessor: vNone;
+} //GetSuccessors
+
+/// Count down the pending dependencies of this task, once when it is
+/// inserted and once when each of its predecessors has been performed.
+/// \return true if that was the last one, so the task is now ready.
+
+bool CBaseTask::SatisfyDependency(){
+  return m_nNumPending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+} //SatisfyDependency
+
+/// Check whether the thread manager that the calling thread belongs to has
+/// been asked to stop. A long-running Perform() should call this every so
+/// often and return early if it is true. This is false if the calling
+/// thread does not belong to a thread manager.
+/// \return true if a stop has been requested.
+
+const bool CBaseTask::StopRequested(){
+  return g_pStopFlag != nullptr && g_pStopFlag->load(std::memory_order_relaxed);
+} //StopRequested
+
+/// Get a stop token for the calling thread, which can be handed to code
+/// that is not part of a task descriptor, or to a thread of its own.
+/// \return The stop token of the calling thread's thread manager.
+
+CStopToken CBaseTask::GetStopToken(){
+  return CStopToken(g_pStopFlag);
+} //GetStopToken
+
+/// Set the stop flag polled by StopRequested() in the calling thread. This
+/// is called by each thread when it starts.
+/// \param p Pointer to the stop flag, or nullptr for none.
+
+void CBaseTask::SetStopFlag(const std::atomic<bool>* p){
+  g_pStopFlag = p;
+} //SetStopFlag
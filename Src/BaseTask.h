@@ -28,9 +28,32 @@
 
 #include <limits>
 #include <atomic>
+#include <vector>
 #include <cstddef>
+#include <cstdint>
 
 constexpr size_t max_size_t = std::numeric_limits<size_t>::max(); ///< Max size_t.
+constexpr size_t CACHE_LINE_SIZE = 64; ///< Assumed cache line size in bytes.
+
+/// \brief Stop token.
+///
+/// A stop token is a cheap, copyable view of a thread manager's stop flag,
+/// which is set by CBaseThreadManager::RequestStop() and the functions that
+/// call it. A long-running task can poll StopRequested() every so often and
+/// give up early when it returns true, which is what lets a busy thread
+/// pool be stopped within milliseconds. Polling costs a relaxed atomic load.
+/// A default-constructed stop token never reports a stop.
+
+class CStopToken{
+  private:
+    const std::atomic<bool>* m_pStop = nullptr; ///< Stop flag, if any.
+
+  public:
+    CStopToken(); ///< Default constructor.
+    explicit CStopToken(const std::atomic<bool>*); ///< Constructor.
+
+    const bool StopRequested() const; ///< Has a stop been requested?
+}; //CStopToken
 
 /// \brief Base task descriptor.
 ///
@@ -41,27 +64,68 @@ constexpr size_t max_size_t = std::numeric_limits<size_t>::max(); ///< Max size_
 ///
 /// Your task descriptor should implement a constructor for any task-related
 /// initialization and it should override function Perform() with the code to
-/// perform your task. Each task descriptor you instantiate will automatically 
-/// get a unique task identifier m_nTaskId which can be read using GetTaskId().
-/// This is maintained using a private static atomic member variable 
-/// m_nNumTasks that is incremented and copied to m_nTaskId by the CBaseTask
-/// constructor. It is recommended that you do not interfere with this process.
+/// perform your task. The destructor is virtual, so a task descriptor of a
+/// class derived from yours is destroyed properly when the thread manager
+/// deletes it through a pointer to your class. Each task descriptor you
+/// instantiate will automatically get a unique task identifier m_nTaskId
+/// which can be read using GetTaskId(). This is maintained using a private
+/// static atomic member variable m_nNumTasks that is incremented and copied
+/// to m_nTaskId by the CBaseTask constructor. It is recommended that you do
+/// not interfere with this process.
 /// You are responsible for setting the thread identifier by calling
 /// SetThreadId() when this task descriptor is assigned to a thread. The thread
 /// identifier can be read later by calling GetThreadId(). The task and thread
 /// identifiers are there for debugging purposes and do not impose a 
-/// significant load on time or memory requirements.
+/// significant load on time or memory requirements. Similarly, the NUMA
+/// node identifier is set by the thread to the node that it was placed on
+/// by CBaseThreadManager::SetAffinity(), and can be read with GetNodeId()
+/// by Perform() to choose node-local data.
+///
+/// Each task descriptor also has a priority, which is zero unless it is set
+/// by calling SetPriority() before the task descriptor is inserted. It is
+/// ignored unless the thread manager uses a CPriorityQueue, which always
+/// gives the threads the task descriptor with the highest priority first.
+///
+/// If the thread manager is collecting statistics, then it records the time
+/// at which each task descriptor became ready to be performed, so that the
+/// time spent waiting in the request queue can be measured. This can be
+/// read with GetEnqueueTime().
+///
+/// Tasks can depend on other tasks. AddSuccessor() declares that a task
+/// must not be performed until this one has been. Each task descriptor
+/// counts its pending dependencies in m_nNumPending, which starts at 1 for
+/// the pending insertion into the thread manager, so a task becomes ready
+/// when it has been inserted and all of its predecessors have been
+/// performed. Whoever brings the count to zero makes it ready. Since
+/// CBaseThreadManager::AddDependency() and the threads take care of this,
+/// you will not normally call these functions yourself. The list of
+/// successors is only allocated when the first one is added, so a task
+/// descriptor without any costs no more than a null pointer.
+///
+/// Perform() can call StopRequested() to find out whether the thread
+/// manager that the calling thread belongs to has been asked to stop, in
+/// which case it should return as soon as it can. A task that gives up
+/// early is still processed as a result like any other, so it should note
+/// that it did. Each thread sets its stop flag with SetStopFlag() when it
+/// starts.
 
 class CBaseTask{
   private:
     static std::atomic<size_t> m_nNumTasks; ///< Number of tasks extant.
 
+    std::atomic<size_t> m_nNumPending; ///< Number of pending dependencies.
+    std::vector<CBaseTask*>* m_pSuccessor = nullptr; ///< Dependent tasks.
+
   protected:
     size_t m_nTaskId = 0; ///< Task identifier.
     size_t m_nThreadId = max_size_t; ///< Identifier of thread that performed task.
+    size_t m_nPriority = 0; ///< Priority, higher is more urgent.
+    size_t m_nNodeId = max_size_t; ///< NUMA node of thread that performed task.
+    uint64_t m_nEnqueueTime = 0; ///< When task became ready, in nanoseconds.
 
   public:
     CBaseTask(); ///< Default constructor.
+    virtual ~CBaseTask(); ///< Destructor.
 
     virtual void Perform(); ///< Perform this task.
 
@@ -69,6 +133,42 @@ class CBaseTask{
 
     void SetThreadId(const size_t); ///< Set thread identifier.
     const size_t GetThreadId() const; ///< Get thread identifier.
+
+    void SetNodeId(const size_t); ///< Set NUMA node identifier.
+    const size_t GetNodeId() const; ///< Get NUMA node identifier.
+
+    void SetPriority(const size_t); ///< Set priority.
+    const size_t GetPriority() const; ///< Get priority.
+
+    void SetEnqueueTime(const uint64_t); ///< Set enqueue time.
+    const uint64_t GetEnqueueTime() const; ///< Get enqueue time.
+
+    void AddSuccessor(CBaseTask*); ///< Add a task that depends on this one.
+    const std::vector<CBaseTask*>& GetSuccessors() const; ///< Get successors.
+    bool SatisfyDependency(); ///< Count down pending dependencies.
+
+    static const bool StopRequested(); ///< Should Perform() give up early?
+    static CStopToken GetStopToken(); ///< Get this thread's stop token.
+    static void SetStopFlag(const std::atomic<bool>*); ///< Set stop flag.
 }; //CBaseTask
 
+/// \brief Static task descriptor.
+///
+/// CBaseTask::Perform() is virtual, so by default the threads perform each
+/// task with an indirect function call that the compiler cannot inline. If
+/// your Perform() is only a few dozen instructions long, then that can be a
+/// significant overhead. Derive your task descriptor from this class as
+/// well as from CBaseTask, for example
+///
+///     class CTask: public CBaseTask, public CStaticTask<CTask>{ ... };
+///
+/// and the threads will call `CTask::Perform()` directly instead. Do not do
+/// this if you insert objects of classes derived from CTask which override
+/// Perform() again, since their overrides will not be called.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CStaticTask{
+}; //CStaticTask
+
 #endif //__BaseTask_h__
@@ -30,10 +30,35 @@
 #include <functional>
 #include <cstddef>
 #include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <type_traits>
+#include <deque>
+#include <map>
+#include <cassert>
 
 #include "ThreadSafeQueue.h"
+#include "ResultBuffer.h"
 #include "Thread.h"
 #include "BaseTask.h"
+#include "TaskPool.h"
+#include "Affinity.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "TimerWheel.h"
+
+/// \brief Overflow policy.
+///
+/// What Insert() and InsertBatch() do when the request queue has a capacity
+/// set by CBaseThreadManager::SetCapacity() and is full. `Block` makes the
+/// producer wait until a thread takes something from the request queue.
+/// `Inline` makes the producer perform the task itself, which paces it to
+/// the speed of the threads without ever blocking it. Either way a producer
+/// that would rather give up can call CBaseThreadManager::TryInsert().
+
+enum class eOverflow{
+  Block, Inline
+}; //eOverflow
 
 ///////////////////////////////////////////////////////////////////////////////
 // CBaseThreadManager definition.
@@ -45,14 +70,105 @@
 /// CTaskClass being your task descriptor class derived from CBaseTask.
 /// Your thread manager should implement a constructor for any task-related
 /// initialization and it should override function ProcessTask() with the
-/// processing required for your task.
+/// processing required for your task. The request and result queues are
+/// instances of CThreadSafeQueue by default. Instantiate the template with
+/// `CLockFreeQueue<CTaskClass*>` as the second parameter to use the lock-free
+/// queue instead.
+///
+/// ProcessTask() is virtual, so by default each completed task descriptor
+/// costs an indirect function call that the compiler cannot inline. If your
+/// ProcessTask() is cheap enough for that to matter, then use the curiously
+/// recurring template pattern by giving your thread manager class as the
+/// third template parameter, for example
+///
+///     class CThreadManager: 
+///       public CBaseThreadManager<CTask, CThreadSafeQueue<CTask*>, 
+///         CThreadManager>
+///
+/// and your ProcessTask() will be called directly instead. It must then be
+/// accessible from this class, so either make it public or make this class
+/// a friend. To have CTask::Perform() called directly by the threads too,
+/// derive CTask from CStaticTask.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass=CThreadSafeQueue<CTaskClass*>,
+  class CDerived=void>
+class CBaseThreadManager: public CCommon<CTaskClass, CQueueClass>{
+  private:
+    /// \brief A task descriptor or a periodic schedule in the timer wheel.
+
+    struct CTimedTask{
+      CTaskClass* m_pTask; ///< Task descriptor, if not periodic.
+      size_t m_nSchedule; ///< Periodic schedule, or max_size_t if none.
+    }; //CTimedTask
+
+    /// \brief A periodic schedule.
+
+    struct CSchedule{
+      std::function<CTaskClass*()> m_fMake; ///< Makes the task descriptors.
+      uint64_t m_nPeriod; ///< Period in ticks.
+      uint64_t m_nDue; ///< Tick at which it is next due.
+    }; //CSchedule
+
+    void DispatchProcessTask(CTaskClass*, std::true_type); ///< Virtual.
+    void DispatchProcessTask(CTaskClass*, std::false_type); ///< Static.
+    void DispatchProcessTask(CTaskClass*); ///< Process the result of a task.
+
+    void InsertReady(CTaskClass*); ///< Insert a ready task.
+
+    template <class ForwardIt> 
+    void InsertReady(ForwardIt, ForwardIt); ///< Insert many ready tasks.
+
+    void DeleteUnperformed(CTaskClass*); ///< Delete task and dependents.
+
+    template <class ForwardIt> 
+    void InsertRange(ForwardIt, ForwardIt); ///< Insert tasks, no capacity.
+
+    const size_t GetRoom() const; ///< Room left in the request queue.
+    void WaitForRoom(); ///< Block until there is room in the request queue.
+    void PerformInline(CTaskClass*); ///< Perform a task on the caller.
+
+    void SpawnThread(size_t); ///< Spawn one thread.
+    void Grow(); ///< Spawn another thread if the queue stays deep.
+    void Consume(); ///< Consumer thread body for streaming mode.
+
+    static uint64_t GetTick(std::chrono::steady_clock::time_point); ///< Tick.
+    void Schedule(uint64_t, const CTimedTask&); ///< Put in timer wheel.
+    void RunTimer(); ///< Timer thread body.
+    void StopTimer(); ///< Stop the timer thread.
+
+    void ProcessResult(CTaskClass*); ///< Process and delete one result.
+    size_t CollectResults(); ///< Collect results from result buffers.
+    bool WaitResults(const std::chrono::steady_clock::time_point*); ///< Wait.
+    bool NextResult(CTaskClass*&, 
+      const std::chrono::steady_clock::time_point*); ///< Next buffered result.
 
-template <class CTaskClass>
-class CBaseThreadManager: public CCommon<CTaskClass>{
   protected:
     std::vector<std::thread> m_vThread; ///< Thread list.
     size_t m_nNumThreads = 0; ///< Number of threads in use.
+    std::atomic<size_t> m_nNextDeque; ///< Next deque to insert into.
+    std::atomic<size_t> m_nUnprocessed; ///< Non-null tasks not processed.
+    eAffinity m_eAffinity = eAffinity::None; ///< Thread placement policy.
+    std::vector<size_t> m_vAffinityCpu; ///< CPUs for explicit placement.
+    size_t m_nMaxThreads = 0; ///< Max threads in elastic mode.
+    std::chrono::milliseconds m_tGrowDelay; ///< How long queue must be deep.
+    std::atomic<long long> m_nDeepSince; ///< When queue got deep, 0 if not.
+    std::thread m_stdConsumer; ///< Result consumer thread in streaming mode.
+    std::atomic<bool> m_bStopStreaming; ///< Stop the consumer thread.
+    eResultOrder m_eResultOrder = eResultOrder::Arbitrary; ///< Result order.
+    std::deque<CTaskClass*> m_qPending; ///< Collected, unprocessed results.
+    CAtomicHistogram m_cEndToEnd; ///< Time from ready to being processed.
+    std::thread m_stdTimer; ///< Timer thread for delayed and periodic tasks.
+    std::mutex m_stdTimerMutex; ///< Mutex for the timer wheel.
+    std::condition_variable m_cvTimer; ///< For waking the timer thread.
+    bool m_bStopTimer = false; ///< Stop the timer thread.
+    CTimerWheel<CTimedTask> m_cTimerWheel; ///< Tasks waiting for their time.
+    std::map<size_t, CSchedule> m_mapSchedule; ///< Periodic schedules.
+    size_t m_nNextSchedule = 0; ///< Identifier for the next schedule.
+    eOverflow m_eOverflow = eOverflow::Block; ///< What to do when full.
+    CThrottleStats m_cThrottle; ///< Backpressure statistics.
     
     virtual void ProcessTask(CTaskClass*); ///< Process the result of a task.
 
@@ -60,112 +176,1867 @@ class CBaseThreadManager: public CCommon<CTaskClass>{
     CBaseThreadManager(); ///< Constructor.
     virtual ~CBaseThreadManager(); ///< Destructor.
 
+    void AddDependency(CTaskClass*, CTaskClass*); ///< Add dependency.
     void Insert(CTaskClass*); ///< Insert a task.
+    bool TryInsert(CTaskClass*); ///< Insert a task unless the queue is full.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt, ForwardIt); ///< Insert many tasks.
+
+    void InsertAt(CTaskClass*, 
+      std::chrono::steady_clock::time_point); ///< Insert a task at a time.
+
+    template <class Rep, class Period> 
+    void InsertAfter(CTaskClass*, 
+      const std::chrono::duration<Rep, Period>&); ///< Insert after a delay.
+
+    template <class Rep, class Period> 
+    size_t InsertEvery(const std::function<CTaskClass*()>&, 
+      const std::chrono::duration<Rep, Period>&); ///< Insert periodically.
+
+    bool CancelSchedule(size_t); ///< Cancel a periodic schedule.
+
+    void SetCapacity(size_t, 
+      eOverflow=eOverflow::Block); ///< Bound the request queue.
+    void SetBatchSize(size_t); ///< Set max tasks a thread takes at once.
+    void SetWorkStealing(bool); ///< Turn work-stealing mode on or off.
+    void SetResultBuffers(bool, 
+      eResultOrder=eResultOrder::Arbitrary); ///< Per-thread result buffers.
+    void SetStats(bool); ///< Turn statistics collection on or off.
+    void SetTrace(bool, size_t=1 << 16); ///< Turn tracing on or off.
+    void SetPersistent(bool); ///< Turn persistent mode on or off.
+    void SetIdlePolicy(eIdle, size_t=4096, size_t=16); ///< Spin or park.
+    void SetNumThreads(size_t); ///< Set number of threads.
+
+    void SetElastic(size_t, 
+      std::chrono::milliseconds=std::chrono::milliseconds(1000),
+      std::chrono::milliseconds=std::chrono::milliseconds(10)); ///< Elastic.
+
+    void SetAffinity(eAffinity, 
+      const std::vector<size_t>& = std::vector<size_t>()); ///< Placement.
 
     void Spawn(); ///< Spawn threads.
     void Wait(); ///< Wait for threads to finish all tasks.
+    void Stop(); ///< Stop persistent threads once they finish all tasks.
     void ForceExit(); ///< Force all threads to terminate.
+    void RequestStop(); ///< Ask all threads to terminate, without waiting.
+    const bool StopRequested() const; ///< Has a stop been requested?
+    CStopToken GetStopToken() const; ///< Get a token that polls for a stop.
+
+    template <class OutputIt> 
+    size_t Drain(OutputIt); ///< Stop threads and take unstarted tasks.
+
+    template <class Rep, class Period> 
+    bool Shutdown(const std::chrono::duration<Rep, Period>&); ///< Deadline.
+
     void Process(); ///< Process results of all tasks.
+    bool ProcessNext(); ///< Wait for and process the next result.
+
+    template <class Rep, class Period> 
+    bool ProcessNextFor(const std::chrono::duration<Rep, Period>&); ///< Timed.
+
+    void StartStreaming(); ///< Process results on a consumer thread.
+    void StopStreaming(); ///< Stop the consumer thread.
+    const bool IsStreaming() const; ///< Is the consumer thread running?
 
     const size_t GetNumThreads() const; ///< Get number of threads.
+    const size_t GetNumLiveThreads() const; ///< Get number running.
+    CStats GetStats() const; ///< Get a snapshot of the statistics.
+    void WriteTrace(std::ostream&) const; ///< Write trace as Chrome JSON.
 }; //CBaseThreadManager
 
 ///////////////////////////////////////////////////////////////////////////////
 // CBaseThreadManager code.
 
-/// Default constructor.
+/// Default constructor. The number of threads is one less than the number
+/// of CPUs available to this process (leaving one for the main thread), but
+/// at least one. The number of CPUs available takes into account the
+/// process's affinity mask and any control group CPU quota, so a program
+/// running in a container with a quota of 2 CPUs on a 64-CPU machine does
+/// not spawn 63 threads.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 
-template <class CTaskClass>
-CBaseThreadManager<CTaskClass>::CBaseThreadManager(){
-  m_nNumThreads = std::thread::hardware_concurrency() - 1;
+template <class CTaskClass, class CQueueClass, class CDerived>
+CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::CBaseThreadManager():
+  m_nNextDeque(0), m_nUnprocessed(0), m_tGrowDelay(0), m_nDeepSince(0),
+  m_bStopStreaming(false){
+  m_nNumThreads = std::max<size_t>(1, GetNumAvailableCpus() - 1);
 } //constructor
 
-/// The destructor deletes any remaining tasks in the request and result
-/// queues. Both queues should be empty at this point, but this is for safety.
+/// The destructor stops the consumer thread if streaming mode is still on,
+/// and the timer thread if there is one, then deletes any remaining tasks
+/// in the timer wheel, the request and result queues, the work-stealing
+/// deques, and the result buffers, together with any tasks still waiting
+/// for them to be performed. They should all be empty at this point, but
+/// this is for safety.
+///
+/// Streaming mode must already be off, since your thread manager has been
+/// destroyed by the time this destructor runs, and the consumer thread
+/// would call its ProcessTask(). Call StopStreaming() in your destructor if
+/// need be. This is asserted, and if assertions are off then the consumer
+/// thread is stopped here as a last resort.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 
-template <class CTaskClass>
-CBaseThreadManager<CTaskClass>::~CBaseThreadManager(){
+template <class CTaskClass, class CQueueClass, class CDerived>
+CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::~CBaseThreadManager(){
   CTaskClass* pTask = nullptr; //task pointer
+
+  assert(!IsStreaming()); //StopStreaming() must be called first
+  StopStreaming(); //last resort if assertions are off
+  StopTimer(); //delayed tasks left in the timer wheel are never performed
+
+  std::vector<CTimedTask> vTimed; //tasks in the timer wheel
+  m_cTimerWheel.DeleteAll(std::back_inserter(vTimed));
+
+  for(const CTimedTask& t: vTimed)
+    if(t.m_nSchedule == max_size_t) //not periodic
+      DeleteUnperformed(t.m_pTask);
   
   //delete any remaining tasks in the request queue
 
-  while(CCommon<CTaskClass>::m_qRequest.Delete(pTask)) 
-    delete pTask; 
+  while(CCommon<CTaskClass, CQueueClass>::m_qRequest.Delete(pTask)) 
+    DeleteUnperformed(pTask); 
+
+  SetWorkStealing(false); //deletes any remaining tasks in the deques
+  SetResultBuffers(false); //moves any remaining results to the result queue
   
   //delete any remaining tasks in the result queue
 
-  while(CCommon<CTaskClass>::m_qResult.Delete(pTask)) 
+  while(CCommon<CTaskClass, CQueueClass>::m_qResult.Delete(pTask)) 
     delete pTask; 
 } //destructor
 
-/// Insert a task descriptor into the request queue.
+/// Declare that a task must not be performed until another task has been.
+/// This must be called before either task descriptor is inserted. Once all
+/// of a task's predecessors have been performed, it is inserted into the
+/// request queue automatically by the thread that performed the last one,
+/// so the tasks of a multi-phase computation can all be inserted at once
+/// and independent branches of different phases can overlap, with no need
+/// to wait for all of the threads between phases. The tasks should be
+/// inserted before the threads are spawned or in persistent mode, since
+/// otherwise threads may exit while waiting for predecessors to finish. A
+/// task that is never inserted is never performed, and neither is anything
+/// that depends on it. A predecessor may have been processed and deleted
+/// by the time its successor is performed, so a successor must not use
+/// pointers to its predecessors.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pPred Pointer to the task descriptor that must be performed first.
+/// \param pSucc Pointer to the task descriptor that depends on it.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::AddDependency(
+  CTaskClass* pPred, CTaskClass* pSucc)
+{
+  pPred->AddSuccessor(pSucc);
+} //AddDependency
+
+/// Insert a task descriptor into the request queue. In work-stealing mode
+/// the task descriptors are instead distributed round-robin across the
+/// threads' deques. A task descriptor that is waiting for predecessors is
+/// held back until they have been performed. If the request queue is full,
+/// then this blocks or performs the task, depending on the overflow policy
+/// set by SetCapacity(). A null pointer tells the thread that takes it to
+/// exit. It has no result, so ProcessNext() does not wait for one.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 /// \param p Pointer to a task.
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::Insert(CTaskClass* p){
-  CCommon<CTaskClass>::m_qRequest.Insert(p);
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Insert(
+  CTaskClass* p)
+{
+  if(p != nullptr) //a null pointer has no result to wait for
+    m_nUnprocessed++;
+
+  if(p == nullptr || p->SatisfyDependency()){ //ready
+    if(p != nullptr && GetRoom() == 0){ //full
+      if(m_eOverflow == eOverflow::Inline){ 
+        PerformInline(p);
+        return;
+      } //if
+
+      WaitForRoom();
+    } //if
+
+    InsertReady(p);
+  } //if
 } //Insert
 
-/// Spawn one less than the maximum number of concurrent threads provided by
-/// the hardware (leaving one for the main thread).
+/// Insert a task descriptor as Insert() does, unless the request queue is
+/// full, in which case return at once without inserting it, whatever the
+/// overflow policy. The caller still owns a task descriptor that was not
+/// inserted, and may try again later, delete it, or shed the load some
+/// other way.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param p Pointer to a task.
+/// \return true if the task descriptor was inserted.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::TryInsert(
+  CTaskClass* p)
+{
+  if(p != nullptr && GetRoom() == 0){ //full
+    m_cThrottle.AddRejected();
+    return false;
+  } //if
+
+  if(p != nullptr) //a null pointer has no result to wait for
+    m_nUnprocessed++;
+
+  if(p == nullptr || p->SatisfyDependency()) //ready
+    InsertReady(p);
+
+  return true;
+} //TryInsert
+
+/// Insert a ready task descriptor into the request queue, or the next
+/// deque in work-stealing mode.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param p Pointer to a task.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertReady(
+  CTaskClass* p)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  if(CCommonClass::IsTrackingQueue()) //track queue depth
+    CCommonClass::m_nNumQueued++;
+
+  if(p != nullptr){ //not a null pointer telling a thread to exit
+    if(CCommonClass::m_nNumStats > 0) //collecting statistics
+      p->SetEnqueueTime(GetSteadyTimeNs());
+
+    CCommonClass::Trace(max_size_t, eTraceEvent::Enqueue, p->GetTaskId());
+  } //if
+
+  if(CCommonClass::m_nNumDeques > 0){ //work-stealing
+    const size_t n = m_nNextDeque++%CCommonClass::m_nNumDeques; //next deque
+    CCommonClass::m_pDeque[n].Insert(p);
+  } //if
+
+  else CCommonClass::m_qRequest.Insert(p);
+
+  CCommonClass::WakeIdleThread(); //in case a thread is parked
+
+  if(CCommonClass::m_bElastic) //more threads may be needed
+    Grow();
+} //InsertReady
+
+/// Insert a range of task descriptors into the request queue, paying for
+/// synchronization once for the whole range instead of once per task. In
+/// work-stealing mode the range is split into roughly equal contiguous
+/// chunks, one for each thread's deque. Task descriptors that are waiting
+/// for predecessors are held back until they have been performed. If the
+/// request queue has a capacity, then the range is inserted in pieces that
+/// fit, and when it is full the overflow policy applies as in Insert().
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first task descriptor pointer to be inserted.
+/// \param last Iterator to one past the last one to be inserted.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class ForwardIt> 
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertBatch(
+  ForwardIt first, ForwardIt last)
+{
+  if(CCommon<CTaskClass, CQueueClass>::m_nCapacity == 0){ //no limit
+    InsertRange(first, last);
+    return;
+  } //if
+
+  while(first != last){
+    const size_t nRoom = GetRoom(); //room in the request queue
+
+    if(nRoom == 0){ //full
+      if(m_eOverflow == eOverflow::Inline) //perform the next one
+        Insert(*first++);
+      else WaitForRoom();
+    } //if
+
+    else{ //insert as many as will fit
+      ForwardIt it = first; //end of the piece that fits
+
+      for(size_t i=0; i<nRoom && it!=last; i++)
+        ++it;
+
+      InsertRange(first, it);
+      first = it;
+    } //else
+  } //while
+} //InsertBatch
+
+/// Insert a range of task descriptors, as InsertBatch() does, but without
+/// regard to the capacity of the request queue.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first task descriptor pointer to be inserted.
+/// \param last Iterator to one past the last one to be inserted.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class ForwardIt> 
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertRange(
+  ForwardIt first, ForwardIt last)
+{
+  std::vector<CTaskClass*> vReady; //ready tasks, if not all of them are
+  bool bAllReady = true; //whether all tasks are ready
+
+  for(ForwardIt it=first; it!=last; ++it){
+    if(*it != nullptr) //a null pointer has no result to wait for
+      m_nUnprocessed++;
+
+    if(*it == nullptr || (*it)->SatisfyDependency()){ //ready
+      if(!bAllReady)vReady.push_back(*it);
+    } //if
+
+    else if(bAllReady){ //first task that is not ready
+      bAllReady = false;
+      vReady.assign(first, it); //ready tasks so far
+    } //else if
+  } //for
+
+  if(bAllReady)
+    InsertReady(first, last);
+  else InsertReady(vReady.begin(), vReady.end());
+} //InsertRange
+
+/// Get the amount of room left in the request queue, that is, how many more
+/// ready task descriptors can be inserted before it reaches its capacity.
+/// The capacity is only enforced while there are threads running to make
+/// room and no stop has been requested, so that a producer is never left
+/// waiting for nothing.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return Room left, or max_size_t if there is no limit right now.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+const size_t CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::GetRoom() const
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const size_t nCapacity = CCommonClass::m_nCapacity; //capacity
+
+  if(nCapacity == 0 || CCommonClass::m_nNumRunning == 0 || 
+    CCommonClass::m_bForceExit)
+    return max_size_t; //no limit
+
+  const size_t n = CCommonClass::m_nNumQueued; //queue depth
+
+  return n < nCapacity? nCapacity - n: 0;
+} //GetRoom
+
+/// Block until there is room in the request queue. The producer announces
+/// that it is waiting before it checks, which guarantees that a thread that
+/// makes room in the meantime will either be seen here or will see that it
+/// needs to wake the producer.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::WaitForRoom(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const uint64_t t = GetSteadyTimeNs(); //start time
+  CCommonClass::m_nNumSpaceWaiters++; //announce that we are about to wait
+
+  { //wait for room
+    std::unique_lock<std::mutex> lock(CCommonClass::m_stdSpaceMutex);
+
+    while(GetRoom() == 0)
+      CCommonClass::m_cvSpace.wait(lock);
+  } //wait
+
+  CCommonClass::m_nNumSpaceWaiters--;
+  m_cThrottle.AddBlocked(GetSteadyTimeNs() - t);
+} //WaitForRoom
+
+/// Perform a ready task on the calling thread instead of inserting it into
+/// the full request queue, then make its successors ready and put it in
+/// the result queue, or the first result buffer, just as a thread would.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param p Pointer to a task.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::PerformInline(
+  CTaskClass* p)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const uint64_t t = GetSteadyTimeNs(); //start time
+
+  if(CCommonClass::m_nNumStats > 0) //collecting statistics
+    p->SetEnqueueTime(t);
+
+  p->Perform();
+
+  for(CBaseTask* pSucc: p->GetSuccessors())
+    if(pSucc->SatisfyDependency()) //ready
+      InsertReady(static_cast<CTaskClass*>(pSucc));
+
+  if(CCommonClass::m_nNumResultBuffers == 0) //shared result queue
+    CCommonClass::m_qResult.Insert(p);
+
+  else{ //first result buffer
+    CCommonClass::m_pResultBuffer[0].InsertBatch(&p, &p + 1);
+    CCommonClass::WakeResultWaiter();
+  } //else
+
+  m_cThrottle.AddInline(GetSteadyTimeNs() - t);
+} //PerformInline
+
+/// Give the request queue a capacity, counting the ready task descriptors
+/// that have been inserted but not yet taken by a thread, and set what
+/// Insert() and InsertBatch() do when it is full. This keeps producers that
+/// are faster than the threads from filling memory with task descriptors,
+/// and paces them to the speed of the threads instead. TryInsert() refuses
+/// rather than waiting. The capacity may be exceeded by a little when
+/// several producers insert at once, and by task descriptors made ready by
+/// the threads or the timer thread, which are never held up. It is only
+/// enforced while threads are running, so anything can be inserted before
+/// Spawn(). Do not use the `Block` policy if tasks insert task descriptors
+/// themselves, since every thread could end up waiting for room. This must
+/// be called before any task descriptors are inserted.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param n Capacity, 0 for no limit.
+/// \param e Overflow policy.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetCapacity(
+  size_t n, eOverflow e)
+{
+  CCommon<CTaskClass, CQueueClass>::m_nCapacity = n;
+  m_eOverflow = e;
+} //SetCapacity
+
+/// Insert a range of ready task descriptors into the request queue, or in
+/// work-stealing mode, into the deques in roughly equal contiguous chunks.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first task descriptor pointer to be inserted.
+/// \param last Iterator to one past the last one to be inserted.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class ForwardIt> 
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertReady(
+  ForwardIt first, ForwardIt last)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const size_t n = (size_t)std::distance(first, last); //number of tasks
+  if(n == 0)return; //nothing to do
+
+  if(CCommonClass::IsTrackingQueue()) //track queue depth
+    CCommonClass::m_nNumQueued += n;
+
+  if(CCommonClass::m_nNumStats > 0){ //collecting statistics
+    const uint64_t t = GetSteadyTimeNs(); //same time for all
+
+    for(ForwardIt it=first; it!=last; ++it)
+      if(*it)(*it)->SetEnqueueTime(t);
+  } //if
+
+  if(CCommonClass::m_nNumTraces > 0) //tracing
+    for(ForwardIt it=first; it!=last; ++it)
+      if(*it)CCommonClass::Trace(max_size_t, eTraceEvent::Enqueue, 
+        (*it)->GetTaskId());
+
+  if(CCommonClass::m_nNumDeques > 0){ //work-stealing
+    const size_t nDeques = CCommonClass::m_nNumDeques; //number of deques
+    const size_t nChunk = (n + nDeques - 1)/nDeques; //chunk size
+    size_t nLeft = n; //number of tasks left to insert
+
+    while(nLeft > 0){ //one chunk per deque
+      const size_t k = std::min(nChunk, nLeft); //this chunk size
+      ForwardIt it = first; //end of this chunk
+      std::advance(it, k);
+      CCommonClass::m_pDeque[m_nNextDeque++%nDeques].InsertBatch(first, it);
+      first = it;
+      nLeft -= k;
+    } //while
+  } //if
+
+  else CCommonClass::m_qRequest.InsertBatch(first, last);
+
+  CCommonClass::WakeIdleThread(n); //in case threads are parked
+
+  if(CCommonClass::m_bElastic) //more threads may be needed
+    Grow();
+} //InsertReady
+
+/// Delete a task descriptor that will not be performed, together with any
+/// task descriptors that were waiting for it and so will never be ready.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param p Pointer to a task.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::DeleteUnperformed(
+  CTaskClass* p)
+{
+  std::vector<CTaskClass*> vTask(1, p); //tasks to be deleted
+
+  while(!vTask.empty()){
+    CTaskClass* pTask = vTask.back(); //next task to be deleted
+    vTask.pop_back();
+
+    if(pTask != nullptr){
+      for(CBaseTask* pSucc: pTask->GetSuccessors())
+        if(pSucc->SatisfyDependency()) //no longer held back by anything else
+          vTask.push_back(static_cast<CTaskClass*>(pSucc));
+
+      delete pTask;
+      m_nUnprocessed--;
+    } //if
+  } //while
+} //DeleteUnperformed
+
+/// Set the maximum number of task descriptors that a thread takes from the
+/// request queue at once. Larger batches mean less synchronization per task
+/// at the cost of coarser load balancing, so this is worth increasing
+/// when there are very many tiny tasks. The completed task descriptors of a
+/// batch are inserted into the result queue at once, too. The default is 1.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param n Batch size, which must be at least 1.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetBatchSize(
+  size_t n)
+{
+  CCommon<CTaskClass, CQueueClass>::m_nBatchSize = std::max<size_t>(1, n);
+} //SetBatchSize
+
+/// Turn work-stealing mode on or off. In work-stealing mode each thread has
+/// its own deque of task descriptors. Insert() spreads task descriptors
+/// across the deques, each thread performs tasks from the tail of its own
+/// deque, and a thread whose deque is empty steals from the head of the
+/// deque of a randomly chosen thread. This must be called before any task
+/// descriptors are inserted and before the threads are spawned. Turning
+/// work-stealing mode off deletes any task descriptors left in the deques.
+/// Call SetNumThreads() and SetElastic(), if at all, before this.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param bOn true to turn work-stealing mode on, false to turn it off.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetWorkStealing(
+  bool bOn)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CTaskClass* pTask = nullptr; //task pointer
+
+  for(size_t i=0; i<CCommonClass::m_nNumDeques; i++) //for each deque
+    while(CCommonClass::m_pDeque[i].Delete(pTask)) //delete remaining tasks
+      DeleteUnperformed(pTask);
+
+  delete [] CCommonClass::m_pDeque;
+  CCommonClass::m_pDeque = nullptr;
+  CCommonClass::m_nNumDeques = 0;
+
+  if(bOn){ //one deque per thread, and at least one
+    CCommonClass::m_nNumDeques = 
+      std::max<size_t>(1, std::max(m_nNumThreads, m_nMaxThreads));
+    CCommonClass::m_pDeque = 
+      new CWorkStealingDeque<CTaskClass*>[CCommonClass::m_nNumDeques];
+  } //if
+} //SetWorkStealing
+
+/// Turn per-thread result buffers on or off. When they are on, each thread
+/// appends the task descriptors that it has performed to its own result
+/// buffer instead of the shared result queue, so that the threads no longer
+/// contend with each other for the result queue's lock. Process() and its
+/// relatives collect the results from all of the buffers at once and
+/// process them in the order given. This should be called before the
+/// threads are spawned, and after SetNumThreads() or SetElastic(). Any
+/// results left in the buffers when they are turned off are moved to the
+/// result queue so that they are not lost.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param bOn true to turn per-thread result buffers on, false for off.
+/// \param e Order in which results are processed.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetResultBuffers(
+  bool bOn, eResultOrder e)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CollectResults(); //anything left in the buffers
+
+  for(CTaskClass* pTask: m_qPending) //move to result queue
+    CCommonClass::m_qResult.Insert(pTask);
+
+  m_qPending.clear();
+
+  delete [] CCommonClass::m_pResultBuffer;
+  CCommonClass::m_pResultBuffer = nullptr;
+  CCommonClass::m_nNumResultBuffers = 0;
+  m_eResultOrder = e;
+
+  if(bOn){ //one buffer per thread, and at least one
+    CCommonClass::m_nNumResultBuffers = 
+      std::max<size_t>(1, std::max(m_nNumThreads, m_nMaxThreads));
+    CCommonClass::m_pResultBuffer = 
+      new CResultBuffer<CTaskClass*>[CCommonClass::m_nNumResultBuffers];
+  } //if
+} //SetResultBuffers
+
+/// Turn statistics collection on or off. When it is on, each thread counts
+/// the tasks that it performs and steals and the time it spends busy and
+/// parked, and records how long each task waited to be performed and how
+/// long it took in a log-linear histogram. The thread manager records the
+/// end-to-end time of each task, from when it became ready until its result
+/// was processed. This costs a couple of reads of the steady clock per task,
+/// and nothing at all when it is off. It should be called before the
+/// threads are spawned, and after SetNumThreads() or SetElastic(). Turning
+/// it on again starts the statistics over from zero.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param bOn true to turn statistics collection on, false for off.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetStats(bool bOn){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  delete [] CCommonClass::m_pStats;
+  CCommonClass::m_pStats = nullptr;
+  CCommonClass::m_nNumStats = 0;
+  m_cEndToEnd.Clear(); //start over
+
+  if(bOn){ //one per thread, and at least one
+    CCommonClass::m_nNumStats = 
+      std::max<size_t>(1, std::max(m_nNumThreads, m_nMaxThreads));
+    CCommonClass::m_pStats = new CWorkerStats[CCommonClass::m_nNumStats];
+  } //if
+} //SetStats
+
+/// Turn tracing on or off. When it is on, each thread records trace events
+/// in its own buffer when it takes a task descriptor, begins and ends
+/// performing it, inserts its result, makes a successor ready, and parks
+/// and unparks. The thread manager records when it inserts a task
+/// descriptor and when it processes a result in a buffer of its own. Call
+/// WriteTrace() after the threads have finished to see it all on a
+/// timeline. Each buffer holds a fixed number of events, after which
+/// events are dropped rather than allocating memory. It should be called
+/// before the threads are spawned, and after SetNumThreads() or
+/// SetElastic(). Turning it on again throws away the previous trace.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param bOn true to turn tracing on, false for off.
+/// \param nEvents Maximum number of events in each buffer.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetTrace(bool bOn,
+  size_t nEvents)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  delete [] CCommonClass::m_pTrace;
+  CCommonClass::m_pTrace = nullptr;
+  CCommonClass::m_nNumTraces = 0;
+
+  if(bOn){ //one per thread, at least one, and one for the thread manager
+    CCommonClass::m_nNumTraces = 
+      std::max<size_t>(1, std::max(m_nNumThreads, m_nMaxThreads)) + 1;
+    CCommonClass::m_pTrace = new CTraceBuffer[CCommonClass::m_nNumTraces];
+
+    for(size_t i=0; i<CCommonClass::m_nNumTraces; i++)
+      CCommonClass::m_pTrace[i].SetCapacity(nEvents);
+  } //if
+} //SetTrace
+
+/// Turn persistent mode on or off. In persistent mode, threads that run out
+/// of tasks park until more task descriptors are inserted instead of
+/// exiting, so Spawn() may be called before Insert() and the same threads
+/// can be kept busy with batch after batch of tasks. The threads exit only
+/// after Stop() or ForceExit() is called. This must be called before the
+/// threads are spawned.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param bOn true to turn persistent mode on, false to turn it off.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetPersistent(
+  bool bOn)
+{
+  CCommon<CTaskClass, CQueueClass>::m_bPersistent = bOn;
+} //SetPersistent
+
+/// Set what threads in persistent mode do when they run out of tasks. By
+/// default they park at once, which uses no CPU time while they are idle
+/// but adds the time it takes to wake a thread, often tens of
+/// microseconds, to the latency of the next task. Spinning first cuts that
+/// to a microsecond or so when tasks arrive often, at the cost of CPU time.
+/// The spin budget is a number of pause instructions, each of which takes
+/// somewhere between a few nanoseconds and a few tens of nanoseconds
+/// depending on the CPU, and the yield budget is the number of times a
+/// thread gives up its CPU after that before it parks. Under the adaptive
+/// policy the spin budget is only a maximum. If only one CPU is available
+/// to this process, then spinning would only keep the thread that is to
+/// insert the next task descriptor from running, so threads merely yield.
+/// This must be called before any task descriptors are inserted and before
+/// the threads are spawned.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param e Idle policy.
+/// \param nSpin Maximum number of pause instructions before yielding.
+/// \param nYield Maximum number of yields before parking.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetIdlePolicy(
+  eIdle e, size_t nSpin, size_t nYield)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CCommonClass::m_eIdle = e;
+  CCommonClass::m_nMaxSpin = GetNumAvailableCpus() > 1? nSpin: 0;
+  CCommonClass::m_nMaxYield = nYield;
+} //SetIdlePolicy
+
+/// Set the policy for placing threads on CPUs. By default the operating
+/// system places the threads and may migrate them. Compact placement packs
+/// threads onto as few cores and nodes as possible, scatter placement
+/// spreads them across as many as possible, explicit placement pins them to
+/// the CPUs in a given list in turn, and per-node placement splits them
+/// evenly among the NUMA nodes, each thread free to run anywhere within its
+/// node. When the threads have been placed on nodes, each task descriptor
+/// is told the node it was performed on, work-stealing threads steal from
+/// threads on their own node first, and task descriptors allocated by a
+/// thread from a CTaskPool are in memory on its node. This must be called
+/// before the threads are spawned.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param e Placement policy.
+/// \param vCpu List of CPUs for explicit placement.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetAffinity(
+  eAffinity e, const std::vector<size_t>& vCpu)
+{
+  m_eAffinity = e;
+  m_vAffinityCpu = vCpu;
+} //SetAffinity
+
+/// Set the number of threads to be spawned by Spawn(). This must be called
+/// before the threads are spawned and before work-stealing mode is turned on.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param n Number of threads, which must be at least 1.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetNumThreads(
+  size_t n)
+{
+  m_nNumThreads = std::max<size_t>(1, n);
+} //SetNumThreads
+
+/// Turn elastic mode on or off. In elastic mode, Spawn() starts the number
+/// of threads set by SetNumThreads() as usual, but more threads are spawned,
+/// up to a maximum, while the request queue stays deep, and threads beyond
+/// the original number retire after they have been idle for a while. This
+/// keeps a pool that is shared with other services on the same machine from
+/// oversubscribing the CPUs when it is not busy. Elastic mode implies
+/// persistent mode, and must be set before work-stealing mode is turned on
+/// and before the threads are spawned.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param nMax Maximum number of threads, 0 to turn elastic mode off.
+/// \param tIdle How long a thread may be idle before it retires.
+/// \param tGrow How long the queue must stay deep before a thread is added.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SetElastic(
+  size_t nMax, std::chrono::milliseconds tIdle, std::chrono::milliseconds tGrow)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  m_nMaxThreads = nMax;
+  m_tGrowDelay = tGrow;
+  CCommonClass::m_bElastic = nMax > 0;
+  CCommonClass::m_tIdleTimeout = tIdle;
+  CCommonClass::m_nNumQueued = 0;
+
+  if(nMax > 0)
+    SetPersistent(true);
+} //SetElastic
+
+/// Spawn the number of threads set by SetNumThreads(), by default one less
+/// than the number of CPUs available (leaving one for the main thread),
+/// placed on CPUs as set by SetAffinity(). If no threads are running, then
+/// any earlier stop request is cleared first.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Spawn(){ 
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CCommonClass::m_bStop = false;
+
+  std::lock_guard<std::mutex> lock(CCommonClass::m_stdThreadMutex);
+
+  if(m_vThread.empty()){ //no threads are using the old placement
+    CCommonClass::m_bForceExit = false;
+    CCommonClass::m_vCpuSet.clear();
+    CCommonClass::m_vNodeId.clear();
+    CCommonClass::m_vRetired.clear();
+    CCommonClass::m_nNumLive = 0;
+    CCommonClass::m_nMinThreads = m_nNumThreads;
+    m_nDeepSince = 0;
+
+    if(m_eAffinity != eAffinity::None) //plan placement
+      CTopology().Plan(m_eAffinity, std::max(m_nNumThreads, m_nMaxThreads), 
+        m_vAffinityCpu, CCommonClass::m_vCpuSet, CCommonClass::m_vNodeId);
+  } //if
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::Spawn(){ 
   for(size_t i=0; i<m_nNumThreads; i++)
-    m_vThread.push_back(std::thread((CThread<CTaskClass>(i))));
-} //Spawn 
+    SpawnThread(m_vThread.size());
+} //Spawn
+
+/// Spawn a thread. The thread mutex must be locked by the caller. If the
+/// thread identifier belongs to a thread that has retired, then that
+/// thread is joined first and its place in the thread list is reused.
+/// The thread identifier must be less than the number of threads, or the
+/// maximum number in elastic mode, since the per-thread statistics, result
+/// buffers, and deques are shared out by thread identifier.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param i Thread identifier.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::SpawnThread(
+  size_t i)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  assert(i < std::max(m_nNumThreads, m_nMaxThreads)); //one per thread
+
+  std::thread t((CThread<CTaskClass, CQueueClass>(i, this))); //new thread
+
+  if(i < m_vThread.size()){ //reuse place of retired thread
+    m_vThread[i].join(); //has already exited or is about to
+    m_vThread[i] = std::move(t);
+    CCommonClass::m_vRetired[i] = false;
+  } //if
+
+  else{ //new place
+    m_vThread.push_back(std::move(t));
+    CCommonClass::m_vRetired.push_back(false);
+  } //else
+
+  CCommonClass::m_nNumLive++;
+  CCommonClass::m_nNumRunning++;
+} //SpawnThread
+
+/// Spawn another thread in elastic mode if the request queue has held more
+/// than two task descriptors per running thread, with no thread idle,
+/// for longer than the grow delay. This is called after task descriptors
+/// are inserted. It is cheap unless a thread is actually spawned. A thread
+/// that has decided to retire is no longer counted as running, but it does
+/// not free its place in the thread list until it exits. If every place is
+/// taken, then this waits for the next insertion to try again rather than
+/// spawning a thread with a thread identifier that is out of range.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Grow(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const size_t nLive = CCommonClass::m_nNumLive; //number of running threads
+
+  if(nLive >= m_nMaxThreads || CCommonClass::m_nNumIdle > 0 || 
+    CCommonClass::m_nNumQueued <= 2*nLive)
+  { //not deep, or cannot grow
+    m_nDeepSince = 0;
+    return;
+  } //if
+
+  const long long t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count(); //now
+  long long tDeep = 0; //when queue got deep
+
+  if(m_nDeepSince.compare_exchange_strong(tDeep, t) || //just got deep
+    t - tDeep < std::chrono::duration_cast<std::chrono::nanoseconds>(
+      m_tGrowDelay).count()) //not deep for long enough
+    return;
+
+  std::lock_guard<std::mutex> lock(CCommonClass::m_stdThreadMutex);
+
+  if(m_vThread.empty() || CCommonClass::m_bStop || 
+    CCommonClass::m_bForceExit || CCommonClass::m_nNumLive >= m_nMaxThreads)
+    return; //not spawned, stopping, or another thread grew first
+
+  size_t i = 0; //thread identifier for new thread
+
+  while(i < m_vThread.size() && !CCommonClass::m_vRetired[i])
+    i++;
+
+  if(i >= std::max(m_nNumThreads, m_nMaxThreads))
+    return; //a retiring thread has not freed its place yet
+
+  SpawnThread(i);
+  m_nDeepSince = 0;
+} //Grow 
 
-/// Force all threads to terminate and wait until they do.
+/// Force all threads to terminate and wait until they do. Each thread
+/// finishes the task it is performing, which can end early by polling
+/// CBaseTask::StopRequested(), and tasks that have not been started are
+/// left where they are. Use Drain() instead to take them back.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::ForceExit(){ 
-  CCommon<CTaskClass>::m_bForceExit = true;
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::ForceExit(){ 
+  RequestStop();
   Wait();
 } //ForceExit
 
+/// Ask all threads to terminate as soon as they have finished the task
+/// they are performing, and return without waiting for them. This sets the
+/// stop flag polled by stop tokens, so it is safe to call from any thread,
+/// including from a task's Perform(). The flag stays set until the threads
+/// are spawned again.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::RequestStop(){ 
+  CCommon<CTaskClass, CQueueClass>::m_bForceExit = true;
+  CCommon<CTaskClass, CQueueClass>::WakeAllThreads(); //wake parked threads
+  CCommon<CTaskClass, CQueueClass>::WakeProducer(); //and blocked producers
+} //RequestStop
+
+/// Check whether a stop has been requested by RequestStop(), ForceExit(),
+/// Drain(), or a Shutdown() that ran out of time.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return true if a stop has been requested.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+const bool CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::StopRequested() const
+{
+  return CCommon<CTaskClass, CQueueClass>::m_bForceExit.load(
+    std::memory_order_relaxed);
+} //StopRequested
+
+/// Get a stop token for this thread manager, which code outside of its
+/// threads can poll to find out whether a stop has been requested. The
+/// threads themselves can simply call CBaseTask::StopRequested().
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return A stop token that is valid while this thread manager exists.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+CStopToken CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::GetStopToken() const
+{
+  return CStopToken(&(CCommon<CTaskClass, CQueueClass>::m_bForceExit));
+} //GetStopToken
+
+/// Stop the threads and take back the task descriptors that they have not
+/// started. This requests a stop, waits for each thread to finish the
+/// task it is performing, then removes every unstarted task descriptor from
+/// the request queue, the work-stealing deques, and the timer wheel, and
+/// writes a pointer to it to an output iterator. Periodic schedules are
+/// cancelled. Task descriptors that were waiting for one of
+/// those are written too, after their predecessors, since the threads will
+/// never make them ready. The caller owns the task descriptors written,
+/// and may delete them or perform them itself, but must not insert them
+/// again. The results of the tasks that were completed stay in the result
+/// queue, to be processed as usual by Process().
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam OutputIt Output iterator type, such as `std::back_insert_iterator`.
+/// \param out Output iterator for pointers to the unstarted task descriptors.
+/// \return Number of task descriptors written.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class OutputIt> 
+size_t CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Drain(
+  OutputIt out)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  ForceExit();
+  StopTimer();
+
+  std::vector<CTaskClass*> vTask; //unstarted tasks
+  CTaskClass* pTask = nullptr; //task pointer
+  std::vector<CTimedTask> vTimed; //tasks in the timer wheel
+
+  m_cTimerWheel.DeleteAll(std::back_inserter(vTimed));
+  m_mapSchedule.clear();
+
+  for(const CTimedTask& t: vTimed) //tasks whose time has not yet come
+    if(t.m_nSchedule == max_size_t && //not periodic
+      (t.m_pTask == nullptr || t.m_pTask->SatisfyDependency())) //ready
+      vTask.push_back(t.m_pTask);
+
+  while(CCommonClass::m_qRequest.Delete(pTask))
+    vTask.push_back(pTask);
+
+  for(size_t i=0; i<CCommonClass::m_nNumDeques; i++) //for each deque
+    while(CCommonClass::m_pDeque[i].Delete(pTask))
+      vTask.push_back(pTask);
+
+  std::reverse(vTask.begin(), vTask.end()); //first out of the stack first
+  size_t n = 0; //number of tasks written
+
+  while(!vTask.empty()){
+    pTask = vTask.back(); //next unstarted task
+    vTask.pop_back();
+
+    if(pTask != nullptr){ //not a null pointer telling a thread to exit
+      for(CBaseTask* pSucc: pTask->GetSuccessors())
+        if(pSucc->SatisfyDependency()) //no longer held back by anything else
+          vTask.push_back(static_cast<CTaskClass*>(pSucc));
+
+      *out++ = pTask;
+      n++;
+      m_nUnprocessed--;
+    } //if
+  } //while
+
+  CCommonClass::m_nNumQueued = 0;
+
+  return n;
+} //Drain
+
+/// Shut down with a deadline. This asks the threads to exit once they have
+/// completed all of the tasks in the request queue, as Stop() does, but if
+/// they have not all exited by the time the timeout expires, then a stop is
+/// requested as in ForceExit(). Either way this waits for the threads
+/// to exit, which after a stop request takes only as long as the tasks
+/// being performed take to finish or to notice the stop. Tasks that were
+/// not started are left in the request queue, and Drain() can be called
+/// afterwards to take them back.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param timeout Maximum amount of time to wait for the tasks to finish.
+/// \return true if all tasks finished in time, false if a stop was requested.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class Rep, class Period> 
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Shutdown(
+  const std::chrono::duration<Rep, Period>& timeout)
+{ 
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  const std::chrono::steady_clock::time_point t = 
+    std::chrono::steady_clock::now() + 
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+
+  CCommonClass::m_bStop = true;
+  CCommonClass::WakeAllThreads(); //wake parked threads
+
+  bool bFinished = false; //whether all threads exited in time
+
+  { //wait for the threads to exit, or for the deadline
+    std::unique_lock<std::mutex> lock(CCommonClass::m_stdThreadMutex);
+    bFinished = CCommonClass::m_cvExit.wait_until(lock, t, 
+      [&]{return CCommonClass::m_nNumRunning == 0;});
+  } //wait
+
+  if(!bFinished) //too late
+    RequestStop();
+
+  Wait();
+
+  return bFinished;
+} //Shutdown
+
 /// Wait for all threads to terminate (that is, execute a join) then return.
+/// In persistent mode the threads do not terminate until Stop(),
+/// ForceExit(), Drain(), or Shutdown() is called, so call one of those
+/// instead.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Wait(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  std::vector<std::thread> vThread; //threads to be joined
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::Wait(){
-  for_each(m_vThread.begin(), m_vThread.end(), std::mem_fn(&std::thread::join));
+  do{ //until no thread is spawned while joining
+    CCommonClass::m_stdThreadMutex.lock();
+    vThread.swap(m_vThread); //m_vThread is now empty
+    CCommonClass::m_stdThreadMutex.unlock();
+
+    for(std::thread& t: vThread) //for each thread
+      if(t.joinable()) //not already joined
+        t.join();
+
+    vThread.clear(); 
+    std::lock_guard<std::mutex> lock(CCommonClass::m_stdThreadMutex);
+
+    if(m_vThread.empty()){ //so that threads can be spawned again
+      CCommonClass::m_nNumLive = 0;
+      break;
+    } //if
+  }while(true);
 } //Wait
 
+/// Ask the threads to exit once they have completed all of the tasks in
+/// the request queue, and wait until they do. This is how a persistent
+/// thread pool is shut down. The threads can be spawned again afterwards.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Stop(){ 
+  CCommon<CTaskClass, CQueueClass>::m_bStop = true;
+  CCommon<CTaskClass, CQueueClass>::WakeAllThreads(); //wake parked threads
+  Wait();
+} //Stop
+
 /// Process the results of a task. This function is a stub which you should
 /// override in your derived thread manager class.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 /// \param pTask Pointer to a task descriptor.
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::ProcessTask(CTaskClass* pTask){
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::ProcessTask(
+  CTaskClass* pTask)
+{
   //stub
 } //ProcessTask
 
-/// Process and delete all completed task descriptors from the result queue.
+/// Process the results of a task by calling the virtual function
+/// ProcessTask(). This is used when no derived class is given as the third
+/// template parameter.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pTask Pointer to a task descriptor.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::DispatchProcessTask(
+  CTaskClass* pTask, std::true_type)
+{
+  ProcessTask(pTask);
+} //DispatchProcessTask
+
+/// Process the results of a task by calling the derived class's
+/// ProcessTask() directly, bypassing the virtual function table so that the
+/// call can be inlined. This is used when a derived class is given as the
+/// third template parameter.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pTask Pointer to a task descriptor.
 
-template <class CTaskClass>
-void CBaseThreadManager<CTaskClass>::Process(){ 
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::DispatchProcessTask(
+  CTaskClass* pTask, std::false_type)
+{
+  static_cast<CDerived*>(this)->CDerived::ProcessTask(pTask);
+} //DispatchProcessTask
+
+/// Process the results of a task, calling ProcessTask() either virtually or
+/// directly depending on the third template parameter.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pTask Pointer to a task descriptor.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::DispatchProcessTask(
+  CTaskClass* pTask)
+{
+  DispatchProcessTask(pTask, typename std::is_void<CDerived>::type());
+} //DispatchProcessTask
+
+/// Process a completed task descriptor, then delete it.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pTask Pointer to a completed task descriptor.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::ProcessResult(
+  CTaskClass* pTask)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  if(CCommonClass::m_nNumStats > 0) //collecting statistics
+    m_cEndToEnd.Insert(GetSteadyTimeNs() - pTask->GetEnqueueTime());
+
+  CCommonClass::Trace(max_size_t, eTraceEvent::Process, pTask->GetTaskId());
+
+  DispatchProcessTask(pTask); //process it
+  delete pTask; //delete the task descriptor
+  m_nUnprocessed--;
+} //ProcessResult
+
+/// Move the completed task descriptors from all of the result buffers to
+/// the end of the list of collected results, sorting them first if they are
+/// to be processed in order of task identifier. The ones from each buffer
+/// are kept in the order in which they were performed.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return Number of task descriptors collected.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+size_t CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::CollectResults(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  std::vector<CTaskClass*> vTask; //collected task descriptors
+
+  for(size_t i=0; i<CCommonClass::m_nNumResultBuffers; i++)
+    CCommonClass::m_pResultBuffer[i].DeleteAll(std::back_inserter(vTask));
+
+  if(m_eResultOrder == eResultOrder::TaskId)
+    std::stable_sort(vTask.begin(), vTask.end(), 
+      [](const CTaskClass* p, const CTaskClass* q){
+        return p->GetTaskId() < q->GetTaskId();});
+
+  m_qPending.insert(m_qPending.end(), vTask.begin(), vTask.end());
+
+  return vTask.size();
+} //CollectResults
+
+/// Wait until there is something in the result buffers, streaming mode is
+/// being turned off, or a deadline passes. The waiter count and fence work
+/// with CCommon::WakeResultWaiter() the same way as parking an idle thread
+/// works with CCommon::WakeIdleThread(), so wakeups are never lost.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pDeadline Pointer to the deadline, or nullptr to wait forever.
+/// \return true if there is something in the result buffers.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::WaitResults(
+  const std::chrono::steady_clock::time_point* pDeadline)
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  std::unique_lock<std::mutex> lock(CCommonClass::m_stdResultMutex);
+  CCommonClass::m_nNumResultWaiters++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  bool bFound = false; //whether there is something in the result buffers
+
+  while(!(bFound = CCommonClass::HasResults()) && !m_bStopStreaming)
+    if(pDeadline == nullptr)
+      CCommonClass::m_cvResult.wait(lock);
+
+    else if(CCommonClass::m_cvResult.wait_until(lock, *pDeadline) == 
+      std::cv_status::timeout)
+    {
+      bFound = CCommonClass::HasResults();
+      break;
+    } //else if
+
+  CCommonClass::m_nNumResultWaiters--;
+
+  return bFound;
+} //WaitResults
+
+/// Get the next completed task descriptor when per-thread result buffers are
+/// in use, collecting more from the buffers and waiting for them as needed.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param pTask [OUT] Pointer to the next completed task descriptor.
+/// \param pDeadline Pointer to the deadline, or nullptr to wait forever.
+/// \return true if a task descriptor was found, false if timed out or
+/// streaming mode is being turned off.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::NextResult(
+  CTaskClass*& pTask, const std::chrono::steady_clock::time_point* pDeadline)
+{
+  while(m_qPending.empty())
+    if(CollectResults() == 0 && !WaitResults(pDeadline))
+      return false;
+
+  pTask = m_qPending.front();
+  m_qPending.pop_front();
+
+  return true;
+} //NextResult
+
+/// Process and delete all completed task descriptors from the result queue,
+/// or from the result buffers if per-thread result buffers are in use.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Process(){ 
   CTaskClass* pTask = nullptr; //task pointer
 
-  while(CCommon<CTaskClass>::m_qResult.Delete(pTask)){ //for each task descriptor
-    ProcessTask(pTask); //process it
-    delete pTask; //delete the task descriptor
+  while(CCommon<CTaskClass, CQueueClass>::m_qResult.Delete(pTask))
+    ProcessResult(pTask); //for each task descriptor
+
+  CollectResults(); //from per-thread result buffers, if any
+
+  while(!m_qPending.empty()){ //for each collected task descriptor
+    ProcessResult(m_qPending.front());
+    m_qPending.pop_front();
   } //while
 } //Process
 
+/// Wait until the next completed task descriptor arrives in the result
+/// queue, then process and delete it. This lets the main thread process
+/// results while the threads are still running without polling. If every
+/// task descriptor that has been inserted has already been processed, then
+/// this returns immediately instead of waiting forever. Do not call this
+/// after ForceExit(), since tasks left in the request queue will never
+/// arrive.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return true if a task descriptor was processed, false if none are left.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::ProcessNext(){ 
+  if(m_nUnprocessed == 0) //nothing left to wait for
+    return false;
+
+  CTaskClass* pTask = nullptr; //task pointer
+
+  if(CCommon<CTaskClass, CQueueClass>::m_nNumResultBuffers > 0)
+    NextResult(pTask, nullptr); //from per-thread result buffers
+  else CCommon<CTaskClass, CQueueClass>::m_qResult.WaitDelete(pTask);
+
+  ProcessResult(pTask);
+
+  return true;
+} //ProcessNext
+
+/// Wait until the next completed task descriptor arrives in the result
+/// queue or a timeout expires, whichever comes first. If a task descriptor
+/// arrives, then process and delete it.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param timeout Maximum amount of time to wait.
+/// \return true if a task descriptor was processed.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class Rep, class Period> 
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::ProcessNextFor(
+  const std::chrono::duration<Rep, Period>& timeout)
+{ 
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CTaskClass* pTask = nullptr; //task pointer
+
+  if(m_nUnprocessed == 0) //nothing left to wait for
+    return false;
+
+  if(CCommonClass::m_nNumResultBuffers > 0){ //per-thread result buffers
+    const std::chrono::steady_clock::time_point t = 
+      std::chrono::steady_clock::now() + 
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+
+    if(!NextResult(pTask, &t))
+      return false;
+  } //if
+
+  else if(!CCommonClass::m_qResult.TryDeleteFor(pTask, timeout))
+    return false;
+
+  ProcessResult(pTask);
+
+  return true;
+} //ProcessNextFor
+
+/// Turn on streaming mode, in which a consumer thread processes and deletes
+/// completed task descriptors as soon as they arrive in the result queue,
+/// concurrently with the threads that perform them. Results then do not
+/// pile up in the result queue until Process() is called, so peak memory
+/// use is bounded by the number of tasks in flight rather than the total
+/// number of tasks. ProcessTask() is called on the consumer thread, one
+/// task at a time. If you would rather have the manager thread consume
+/// results as they arrive, call ProcessNext() in a loop instead of using
+/// streaming mode. Do not call Process(), ProcessNext(), or ProcessNextFor()
+/// while streaming mode is on, and call StopStreaming() before your thread
+/// manager is destroyed, since the consumer thread calls your ProcessTask().
+/// The destructor of CBaseThreadManager asserts that you did.
+/// Does nothing if streaming mode is already on.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::StartStreaming(){
+  if(!m_stdConsumer.joinable())
+    m_stdConsumer = std::thread([this](){Consume();});
+} //StartStreaming
+
+/// Turn off streaming mode by inserting a null pointer into the result queue
+/// and waiting for the consumer thread to reach it and exit. If per-thread
+/// result buffers are in use, then a flag is set instead and the consumer
+/// thread exits once it has emptied the buffers. Call Wait()
+/// first if all results are to be processed by the consumer thread. Any
+/// that arrive later are left for Process().
+/// Does nothing if streaming mode is off.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::StopStreaming(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  if(m_stdConsumer.joinable()){
+    if(CCommonClass::m_nNumResultBuffers > 0){ //per-thread result buffers
+      m_bStopStreaming = true;
+      CCommonClass::m_stdResultMutex.lock(); //wait until consumer is waiting
+      CCommonClass::m_stdResultMutex.unlock();
+      CCommonClass::m_cvResult.notify_all();
+    } //if
+
+    else CCommonClass::m_qResult.Insert(nullptr); //sentinel
+
+    m_stdConsumer.join();
+    m_bStopStreaming = false;
+  } //if
+} //StopStreaming
+
+/// The consumer thread in streaming mode takes batches of completed task
+/// descriptors from the result queue, waiting when it is empty, and
+/// processes and deletes them until it finds the null pointer inserted by
+/// StopStreaming(). Taking up to a batch at a time means that the consumer
+/// contends for the result queue once per batch rather than once per task.
+/// If per-thread result buffers are in use, then it takes everything in
+/// them each time instead.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Consume(){
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  if(CCommonClass::m_nNumResultBuffers > 0){ //per-thread result buffers
+    CTaskClass* pTask = nullptr; //task pointer
+
+    while(NextResult(pTask, nullptr))
+      ProcessResult(pTask);
+
+    return;
+  } //if
+
+  std::vector<CTaskClass*> vTask; //batch of task descriptors
+  bool bStop = false; //whether the sentinel has been found
+
+  while(!bStop){
+    vTask.clear();
+    CCommonClass::m_qResult.DeleteUpTo(std::back_inserter(vTask),
+      std::max<size_t>(1, CCommonClass::m_nBatchSize));
+
+    if(vTask.empty()){ //nothing there, so wait for something
+      CTaskClass* pTask = nullptr; //task pointer
+      CCommonClass::m_qResult.WaitDelete(pTask);
+      vTask.push_back(pTask);
+    } //if
+
+    for(CTaskClass* pTask: vTask)
+      if(pTask == nullptr)bStop = true; //sentinel
+      else ProcessResult(pTask);
+  } //while
+} //Consume
+
+/// Reader function for whether streaming mode is on.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return true if the consumer thread is running.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+const bool CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::IsStreaming() const
+{
+  return m_stdConsumer.joinable();
+} //IsStreaming
+
+/// Insert a task descriptor into the request queue at a given time instead
+/// of right away. Until then it waits in a timer wheel, and a timer thread,
+/// which is started the first time it is needed, moves it into the request
+/// queue when its time comes, so that no thread is tied up waiting. The
+/// resolution is one millisecond, and a task descriptor is never inserted
+/// early. Since the threads exit when they run out of tasks unless they are
+/// in persistent mode, this is normally used in persistent mode. A task
+/// descriptor that is waiting for predecessors is held back until they have
+/// been performed, too.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param p Pointer to a task.
+/// \param t Time at which it is to be inserted.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertAt(
+  CTaskClass* p, std::chrono::steady_clock::time_point t)
+{
+  if(p != nullptr) //a null pointer has no result to wait for
+    m_nUnprocessed++;
+
+  CTimedTask timed; //timer wheel entry
+  timed.m_pTask = p;
+  timed.m_nSchedule = max_size_t;
+
+  Schedule(GetTick(t + std::chrono::milliseconds(1) - 
+    std::chrono::steady_clock::duration(1)), timed); //rounded up
+} //InsertAt
+
+/// Insert a task descriptor into the request queue after a delay instead of
+/// right away, for example to retry after a back-off. See InsertAt().
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam Rep Arithmetic type of the number of ticks in the delay.
+/// \tparam Period Tick period of the delay.
+/// \param p Pointer to a task.
+/// \param delay How long to wait before inserting it.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class Rep, class Period> 
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertAfter(
+  CTaskClass* p, const std::chrono::duration<Rep, Period>& delay)
+{
+  InsertAt(p, std::chrono::steady_clock::now() + 
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay));
+} //InsertAfter
+
+/// Insert a new task descriptor into the request queue once every period,
+/// starting one period from now, for example for recurring maintenance.
+/// Since each task descriptor is deleted after it has been processed, a
+/// new one is made each time by calling a function, such as a lambda, on
+/// the timer thread. If that function returns a null pointer, then nothing
+/// is inserted that time. The schedule is kept at a fixed rate, but if the
+/// timer thread falls more than a period behind, then the missed insertions
+/// are skipped rather than made all at once. The schedule runs until it is
+/// cancelled with CancelSchedule() or Drain(), or until this thread manager
+/// is destroyed. See also InsertAt().
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \tparam Rep Arithmetic type of the number of ticks in the period.
+/// \tparam Period Tick period of the period.
+/// \param fMake Function that makes a new task descriptor.
+/// \param period Time between insertions, at least one millisecond.
+/// \return Schedule identifier, for CancelSchedule().
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+template <class Rep, class Period> 
+size_t CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::InsertEvery(
+  const std::function<CTaskClass*()>& fMake, 
+  const std::chrono::duration<Rep, Period>& period)
+{
+  const long long n = (long long)std::chrono::duration_cast<
+    std::chrono::milliseconds>(period).count(); //period in ticks
+
+  CSchedule schedule; //new schedule
+  schedule.m_fMake = fMake;
+  schedule.m_nPeriod = (uint64_t)std::max<long long>(1, n);
+  schedule.m_nDue = GetTick(std::chrono::steady_clock::now()) + 
+    schedule.m_nPeriod;
+
+  CTimedTask timed; //timer wheel entry
+  timed.m_pTask = nullptr;
+
+  m_stdTimerMutex.lock();
+  timed.m_nSchedule = m_nNextSchedule++;
+  m_mapSchedule[timed.m_nSchedule] = schedule;
+  m_stdTimerMutex.unlock();
+
+  Schedule(schedule.m_nDue, timed);
+
+  return timed.m_nSchedule;
+} //InsertEvery
+
+/// Cancel a periodic schedule started by InsertEvery(). Task descriptors
+/// that it has already inserted are not affected.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param n Schedule identifier returned by InsertEvery().
+/// \return true if the schedule was found and cancelled.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+bool CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::CancelSchedule(
+  size_t n)
+{
+  std::lock_guard<std::mutex> lock(m_stdTimerMutex);
+  return m_mapSchedule.erase(n) > 0; //its entry in the timer wheel is ignored
+} //CancelSchedule
+
+/// Convert a steady clock time to a timer wheel tick, which is the number
+/// of whole milliseconds since the steady clock's epoch.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param t Steady clock time.
+/// \return The tick that t falls in.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+uint64_t CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::GetTick(
+  std::chrono::steady_clock::time_point t)
+{
+  const long long n = (long long)std::chrono::duration_cast<
+    std::chrono::milliseconds>(t.time_since_epoch()).count(); //milliseconds
+
+  return (uint64_t)std::max<long long>(0, n);
+} //GetTick
+
+/// Put an entry into the timer wheel, starting the timer thread if it is
+/// not running, and wake the timer thread if the entry is due sooner than
+/// anything it is waiting for.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param nDue Tick at which the entry is due.
+/// \param timed Timer wheel entry.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::Schedule(
+  uint64_t nDue, const CTimedTask& timed)
+{
+  m_stdTimerMutex.lock();
+
+  m_cTimerWheel.SetTime(GetTick(std::chrono::steady_clock::now())); //if idle
+  const bool bSooner = nDue < m_cTimerWheel.GetNextTick(); //sooner than next
+  m_cTimerWheel.Insert(nDue, timed);
+
+  if(!m_stdTimer.joinable()) //start the timer thread
+    m_stdTimer = std::thread([this](){RunTimer();});
+
+  m_stdTimerMutex.unlock();
+
+  if(bSooner) //the timer thread may be waiting for something later
+    m_cvTimer.notify_one();
+} //Schedule
+
+/// The timer thread moves task descriptors from the timer wheel into the
+/// request queue as they become due, makes new task descriptors for
+/// periodic schedules that are due, and then sleeps until the timer wheel
+/// next has something to do or an earlier entry is inserted. The timer
+/// mutex is not held while task descriptors are made or inserted.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::RunTimer(){
+  std::vector<CTimedTask> vDue; //due timer wheel entries
+  std::vector<std::function<CTaskClass*()>> vMake; //due periodic schedules
+  std::vector<CTaskClass*> vReady; //task descriptors to be inserted
+
+  std::unique_lock<std::mutex> lock(m_stdTimerMutex);
+
+  while(!m_bStopTimer){
+    const uint64_t nNow = GetTick(std::chrono::steady_clock::now()); //now
+    vDue.clear();
+    vMake.clear();
+    vReady.clear();
+    m_cTimerWheel.Advance(nNow, std::back_inserter(vDue));
+
+    for(const CTimedTask& t: vDue)
+      if(t.m_nSchedule == max_size_t){ //delayed task descriptor
+        if(t.m_pTask == nullptr || t.m_pTask->SatisfyDependency())
+          vReady.push_back(t.m_pTask);
+      } //if
+
+      else{ //periodic schedule, unless it has been cancelled
+        auto it = m_mapSchedule.find(t.m_nSchedule); //the schedule
+
+        if(it != m_mapSchedule.end()){ //not cancelled
+          CSchedule& schedule = it->second; //shorthand
+          vMake.push_back(schedule.m_fMake);
+          schedule.m_nDue += schedule.m_nPeriod;
+
+          if(schedule.m_nDue <= nNow) //fallen behind, so skip
+            schedule.m_nDue = nNow + schedule.m_nPeriod;
+
+          m_cTimerWheel.Insert(schedule.m_nDue, t);
+        } //if
+      } //else
+
+    lock.unlock();
+
+    for(const std::function<CTaskClass*()>& f: vMake){
+      CTaskClass* p = f(); //new task descriptor
+
+      if(p != nullptr){
+        m_nUnprocessed++;
+
+        if(p->SatisfyDependency()) //ready
+          vReady.push_back(p);
+      } //if
+    } //for
+
+    InsertReady(vReady.begin(), vReady.end());
+
+    lock.lock();
+
+    if(m_bStopTimer) //stop without waiting
+      break;
+
+    const uint64_t nNext = m_cTimerWheel.GetNextTick(); //when to wake
+
+    if(nNext == UINT64_MAX) //nothing to wait for
+      m_cvTimer.wait(lock);
+
+    else m_cvTimer.wait_until(lock, std::chrono::steady_clock::time_point(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::milliseconds(nNext))));
+  } //while
+} //RunTimer
+
+/// Stop the timer thread and wait for it to exit. The timer wheel is left
+/// as it is, and the timer thread is started again if another task
+/// descriptor is scheduled.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::StopTimer(){
+  if(m_stdTimer.joinable()){
+    m_stdTimerMutex.lock();
+    m_bStopTimer = true;
+    m_stdTimerMutex.unlock();
+
+    m_cvTimer.notify_all();
+    m_stdTimer.join();
+    m_bStopTimer = false;
+  } //if
+} //StopTimer
+
 /// Reader function for the number of threads used by this application.
 /// Assumes that `m_nNumThreads` contains this value.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
 /// \return Number of threads used.
 
-template <class CTaskClass>
-const size_t CBaseThreadManager<CTaskClass>::GetNumThreads() const{
+template <class CTaskClass, class CQueueClass, class CDerived>
+const size_t CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::GetNumThreads() const
+{
   return m_nNumThreads;
 } //GetNumThreads
 
+/// Reader function for the number of threads that are running and have
+/// not retired. This differs from GetNumThreads() only in elastic mode.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return Number of running threads.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+const size_t CBaseThreadManager<CTaskClass, CQueueClass, 
+  CDerived>::GetNumLiveThreads() const
+{
+  return CCommon<CTaskClass, CQueueClass>::m_nNumLive;
+} //GetNumLiveThreads
+
+/// Take a snapshot of the statistics. This can be called at any time, even
+/// while the threads are running, to find stragglers and load imbalance as
+/// they happen. The snapshot is empty unless SetStats() has been called,
+/// except for the backpressure statistics, which are always collected
+/// since they cost nothing until a producer is throttled.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \return Snapshot of the statistics for each thread and for the manager.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+CStats CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::GetStats() const{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+
+  CStats stats; //result
+  stats.m_vWorker.resize(CCommonClass::m_nNumStats);
+
+  for(size_t i=0; i<CCommonClass::m_nNumStats; i++){
+    CCommonClass::m_pStats[i].Read(stats.m_vWorker[i]);
+    stats.m_vWorker[i].m_nThreadId = i;
+  } //for
+
+  m_cEndToEnd.Read(stats.m_cEndToEnd);
+  m_cThrottle.Read(stats.m_cThrottle);
+
+  return stats;
+} //GetStats
+
+/// Write the trace in Chrome trace event format, which can be loaded into
+/// `chrome://tracing` or https://ui.perfetto.dev to see which thread
+/// performed which task and when, and where the gaps were. This should be
+/// called only after the threads have finished, for example after Wait().
+/// Writes an empty trace unless SetTrace() has been called.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CDerived Your thread manager class for static dispatch, or void.
+/// \param out Output stream, for example an `std::ofstream`.
+
+template <class CTaskClass, class CQueueClass, class CDerived>
+void CBaseThreadManager<CTaskClass, CQueueClass, CDerived>::WriteTrace(
+  std::ostream& out) const
+{
+  typedef CCommon<CTaskClass, CQueueClass> CCommonClass; //shorthand
+  WriteChromeTrace(out, CCommonClass::m_pTrace, CCommonClass::m_nNumTraces);
+} //WriteTrace
+
 #endif //__BaseThreadManager_h__
@@ -0,0 +1,792 @@
+/// \file CallableTask.h
+/// \brief Interface for the callable task descriptor CCallableTask and the
+/// future class CFuture.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __CallableTask_h__
+#define __CallableTask_h__
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+#include "BaseTask.h"
+#include "TaskPool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureStateBase definition.
+
+/// \brief Base future state.
+///
+/// The part of the state shared between a CFuture and the task that
+/// fulfils it which does not depend on the result type: a reference count,
+/// a ready flag that waiters sleep on, an exception to be rethrown by
+/// the waiter if the task threw one, and an optional continuation to be
+/// called instead of waking a waiter, which is how a coroutine waits.
+
+class CFutureStateBase{
+  private:
+    std::atomic<int> m_nRefCount; ///< Reference count.
+    std::atomic<bool> m_bReady; ///< true when the result is available.
+    std::mutex m_stdMutex; ///< Mutex for waiters.
+    std::condition_variable m_cvReady; ///< Signalled when ready.
+    void (*m_pfnContinue)(void*) = nullptr; ///< Continuation.
+    void* m_pContinueArg = nullptr; ///< Argument for continuation.
+
+  protected:
+    std::exception_ptr m_pException; ///< Exception thrown by task, if any.
+
+    void MakeReady(); ///< Mark result as available and wake waiters.
+
+  public:
+    CFutureStateBase(); ///< Constructor.
+
+    void AddRef(); ///< Increment the reference count.
+    bool DropRef(); ///< Decrement the reference count.
+
+    bool IsReady() const; ///< Is the result available?
+    void Wait(); ///< Wait for the result.
+
+    template <class Clock, class Duration> 
+    bool WaitUntil(const std::chrono::time_point<Clock, Duration>&); ///< Timed.
+
+    void SetException(std::exception_ptr); ///< Fail with an exception.
+    bool SetContinuation(void (*)(void*), void*); ///< Call when ready.
+}; //CFutureStateBase
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureState definition.
+
+/// \brief Future state.
+///
+/// The state shared between a CFuture and the task that fulfils it. Future
+/// states are allocated from a CTaskPool, so submitting a task does not
+/// cost a heap allocation once the pool has warmed up.
+/// \tparam R Result type.
+
+template <class R>
+class CFutureState: 
+  public CFutureStateBase, 
+  public CPooledTask<CFutureState<R>>
+{
+  private:
+    typename std::aligned_storage<sizeof(R), 
+      std::alignment_of<R>::value>::type m_tValue; ///< Result.
+
+  public:
+    ~CFutureState(); ///< Destructor.
+
+    void Release(); ///< Drop a reference, deleting when none are left.
+    void SetValue(R&&); ///< Set the result.
+    R Get(); ///< Wait for and move out the result.
+}; //CFutureState
+
+/// \brief Future state for void results.
+///
+/// A specialization of CFutureState for tasks that return nothing.
+
+template <>
+class CFutureState<void>: 
+  public CFutureStateBase, 
+  public CPooledTask<CFutureState<void>>
+{
+  public:
+    void Release(); ///< Drop a reference, deleting when none are left.
+    void SetValue(); ///< Mark the task as done.
+    void Get(); ///< Wait for the task to be done.
+}; //CFutureState<void>
+
+/// \brief Future state for reference results.
+///
+/// A specialization of CFutureState for tasks that return a reference. A
+/// reference cannot be stored in place the way a value is, so a pointer to
+/// the object that it refers to is stored instead, as `std::promise<R&>`
+/// does. The object must outlive the future.
+/// \tparam R Type referred to by the result.
+
+template <class R>
+class CFutureState<R&>: 
+  public CFutureStateBase, 
+  public CPooledTask<CFutureState<R&>>
+{
+  private:
+    R* m_pValue = nullptr; ///< Pointer to the object referred to.
+
+  public:
+    void Release(); ///< Drop a reference, deleting when none are left.
+    void SetValue(R&); ///< Set the result.
+    R& Get(); ///< Wait for and get the result.
+}; //CFutureState<R&>
+
+///////////////////////////////////////////////////////////////////////////////
+// CFuture definition.
+
+/// \brief Future.
+///
+/// A lightweight handle to the result of a task submitted with
+/// CCallableThreadManager::Submit(). The result can be waited for and
+/// collected as soon as the task has been performed, independently of any
+/// other task. A CFuture can be moved but not copied. If the task throws an
+/// exception, then Get() rethrows it. If the task is discarded without
+/// being performed, for example by CBaseThreadManager::ForceExit(), then
+/// Get() throws an `std::future_error` with a broken promise error code.
+/// If the task returns a reference, then so does Get().
+/// \tparam R Result type.
+
+template <class R>
+class CFuture{
+  private:
+    CFutureState<R>* m_pState = nullptr; ///< Shared state.
+
+  public:
+    CFuture(); ///< Default constructor.
+    explicit CFuture(CFutureState<R>*); ///< Constructor.
+    CFuture(CFuture&&); ///< Move constructor.
+    CFuture& operator=(CFuture&&); ///< Move assignment.
+    ~CFuture(); ///< Destructor.
+
+    CFuture(const CFuture&) = delete; ///< No copying.
+    CFuture& operator=(const CFuture&) = delete; ///< No copying.
+
+    bool IsValid() const; ///< Does this refer to a task?
+    bool IsReady() const; ///< Is the result available?
+    void Wait() const; ///< Wait for the result.
+
+    template <class Rep, class Period> 
+    bool WaitFor(const std::chrono::duration<Rep, Period>&) const; ///< Timed.
+
+    bool OnReady(void (*)(void*), void*); ///< Call when ready.
+    R Get(); ///< Wait for and get the result.
+}; //CFuture
+
+///////////////////////////////////////////////////////////////////////////////
+// CCallableTask definition.
+
+/// \brief Callable task descriptor.
+///
+/// A task descriptor that performs an arbitrary callable object, such as a
+/// lambda, a function pointer, or an `std::function`. The callable is
+/// type-erased into a small buffer inside the task descriptor itself, so
+/// a callable whose captures fit into STORAGE_SIZE bytes costs no heap
+/// allocation. Larger callables are moved to the heap. Since the task
+/// descriptor is itself allocated from a CTaskPool and its Perform() is
+/// called directly by the threads, it adds very little overhead to the
+/// callable.
+///
+/// You will not normally create these yourself. They are created by
+/// CCallableThreadManager::Submit().
+
+class CCallableTask final: 
+  public CBaseTask, 
+  public CPooledTask<CCallableTask>, 
+  public CStaticTask<CCallableTask>
+{
+  public:
+    static const size_t STORAGE_SIZE = 64; ///< Size of small buffer.
+
+  private:
+    typename std::aligned_storage<STORAGE_SIZE>::type m_pStorage; ///< Buffer.
+    void* m_pCallable = nullptr; ///< Callable, in buffer or on heap.
+    void (*m_pfnInvoke)(void*) = nullptr; ///< Call the callable.
+    void (*m_pfnDestroy)(void*, bool) = nullptr; ///< Destroy the callable.
+
+    void Destroy(); ///< Destroy the callable.
+
+    template <class CCallable> 
+    static void Invoke(void*); ///< Call a callable.
+
+    template <class CCallable> 
+    static void Destroy(void*, bool); ///< Destroy a callable.
+
+    template <class CCallable> 
+    void* Emplace(CCallable&&, std::true_type); ///< Into the buffer.
+
+    template <class CCallable> 
+    void* Emplace(CCallable&&, std::false_type); ///< Onto the heap.
+
+  public:
+    CCallableTask(); ///< Constructor.
+    ~CCallableTask(); ///< Destructor.
+
+    template <class CCallable> 
+    void SetCallable(CCallable&&); ///< Set the callable.
+
+    void Perform(); ///< Perform the task.
+}; //CCallableTask
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureJob definition.
+
+/// \brief Future job.
+///
+/// A callable that calls a function object and stores its result, or the
+/// exception that it throws, in a future state. If it is destroyed
+/// without having been called, then it fails the future with a broken
+/// promise so that nobody waits for it forever.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+
+template <class F, class R>
+class CFutureJob{
+  private:
+    F m_fFunction; ///< The function object.
+    CFutureState<R>* m_pState = nullptr; ///< Where the result goes.
+
+    void Call(std::true_type); ///< Call and set void result.
+    void Call(std::false_type); ///< Call and set non-void result.
+
+  public:
+    CFutureJob(F&&, CFutureState<R>*); ///< Constructor.
+    CFutureJob(CFutureJob&&); ///< Move constructor.
+    ~CFutureJob(); ///< Destructor.
+
+    void operator()(); ///< Call the function object.
+}; //CFutureJob
+
+/// \brief Result of a callable.
+///
+/// The type returned by a callable of type F when called with arguments of
+/// types Args, after all of them have been decayed and stored as they would
+/// be by `std::bind`. This uses `std::invoke_result` where the library has
+/// it, since `std::result_of` was removed in C++20.
+/// \tparam F Callable type.
+/// \tparam Args Argument types.
+
+template <class F, class... Args>
+struct CResultOf{
+  #if defined(__cpp_lib_is_invocable) //C++17
+    typedef typename std::invoke_result<typename std::decay<F>::type&,
+      typename std::decay<Args>::type&...>::type type; ///< Result type.
+  #else //C++11 or C++14
+    typedef typename std::result_of<typename std::decay<F>::type&(
+      typename std::decay<Args>::type&...)>::type type; ///< Result type.
+  #endif //defined(__cpp_lib_is_invocable)
+}; //CResultOf
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureStateBase code.
+
+/// Constructor. The reference count starts at 2, one for the future and
+/// one for the task that fulfils it.
+
+inline CFutureStateBase::CFutureStateBase():
+  m_nRefCount(2), m_bReady(false){
+} //constructor
+
+/// Increment the reference count.
+
+inline void CFutureStateBase::AddRef(){
+  m_nRefCount.fetch_add(1, std::memory_order_relaxed);
+} //AddRef
+
+/// Decrement the reference count.
+/// \return true if that was the last reference.
+
+inline bool CFutureStateBase::DropRef(){
+  return m_nRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+} //DropRef
+
+/// Mark the result as available, wake anybody waiting for it, and call the
+/// continuation if there is one. The continuation is called from the
+/// thread that made the result available.
+
+inline void CFutureStateBase::MakeReady(){
+  m_stdMutex.lock();
+  m_bReady.store(true, std::memory_order_release);
+  void (*pfnContinue)(void*) = m_pfnContinue; //read under the lock
+  void* pArg = m_pContinueArg;
+  m_stdMutex.unlock();
+  m_cvReady.notify_all();
+
+  if(pfnContinue)
+    pfnContinue(pArg);
+} //MakeReady
+
+/// Determine whether the result is available without waiting.
+/// \return true if the result is available.
+
+inline bool CFutureStateBase::IsReady() const{
+  return m_bReady.load(std::memory_order_acquire);
+} //IsReady
+
+/// Wait until the result is available.
+
+inline void CFutureStateBase::Wait(){
+  if(IsReady())return; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+
+  while(!IsReady()) //guard against spurious wakeups
+    m_cvReady.wait(lock);
+} //Wait
+
+/// Wait until the result is available or a deadline passes.
+/// \tparam Clock Clock that the deadline is measured on.
+/// \tparam Duration Duration type of the deadline.
+/// \param deadline Time point after which to give up.
+/// \return true if the result is available.
+
+template <class Clock, class Duration> 
+bool CFutureStateBase::WaitUntil(
+  const std::chrono::time_point<Clock, Duration>& deadline)
+{
+  if(IsReady())return true; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+
+  while(!IsReady()) //guard against spurious wakeups
+    if(m_cvReady.wait_until(lock, deadline) == std::cv_status::timeout)
+      break;
+
+  return IsReady();
+} //WaitUntil
+
+/// Fail the future with an exception, which will be rethrown by Get().
+/// \param p Pointer to the exception.
+
+inline void CFutureStateBase::SetException(std::exception_ptr p){
+  m_pException = p;
+  MakeReady();
+} //SetException
+
+/// Set a function to be called by the thread that makes the result
+/// available, unless it is available already. Only one continuation can be
+/// set.
+/// \param pfn Pointer to the function.
+/// \param pArg Argument to call it with.
+/// \return true if the continuation was set, false if the result is
+/// already available, in which case the continuation will not be called.
+
+inline bool CFutureStateBase::SetContinuation(void (*pfn)(void*), void* pArg){
+  std::lock_guard<std::mutex> lock(m_stdMutex);
+
+  if(IsReady())return false;
+
+  m_pContinueArg = pArg;
+  m_pfnContinue = pfn;
+  return true;
+} //SetContinuation
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureState code.
+
+/// Destructor. Destroys the result if there is one.
+/// \tparam R Result type.
+
+template <class R>
+CFutureState<R>::~CFutureState(){
+  if(IsReady() && !m_pException)
+    reinterpret_cast<R*>(&m_tValue)->~R();
+} //destructor
+
+/// Drop a reference to this future state, and delete it if that was the
+/// last one.
+/// \tparam R Result type.
+
+template <class R>
+void CFutureState<R>::Release(){
+  if(DropRef())
+    delete this;
+} //Release
+
+/// Set the result and wake anybody waiting for it.
+/// \tparam R Result type.
+/// \param r The result.
+
+template <class R>
+void CFutureState<R>::SetValue(R&& r){
+  new (&m_tValue) R(std::move(r));
+  MakeReady();
+} //SetValue
+
+/// Wait for the result, then move it out. This must be called only once.
+/// \tparam R Result type.
+/// \return The result.
+
+template <class R>
+R CFutureState<R>::Get(){
+  Wait();
+
+  if(m_pException)
+    std::rethrow_exception(m_pException);
+
+  return std::move(*reinterpret_cast<R*>(&m_tValue));
+} //Get
+
+/// Drop a reference to this future state, and delete it if that was the
+/// last one.
+
+inline void CFutureState<void>::Release(){
+  if(DropRef())
+    delete this;
+} //Release
+
+/// Mark the task as done and wake anybody waiting for it.
+
+inline void CFutureState<void>::SetValue(){
+  MakeReady();
+} //SetValue
+
+/// Wait for the task to be done, rethrowing its exception if it threw one.
+
+inline void CFutureState<void>::Get(){
+  Wait();
+
+  if(m_pException)
+    std::rethrow_exception(m_pException);
+} //Get
+
+/// Drop a reference to this future state, and delete it if that was the
+/// last one.
+/// \tparam R Type referred to by the result.
+
+template <class R>
+void CFutureState<R&>::Release(){
+  if(DropRef())
+    delete this;
+} //Release
+
+/// Set the result and wake anybody waiting for it.
+/// \tparam R Type referred to by the result.
+/// \param r The result.
+
+template <class R>
+void CFutureState<R&>::SetValue(R& r){
+  m_pValue = &r;
+  MakeReady();
+} //SetValue
+
+/// Wait for the result, then get it.
+/// \tparam R Type referred to by the result.
+/// \return The result.
+
+template <class R>
+R& CFutureState<R&>::Get(){
+  Wait();
+
+  if(m_pException)
+    std::rethrow_exception(m_pException);
+
+  return *m_pValue;
+} //Get
+
+///////////////////////////////////////////////////////////////////////////////
+// CFuture code.
+
+/// Default constructor. The future does not refer to any task.
+/// \tparam R Result type.
+
+template <class R>
+CFuture<R>::CFuture(){
+} //constructor
+
+/// Constructor. Takes over a reference to a future state.
+/// \tparam R Result type.
+/// \param p Pointer to the future state.
+
+template <class R>
+CFuture<R>::CFuture(CFutureState<R>* p):
+  m_pState(p){
+} //constructor
+
+/// Move constructor.
+/// \tparam R Result type.
+/// \param f Future to move from.
+
+template <class R>
+CFuture<R>::CFuture(CFuture&& f):
+  m_pState(f.m_pState){
+  f.m_pState = nullptr;
+} //move constructor
+
+/// Move assignment.
+/// \tparam R Result type.
+/// \param f Future to move from.
+/// \return Reference to this future.
+
+template <class R>
+CFuture<R>& CFuture<R>::operator=(CFuture&& f){
+  if(this != &f){
+    if(m_pState)m_pState->Release();
+    m_pState = f.m_pState;
+    f.m_pState = nullptr;
+  } //if
+
+  return *this;
+} //operator=
+
+/// Destructor. Drops this future's reference to the shared state. The task
+/// will still be performed if it has not been already.
+/// \tparam R Result type.
+
+template <class R>
+CFuture<R>::~CFuture(){
+  if(m_pState)m_pState->Release();
+} //destructor
+
+/// Determine whether this future refers to a task.
+/// \tparam R Result type.
+/// \return true if this future refers to a task.
+
+template <class R>
+bool CFuture<R>::IsValid() const{
+  return m_pState != nullptr;
+} //IsValid
+
+/// Determine whether the result is available without waiting.
+/// \tparam R Result type.
+/// \return true if the result is available.
+
+template <class R>
+bool CFuture<R>::IsReady() const{
+  return m_pState && m_pState->IsReady();
+} //IsReady
+
+/// Wait until the result is available.
+/// \tparam R Result type.
+
+template <class R>
+void CFuture<R>::Wait() const{
+  if(m_pState)m_pState->Wait();
+} //Wait
+
+/// Wait until the result is available or a timeout expires.
+/// \tparam R Result type.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param timeout Maximum amount of time to wait.
+/// \return true if the result is available.
+
+template <class R>
+template <class Rep, class Period> 
+bool CFuture<R>::WaitFor(
+  const std::chrono::duration<Rep, Period>& timeout) const
+{
+  return m_pState && 
+    m_pState->WaitUntil(std::chrono::steady_clock::now() + timeout);
+} //WaitFor
+
+/// Arrange for a function to be called as soon as the result is available,
+/// from whichever thread makes it available, unless it is available
+/// already. This lets the result be waited for without blocking a thread.
+/// It must be called at most once.
+/// \tparam R Result type.
+/// \param pfn Pointer to the function.
+/// \param pArg Argument to call it with.
+/// \return true if pfn will be called, false if the result is available now.
+
+template <class R>
+bool CFuture<R>::OnReady(void (*pfn)(void*), void* pArg){
+  return m_pState && m_pState->SetContinuation(pfn, pArg);
+} //OnReady
+
+/// Wait for the result and get it. This must be called at most once.
+/// \tparam R Result type.
+/// \return The result.
+
+template <class R>
+R CFuture<R>::Get(){
+  return m_pState->Get();
+} //Get
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureJob code.
+
+/// Constructor.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+/// \param f Function object.
+/// \param p Pointer to future state that the result goes into.
+
+template <class F, class R>
+CFutureJob<F, R>::CFutureJob(F&& f, CFutureState<R>* p):
+  m_fFunction(std::move(f)), m_pState(p){
+} //constructor
+
+/// Move constructor.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+/// \param job Future job to move from.
+
+template <class F, class R>
+CFutureJob<F, R>::CFutureJob(CFutureJob&& job):
+  m_fFunction(std::move(job.m_fFunction)), m_pState(job.m_pState){
+  job.m_pState = nullptr;
+} //move constructor
+
+/// Destructor. If the function object was never called, then fail the
+/// future with a broken promise.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+
+template <class F, class R>
+CFutureJob<F, R>::~CFutureJob(){
+  if(m_pState){ //never called
+    m_pState->SetException(std::make_exception_ptr(
+      std::future_error(std::future_errc::broken_promise)));
+    m_pState->Release();
+  } //if
+} //destructor
+
+/// Call a function object that returns nothing.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+
+template <class F, class R>
+void CFutureJob<F, R>::Call(std::true_type){
+  m_fFunction();
+  m_pState->SetValue();
+} //Call
+
+/// Call a function object that returns a result.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+
+template <class F, class R>
+void CFutureJob<F, R>::Call(std::false_type){
+  m_pState->SetValue(m_fFunction());
+} //Call
+
+/// Call the function object and store its result or exception in the
+/// future state, then drop this job's reference to the future state.
+/// \tparam F Function object type.
+/// \tparam R Result type.
+
+template <class F, class R>
+void CFutureJob<F, R>::operator()(){
+  try{
+    Call(typename std::is_void<R>::type());
+  } //try
+
+  catch(...){
+    m_pState->SetException(std::current_exception());
+  } //catch
+
+  m_pState->Release();
+  m_pState = nullptr;
+} //operator()
+
+///////////////////////////////////////////////////////////////////////////////
+// CCallableTask code.
+
+/// Constructor.
+
+inline CCallableTask::CCallableTask(): CBaseTask(){
+} //constructor
+
+/// Destructor. Destroys the callable if it has not been performed.
+
+inline CCallableTask::~CCallableTask(){
+  Destroy();
+} //destructor
+
+/// Call a type-erased callable.
+/// \tparam CCallable Callable type.
+/// \param p Pointer to the callable.
+
+template <class CCallable> 
+void CCallableTask::Invoke(void* p){
+  (*static_cast<CCallable*>(p))();
+} //Invoke
+
+/// Destroy a type-erased callable.
+/// \tparam CCallable Callable type.
+/// \param p Pointer to the callable.
+/// \param bHeap true if the callable is on the heap, false if in the buffer.
+
+template <class CCallable> 
+void CCallableTask::Destroy(void* p, bool bHeap){
+  if(bHeap)
+    delete static_cast<CCallable*>(p);
+  else static_cast<CCallable*>(p)->~CCallable();
+} //Destroy
+
+/// Move or copy a callable into the small buffer.
+/// \tparam CCallable Callable type.
+/// \param f The callable.
+/// \return Pointer to the stored callable.
+
+template <class CCallable> 
+void* CCallableTask::Emplace(CCallable&& f, std::true_type){
+  typedef typename std::decay<CCallable>::type CType; //stored type
+  return new (&m_pStorage) CType(std::forward<CCallable>(f));
+} //Emplace
+
+/// Move or copy a callable onto the heap.
+/// \tparam CCallable Callable type.
+/// \param f The callable.
+/// \return Pointer to the stored callable.
+
+template <class CCallable> 
+void* CCallableTask::Emplace(CCallable&& f, std::false_type){
+  typedef typename std::decay<CCallable>::type CType; //stored type
+  return new CType(std::forward<CCallable>(f));
+} //Emplace
+
+/// Set the callable to be called by Perform(). It is moved into the small
+/// buffer if it fits and onto the heap if it does not.
+/// \tparam CCallable Callable type.
+/// \param f The callable.
+
+template <class CCallable> 
+void CCallableTask::SetCallable(CCallable&& f){
+  typedef typename std::decay<CCallable>::type CType; //stored type
+  typedef std::integral_constant<bool, sizeof(CType) <= STORAGE_SIZE && 
+    std::alignment_of<CType>::value <= 
+      std::alignment_of<decltype(m_pStorage)>::value> CFits; //fits buffer
+
+  Destroy();
+  m_pCallable = Emplace(std::forward<CCallable>(f), CFits());
+  m_pfnInvoke = &Invoke<CType>;
+  m_pfnDestroy = &Destroy<CType>;
+} //SetCallable
+
+/// Destroy the callable, if any, releasing anything that it captured.
+
+inline void CCallableTask::Destroy(){
+  if(m_pCallable){
+    m_pfnDestroy(m_pCallable, m_pCallable != (void*)&m_pStorage);
+    m_pCallable = nullptr;
+  } //if
+} //Destroy
+
+/// Perform the task by calling the callable, then destroy the callable so
+/// that anything it captured is released as soon as possible.
+
+inline void CCallableTask::Perform(){
+  if(m_pCallable){
+    m_pfnInvoke(m_pCallable);
+    Destroy();
+  } //if
+} //Perform
+
+#endif //__CallableTask_h__
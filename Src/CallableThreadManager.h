@@ -0,0 +1,138 @@
+/// \file CallableThreadManager.h
+/// \brief Header and code for the class CCallableThreadManager.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __CallableThreadManager_h__
+#define __CallableThreadManager_h__
+
+#include <functional>
+#include <utility>
+
+#include "BaseThreadManager.h"
+#include "CallableTask.h"
+#include "Coroutine.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CCallableThreadManager definition.
+
+/// \brief Callable thread manager.
+///
+/// A thread manager for arbitrary callables, which can be used directly
+/// without deriving a task descriptor class or a thread manager class.
+/// Submit() takes a callable and its arguments, wraps them up in a
+/// CCallableTask, inserts that into the request queue, and returns a
+/// CFuture from which the result can be collected as soon as the task has
+/// been performed. For example,
+///
+///     CCallableThreadManager<> tm;
+///     CFuture<int> f = tm.Submit([](int x){return x*x;}, 7);
+///     tm.Spawn();
+///     std::cout << f.Get() << std::endl; //prints 49
+///
+/// The results are delivered through the futures, so ProcessTask() does
+/// nothing, but the task descriptors are still recycled by Process() in the
+/// usual way. In persistent mode, call Process() from time to time so that
+/// they do not pile up in the result queue.
+///
+/// When compiled as C++20, a coroutine of type CCoTask can hop onto one of
+/// the threads with `co_await tm.Schedule()`, and can wait for a task
+/// without blocking a thread with `co_await tm.Submit(...)`.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CQueueClass=CThreadSafeQueue<CCallableTask*>>
+class CCallableThreadManager: public CBaseThreadManager<CCallableTask, 
+  CQueueClass, CCallableThreadManager<CQueueClass>>
+{
+  public:
+    template <class F, class... Args> 
+    CFuture<typename CResultOf<F, Args...>::type> 
+      Submit(F&&, Args&&...); ///< Submit a callable.
+
+    void ProcessTask(CCallableTask*); ///< Process the result of a task.
+
+  #if defined(__cpp_impl_coroutine) //C++20 coroutines
+    CScheduleAwaiter<CCallableThreadManager> Schedule(); ///< Hop onto thread.
+  #endif //defined(__cpp_impl_coroutine)
+}; //CCallableThreadManager
+
+///////////////////////////////////////////////////////////////////////////////
+// CCallableThreadManager code.
+
+/// Submit a callable to be called by one of the threads with the given
+/// arguments. The callable and the arguments are copied or moved into the
+/// task descriptor in the same way as by `std::bind`, so use `std::ref` to
+/// pass an argument by reference. 
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam F Callable type.
+/// \tparam Args Argument types.
+/// \param f Callable.
+/// \param args Arguments.
+/// \return A future for the result of calling f with args.
+
+template <class CQueueClass>
+template <class F, class... Args>
+CFuture<typename CResultOf<F, Args...>::type> 
+  CCallableThreadManager<CQueueClass>::Submit(F&& f, Args&&... args)
+{
+  typedef typename CResultOf<F, Args...>::type R; //result type
+
+  auto fn = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+  typedef decltype(fn) CBound; //bound callable type
+
+  CFutureState<R>* pState = new CFutureState<R>; //from pool
+  CCallableTask* pTask = new CCallableTask; //from pool
+  pTask->SetCallable(CFutureJob<CBound, R>(std::move(fn), pState));
+  this->Insert(pTask);
+
+  return CFuture<R>(pState);
+} //Submit
+
+/// Process the result of a task. This does nothing, since the result has
+/// already been delivered through the task's future, so the pointer to the
+/// task descriptor is left unnamed.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CQueueClass>
+void CCallableThreadManager<CQueueClass>::ProcessTask(CCallableTask*){
+  //stub
+} //ProcessTask
+
+#if defined(__cpp_impl_coroutine) //C++20 coroutines
+
+/// Get an awaitable that suspends the awaiting coroutine and resumes it
+/// from one of the threads, once a thread gets to it in the request queue.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \return An awaitable for `co_await`.
+
+template <class CQueueClass>
+CScheduleAwaiter<CCallableThreadManager<CQueueClass>> 
+  CCallableThreadManager<CQueueClass>::Schedule()
+{
+  return CScheduleAwaiter<CCallableThreadManager>(this);
+} //Schedule
+
+#endif //defined(__cpp_impl_coroutine)
+
+#endif //__CallableThreadManager_h__
@@ -26,35 +26,296 @@
 #ifndef __Common_h__
 #define __Common_h__
 
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+
+#if defined(_MSC_VER) //Windows Visual Studio
+  #include <intrin.h>
+#endif
+
 #include "ThreadSafeQueue.h"
+#include "LockFreeQueue.h"
+#include "WorkStealingDeque.h"
+#include "ResultBuffer.h"
+#include "Stats.h"
+#include "Trace.h"
+
+template <class CTaskClass, class CQueueClass=CThreadSafeQueue<CTaskClass*>>
+class CThread; //forward declaration
+
+/// \brief Idle policy.
+///
+/// What a thread in persistent mode does when it runs out of tasks. `Park`
+/// parks it at once, which uses no CPU time but costs tens of microseconds
+/// to wake it again. `Spin` has it spin for a while, executing a pause
+/// instruction each time around so as to go easy on its hyperthread
+/// sibling, then yield its CPU a few times, and only then park, so a task
+/// that arrives soon is picked up within a microsecond or so. `Adaptive`
+/// does the same, but each thread doubles its spin budget whenever
+/// spinning pays off and halves it whenever it has to park anyway, so that
+/// threads spin when tasks are arriving often and park quickly when they
+/// are not.
+
+enum class eIdle{
+  Park, Spin, Adaptive
+}; //eIdle
+
+/// Tell the CPU that this is a spin-wait loop, so that it can save power
+/// and give the other hyperthread on the same core more of a chance. This
+/// is the pause instruction on x86 and the yield instruction on ARM.
+
+inline void CpuRelax(){
+#if defined(_MSC_VER) //Windows Visual Studio
+  #if defined(_M_ARM64) || defined(_M_ARM)
+    __yield();
+  #else
+    _mm_pause();
+  #endif
+
+#else //g++, *nix
+  #if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+  #elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+  #endif
+#endif
+} //CpuRelax
 
 /// \brief Common.
 ///
 /// Variables to be shared between the threads and the thread manager,
-/// including the request queue, the result queue, and a Boolean value
-/// to be set if and when you want all threads to terminate without
-/// completing any more tasks.
+/// including the request queue, the result queue, the per-thread deques
+/// used in work-stealing mode, the per-thread result buffers that can be
+/// used instead of the result queue, the per-thread statistics and trace
+/// event buffers, the CPUs and NUMA node that each thread is placed on, the
+/// variables used to park idle threads in persistent mode and the policy
+/// for spinning before they park, the thread bookkeeping for elastic mode,
+/// the capacity of the request queue and the variables used to block
+/// producers when it is full, and an atomic Boolean value to be set if and
+/// when you want all threads to terminate without completing any more
+/// tasks. Tasks can poll that value through a CStopToken. The queues are
+/// instances of CThreadSafeQueue by default, but any class with the same
+/// `Insert()`, `Delete()`, and `Flush()` functions, such as CLockFreeQueue,
+/// can be used instead.
+///
+/// Each thread manager is a CCommon, and each of its threads holds a
+/// pointer to it, so that thread managers are isolated from one another
+/// even when they have the same task descriptor class. Several independent
+/// thread pools can therefore run side by side, for example one per NUMA
+/// node or one per client, without stealing each other's work.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
 
-template <class CTaskClass>
+template <class CTaskClass, class CQueueClass=CThreadSafeQueue<CTaskClass*>>
 class CCommon{
+  friend class CThread<CTaskClass, CQueueClass>;
+
   protected:
-    static CThreadSafeQueue<CTaskClass*> m_qRequest; ///< Request queue.
-    static CThreadSafeQueue<CTaskClass*> m_qResult; ///< Result queue.
+    CQueueClass m_qRequest; ///< Request queue.
+    CQueueClass m_qResult; ///< Result queue.
+
+    CWorkStealingDeque<CTaskClass*>* m_pDeque = nullptr; ///< Per-thread deques.
+    size_t m_nNumDeques = 0; ///< Number of deques, 0 if not work-stealing.
+    size_t m_nBatchSize = 1; ///< Max tasks a thread takes at once.
+
+    CResultBuffer<CTaskClass*>* m_pResultBuffer = nullptr; ///< Per-thread results.
+    size_t m_nNumResultBuffers = 0; ///< Number of result buffers, 0 if shared.
+    std::atomic<size_t> m_nNumResultWaiters; ///< Number waiting for results.
+    std::mutex m_stdResultMutex; ///< Mutex for waiting for results.
+    std::condition_variable m_cvResult; ///< For waiting for results.
 
-    static bool m_bForceExit; ///< Force exit flag.
+    CWorkerStats* m_pStats = nullptr; ///< Per-thread statistics.
+    size_t m_nNumStats = 0; ///< Number of statistics, 0 if not collecting.
+
+    CTraceBuffer* m_pTrace = nullptr; ///< Per-thread trace event buffers.
+    size_t m_nNumTraces = 0; ///< Number of trace buffers, 0 if not tracing.
+
+    std::vector<std::vector<size_t>> m_vCpuSet; ///< CPUs for each thread.
+    std::vector<size_t> m_vNodeId; ///< NUMA node for each thread.
+
+    std::atomic<bool> m_bForceExit; ///< Force exit flag, the stop flag.
+
+    std::atomic<bool> m_bPersistent; ///< Persistent mode flag.
+    std::atomic<bool> m_bStop; ///< Stop when out of tasks flag.
+    std::atomic<size_t> m_nNumIdle; ///< Number of parked threads.
+    eIdle m_eIdle = eIdle::Park; ///< Idle policy.
+    size_t m_nMaxSpin = 0; ///< Max pause instructions before yielding.
+    size_t m_nMaxYield = 0; ///< Max yields before parking.
+    std::mutex m_stdIdleMutex; ///< Mutex for parking threads.
+    std::condition_variable m_cvIdle; ///< For parking threads.
+
+    bool m_bElastic = false; ///< Elastic mode flag.
+    std::chrono::milliseconds m_tIdleTimeout; ///< Idle time before retiring.
+    size_t m_nMinThreads = 0; ///< Number of threads that never retire.
+    std::atomic<size_t> m_nNumLive; ///< Number of threads not retired.
+    std::atomic<size_t> m_nNumQueued; ///< Queue depth, if tracked.
+    std::mutex m_stdThreadMutex; ///< Mutex for the thread list.
+    std::atomic<size_t> m_nNumRunning; ///< Number of threads not exited.
+    std::condition_variable m_cvExit; ///< For waiting for threads to exit.
+
+    size_t m_nCapacity = 0; ///< Max ready tasks queued, 0 for no limit.
+    std::atomic<size_t> m_nNumSpaceWaiters; ///< Number waiting for room.
+    std::mutex m_stdSpaceMutex; ///< Mutex for waiting for room.
+    std::condition_variable m_cvSpace; ///< For waiting for room.
+    std::vector<bool> m_vRetired; ///< Which threads have retired.
+
+    void WakeIdleThread(size_t=1); ///< Wake parked threads, if any.
+    void WakeAllThreads(); ///< Wake all parked threads.
+    void WakeResultWaiter(); ///< Wake threads waiting for results, if any.
+    void WakeProducer(); ///< Wake producers waiting for room, if any.
+    const bool IsTrackingQueue() const; ///< Is the queue depth tracked?
+    const bool HasResults() const; ///< Are there results in the buffers?
+    void Trace(size_t, eTraceEvent, size_t); ///< Record a trace event.
+
+  public:
+    CCommon(); ///< Constructor.
+    ~CCommon(); ///< Destructor.
 }; //CCommon
 
 ///////////////////////////////////////////////////////////////////////////////
-// Declarations of CCommon variables.
+// CCommon code.
+
+/// Constructor.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+CCommon<CTaskClass, CQueueClass>::CCommon():
+  m_nNumResultWaiters(0), m_bForceExit(false), m_bPersistent(false),
+  m_bStop(false), m_nNumIdle(0), m_tIdleTimeout(0), m_nNumLive(0),
+  m_nNumQueued(0), m_nNumRunning(0), m_nNumSpaceWaiters(0){
+} //constructor
+
+/// Destructor. The task descriptors in the deques and result buffers belong
+/// to the thread manager, which should have deleted them by now.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+CCommon<CTaskClass, CQueueClass>::~CCommon(){
+  delete [] m_pDeque;
+  delete [] m_pResultBuffer;
+  delete [] m_pStats;
+  delete [] m_pTrace;
+} //destructor
+
+/// Wake parked threads after task descriptors have been inserted. The
+/// fence ensures that either a thread that is about to park sees the new
+/// task descriptors, or we see that it is about to park, so that wakeups
+/// are never lost. The mutex is only touched if there is a parked thread.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param n Number of task descriptors inserted.
+
+template <class CTaskClass, class CQueueClass>
+void CCommon<CTaskClass, CQueueClass>::WakeIdleThread(size_t n){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(m_nNumIdle.load(std::memory_order_relaxed) > 0){ //somebody is parked
+    m_stdIdleMutex.lock(); //wait until the parked thread is really waiting
+    m_stdIdleMutex.unlock();
+
+    if(n > 1) //enough work for more than one thread
+      m_cvIdle.notify_all();
+    else m_cvIdle.notify_one();
+  } //if
+} //WakeIdleThread
+
+/// Wake all parked threads, for example so that they can see a change in
+/// the force exit or stop flags.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+void CCommon<CTaskClass, CQueueClass>::WakeAllThreads(){
+  m_stdIdleMutex.lock(); 
+  m_stdIdleMutex.unlock();
+  m_cvIdle.notify_all();
+} //WakeAllThreads
+
+/// Wake threads waiting for results after task descriptors have been
+/// appended to a result buffer. The fence works the same way as the one in
+/// WakeIdleThread(), and the mutex is only touched if somebody is waiting.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+void CCommon<CTaskClass, CQueueClass>::WakeResultWaiter(){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 
-template <class CTaskClass>
-CThreadSafeQueue<CTaskClass*> CCommon<CTaskClass>::m_qRequest; ///< Request queue.
+  if(m_nNumResultWaiters.load(std::memory_order_relaxed) > 0){ 
+    m_stdResultMutex.lock(); //wait until the waiter is really waiting
+    m_stdResultMutex.unlock();
+    m_cvResult.notify_all();
+  } //if
+} //WakeResultWaiter
 
-template <class CTaskClass>
-CThreadSafeQueue<CTaskClass*> CCommon<CTaskClass>::m_qResult; ///< Result queue.
+/// Wake producers waiting for room in the request queue after task
+/// descriptors have been taken from it or a thread has exited. The fence
+/// works the same way as the one in WakeIdleThread(), and the mutex is only
+/// touched if somebody is waiting.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+void CCommon<CTaskClass, CQueueClass>::WakeProducer(){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(m_nNumSpaceWaiters.load(std::memory_order_relaxed) > 0){ 
+    m_stdSpaceMutex.lock(); //wait until the producer is really waiting
+    m_stdSpaceMutex.unlock();
+    m_cvSpace.notify_all();
+  } //if
+} //WakeProducer
+
+/// Check whether the number of ready task descriptors waiting to be
+/// performed is being counted in m_nNumQueued, which it is in elastic mode
+/// when the request queue has a capacity, and when idle threads spin,
+/// since they watch it to see when tasks arrive.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \return true if the queue depth is being tracked.
+
+template <class CTaskClass, class CQueueClass>
+const bool CCommon<CTaskClass, CQueueClass>::IsTrackingQueue() const{
+  return m_bElastic || m_nCapacity > 0 || m_eIdle != eIdle::Park;
+} //IsTrackingQueue
+
+/// Check whether any of the result buffers has something in it, without
+/// locking anything.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \return true if there is at least one result in the buffers.
+
+template <class CTaskClass, class CQueueClass>
+const bool CCommon<CTaskClass, CQueueClass>::HasResults() const{
+  for(size_t i=0; i<m_nNumResultBuffers; i++)
+    if(!m_pResultBuffer[i].IsEmpty())
+      return true;
+
+  return false;
+} //HasResults
+
+/// Record a trace event in the trace buffer of a thread, or in the thread
+/// manager's trace buffer, which is the last one. Does nothing if tracing
+/// is off.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param i Thread identifier, or max_size_t for the thread manager.
+/// \param e Event type.
+/// \param nTaskId Task identifier.
 
-template <class CTaskClass>
-bool CCommon<CTaskClass>::m_bForceExit = false; ///< Force exit flag.
+template <class CTaskClass, class CQueueClass>
+void CCommon<CTaskClass, CQueueClass>::Trace(size_t i, eTraceEvent e, 
+  size_t nTaskId)
+{
+  if(m_nNumTraces > 0){ //tracing
+    const size_t n = m_nNumTraces - 1; //number of thread trace buffers
+    m_pTrace[i == max_size_t? n: i%n].Record(e, nTaskId);
+  } //if
+} //Trace
 
 #endif //__Common_h__
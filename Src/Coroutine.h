@@ -0,0 +1,754 @@
+/// \file Coroutine.h
+/// \brief Header and code for the C++20 coroutine task CCoTask and the
+/// awaitables CScheduleAwaiter and CFutureAwaiter.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __Coroutine_h__
+#define __Coroutine_h__
+
+#if defined(__cpp_impl_coroutine) //C++20 coroutines
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "CallableTask.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CResumer definition.
+
+/// \brief Coroutine resumer.
+///
+/// The callable in the CCallableTask that CScheduleAwaiter inserts. Calling
+/// it resumes a coroutine. If it is destroyed without having been called,
+/// because the thread manager discarded its task, then it destroys the
+/// coroutine instead so that the coroutine frame is not leaked. See
+/// CCoPromiseBase for what that does to the coroutine's future and to any
+/// coroutine awaiting it.
+
+class CResumer{
+  private:
+    std::coroutine_handle<> m_hCoroutine; ///< Coroutine to resume.
+
+  public:
+    explicit CResumer(std::coroutine_handle<>); ///< Constructor.
+    CResumer(CResumer&&) noexcept; ///< Move constructor.
+    ~CResumer(); ///< Destructor.
+
+    CResumer(const CResumer&) = delete; ///< No copying.
+    CResumer& operator=(const CResumer&) = delete; ///< No copying.
+
+    void operator()(); ///< Resume the coroutine.
+}; //CResumer
+
+///////////////////////////////////////////////////////////////////////////////
+// CScheduleAwaiter definition.
+
+/// \brief Schedule awaiter.
+///
+/// An awaitable that suspends the awaiting coroutine and resumes it from
+/// one of a thread manager's threads, so that
+///
+///     co_await tm.Schedule();
+///
+/// hops onto a thread. The coroutine is resumed by a CCallableTask that is
+/// inserted into the thread manager's request queue in the usual way. If
+/// the thread manager discards that task without performing it, for example
+/// when it is destroyed, then the coroutine is destroyed instead of being
+/// resumed. A CCoTask coroutine destroyed like this takes any coroutines
+/// awaiting it with it, and the future of the one that was started fails
+/// with a broken promise.
+/// \tparam CManager Thread manager for CCallableTask, for example
+/// CCallableThreadManager.
+
+template <class CManager>
+class CScheduleAwaiter{
+  private:
+    CManager* m_pManager = nullptr; ///< Pointer to thread manager.
+
+  public:
+    explicit CScheduleAwaiter(CManager*); ///< Constructor.
+
+    bool await_ready() const noexcept; ///< Never ready.
+    void await_suspend(std::coroutine_handle<>); ///< Insert resumption.
+    void await_resume() const noexcept; ///< Nothing to return.
+}; //CScheduleAwaiter
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureAwaiter definition.
+
+/// \brief Future awaiter.
+///
+/// An awaitable that suspends the awaiting coroutine until the result of a
+/// CFuture is available, then resumes it from the thread that performed
+/// the task and returns the result, or rethrows the exception that the
+/// task threw. This lets a coroutine wait for a task submitted with
+/// CCallableThreadManager::Submit() without blocking a thread.
+///
+///     int n = co_await tm.Submit([](int x){return x*x;}, 7);
+///
+/// \tparam R Result type.
+
+template <class R>
+class CFutureAwaiter{
+  private:
+    CFuture<R>& m_cFuture; ///< The future.
+
+    static void Resume(void*); ///< Resume a coroutine.
+
+  public:
+    explicit CFutureAwaiter(CFuture<R>&); ///< Constructor.
+
+    bool await_ready() const; ///< Is the result available?
+    bool await_suspend(std::coroutine_handle<>); ///< Wait for result.
+    R await_resume(); ///< Get the result.
+}; //CFutureAwaiter
+
+template <class R> 
+CFutureAwaiter<R> operator co_await(CFuture<R>&); ///< Await a future.
+
+template <class R> 
+CFutureAwaiter<R> operator co_await(CFuture<R>&&); ///< Await a future.
+
+///////////////////////////////////////////////////////////////////////////////
+// CFinalAwaiter definition.
+
+/// \brief Final awaiter.
+///
+/// The awaitable that a CCoTask coroutine awaits when it finishes. It
+/// transfers control directly to the coroutine that awaited the CCoTask,
+/// if any, without growing the stack. A coroutine started with
+/// CCoTask::Start() instead has its result delivered to its CFuture and
+/// is destroyed.
+
+class CFinalAwaiter{
+  public:
+    bool await_ready() const noexcept; ///< Never ready.
+
+    template <class CPromise> std::coroutine_handle<> 
+      await_suspend(std::coroutine_handle<CPromise>) noexcept; ///< Finish.
+
+    void await_resume() const noexcept; ///< Nothing to return.
+}; //CFinalAwaiter
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoPromise definition.
+
+template <class R> class CCoTask;
+template <class R> class CCoPromise;
+
+/// \brief Base coroutine promise.
+///
+/// The part of a CCoTask coroutine's promise that does not depend on how
+/// the result is stored: the coroutine to resume when it finishes, the
+/// exception that it threw, and the future state that its result goes
+/// into if it was started with CCoTask::Start().
+///
+/// A coroutine is normally destroyed after it finishes, by its CCoTask or,
+/// if it was started, by itself. If it is destroyed while it is suspended
+/// by anything other than its CCoTask, which only happens when a CResumer
+/// is discarded, then nothing will ever resume it. The destructor then
+/// fails its future with a broken promise if it was started, or destroys
+/// the coroutine awaiting it if it was awaited, so that the failure works
+/// its way up to the coroutine that was started.
+/// \tparam R Result type.
+
+template <class R>
+class CCoPromiseBase{
+  protected:
+    std::coroutine_handle<> m_hContinuation; ///< Resume when done.
+    std::coroutine_handle<CCoPromise<R>>* m_pOwner = nullptr; ///< Awaiter's.
+    std::exception_ptr m_pException; ///< Exception thrown, if any.
+    CFutureState<R>* m_pState = nullptr; ///< Future state, if started.
+    bool m_bFinished = false; ///< Has the coroutine finished?
+
+  public:
+    ~CCoPromiseBase(); ///< Destructor.
+
+    CCoTask<R> get_return_object(); ///< Get the CCoTask.
+    std::suspend_always initial_suspend() const noexcept; ///< Start lazily.
+    CFinalAwaiter final_suspend() const noexcept; ///< Finish.
+    void unhandled_exception(); ///< Catch an exception.
+
+    void SetContinuation(std::coroutine_handle<>, 
+      std::coroutine_handle<CCoPromise<R>>*); ///< Resume when done.
+    void SetFuture(CFutureState<R>*); ///< Deliver to future when done.
+    std::coroutine_handle<> Finish(std::coroutine_handle<>); ///< Finish.
+}; //CCoPromiseBase
+
+/// \brief Coroutine promise.
+///
+/// The promise of a CCoTask coroutine, which stores its result.
+/// \tparam R Result type.
+
+template <class R>
+class CCoPromise: public CCoPromiseBase<R>{
+  private:
+    std::optional<R> m_tValue; ///< Result.
+
+  public:
+    void return_value(R&&); ///< Set the result.
+    void return_value(const R&); ///< Set the result.
+
+    R GetResult(); ///< Move out the result.
+    void Deliver(); ///< Deliver the result to the future state.
+}; //CCoPromise
+
+/// \brief Coroutine promise for void results.
+///
+/// A specialization of CCoPromise for coroutines that return nothing.
+
+template <>
+class CCoPromise<void>: public CCoPromiseBase<void>{
+  public:
+    void return_void() const noexcept; ///< Return nothing.
+
+    void GetResult(); ///< Rethrow the exception, if any.
+    void Deliver(); ///< Deliver to the future state.
+}; //CCoPromise<void>
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoTask definition.
+
+/// \brief Coroutine task.
+///
+/// The return type of a coroutine that runs on a thread manager's threads.
+/// The coroutine does not start until it is awaited or started. Awaiting it
+/// from another coroutine runs it until it finishes, then resumes the
+/// awaiting coroutine with its result. Start() runs it from a function that
+/// is not a coroutine and returns a CFuture for its result. For example,
+///
+///     CCoTask<int> Handle(CCallableThreadManager<>& tm, int x){
+///       co_await tm.Schedule(); //hop onto a thread
+///       int y = co_await tm.Submit([](int x){return x*x;}, x);
+///       co_return y + 1;
+///     } //Handle
+///
+///     CFuture<int> f = Handle(tm, 7).Start();
+///     tm.Spawn();
+///     std::cout << f.Get() << std::endl; //prints 50
+///
+/// A suspended coroutine occupies no thread, so any number of them can
+/// share a handful of threads. Each one resumes on whichever thread
+/// performs the task that it is waiting for.
+/// \tparam R Result type.
+
+template <class R=void>
+class CCoTask{
+  public:
+    typedef CCoPromise<R> promise_type; ///< Promise type.
+    typedef std::coroutine_handle<promise_type> CHandle; ///< Handle type.
+
+  private:
+    CHandle m_hCoroutine; ///< The coroutine.
+
+    void Destroy(); ///< Destroy the coroutine.
+
+  public:
+    explicit CCoTask(CHandle); ///< Constructor.
+    CCoTask(CCoTask&&) noexcept; ///< Move constructor.
+    CCoTask& operator=(CCoTask&&) noexcept; ///< Move assignment.
+    ~CCoTask(); ///< Destructor.
+
+    CCoTask(const CCoTask&) = delete; ///< No copying.
+    CCoTask& operator=(const CCoTask&) = delete; ///< No copying.
+
+    bool await_ready() const noexcept; ///< Never ready.
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<>); ///< Run.
+    R await_resume(); ///< Get the result.
+
+    CFuture<R> Start(); ///< Run with a future for the result.
+}; //CCoTask
+
+///////////////////////////////////////////////////////////////////////////////
+// CResumer code.
+
+/// Constructor.
+/// \param h Handle of the coroutine to resume.
+
+inline CResumer::CResumer(std::coroutine_handle<> h):
+  m_hCoroutine(h){
+} //constructor
+
+/// Move constructor.
+/// \param r Resumer to move from.
+
+inline CResumer::CResumer(CResumer&& r) noexcept:
+  m_hCoroutine(r.m_hCoroutine){
+  r.m_hCoroutine = nullptr;
+} //move constructor
+
+/// Destructor. If the coroutine was never resumed, then destroy it.
+
+inline CResumer::~CResumer(){
+  if(m_hCoroutine)m_hCoroutine.destroy();
+} //destructor
+
+/// Resume the coroutine. This resumer is done with it once it is resumed.
+
+inline void CResumer::operator()(){
+  std::coroutine_handle<> h = m_hCoroutine;
+  m_hCoroutine = nullptr;
+  h.resume();
+} //operator()
+
+///////////////////////////////////////////////////////////////////////////////
+// CScheduleAwaiter code.
+
+/// Constructor.
+/// \tparam CManager Thread manager type.
+/// \param p Pointer to thread manager.
+
+template <class CManager>
+CScheduleAwaiter<CManager>::CScheduleAwaiter(CManager* p):
+  m_pManager(p){
+} //constructor
+
+/// The awaiting coroutine is always suspended.
+/// \tparam CManager Thread manager type.
+/// \return false.
+
+template <class CManager>
+bool CScheduleAwaiter<CManager>::await_ready() const noexcept{
+  return false;
+} //await_ready
+
+/// Insert a task that resumes the awaiting coroutine into the thread
+/// manager's request queue, or destroys it if the task is discarded. The
+/// coroutine may be resumed by a thread before this function returns, so
+/// nothing in it may be used after the insertion.
+/// \tparam CManager Thread manager type.
+/// \param h Handle of the awaiting coroutine.
+
+template <class CManager>
+void CScheduleAwaiter<CManager>::await_suspend(std::coroutine_handle<> h){
+  CCallableTask* pTask = new CCallableTask; //from pool
+  pTask->SetCallable(CResumer(h));
+  m_pManager->Insert(pTask);
+} //await_suspend
+
+/// Resume the coroutine. There is no result.
+/// \tparam CManager Thread manager type.
+
+template <class CManager>
+void CScheduleAwaiter<CManager>::await_resume() const noexcept{
+} //await_resume
+
+///////////////////////////////////////////////////////////////////////////////
+// CFutureAwaiter code.
+
+/// Constructor.
+/// \tparam R Result type.
+/// \param f The future to wait for.
+
+template <class R>
+CFutureAwaiter<R>::CFutureAwaiter(CFuture<R>& f):
+  m_cFuture(f){
+} //constructor
+
+/// Resume a coroutine.
+/// \tparam R Result type.
+/// \param p Address of the coroutine.
+
+template <class R>
+void CFutureAwaiter<R>::Resume(void* p){
+  std::coroutine_handle<>::from_address(p).resume();
+} //Resume
+
+/// Determine whether the result is available, in which case the awaiting
+/// coroutine is not suspended.
+/// \tparam R Result type.
+/// \return true if the result is available.
+
+template <class R>
+bool CFutureAwaiter<R>::await_ready() const{
+  return m_cFuture.IsReady();
+} //await_ready
+
+/// Arrange for the awaiting coroutine to be resumed by the thread that
+/// makes the result available.
+/// \tparam R Result type.
+/// \param h Handle of the awaiting coroutine.
+/// \return false if the result became available in the meantime, in which
+/// case the awaiting coroutine is resumed immediately.
+
+template <class R>
+bool CFutureAwaiter<R>::await_suspend(std::coroutine_handle<> h){
+  return m_cFuture.OnReady(&Resume, h.address());
+} //await_suspend
+
+/// Get the result, rethrowing the exception that the task threw, if any.
+/// \tparam R Result type.
+/// \return The result.
+
+template <class R>
+R CFutureAwaiter<R>::await_resume(){
+  return m_cFuture.Get();
+} //await_resume
+
+/// Await a future.
+/// \tparam R Result type.
+/// \param f The future.
+/// \return An awaitable for the result of f.
+
+template <class R> 
+CFutureAwaiter<R> operator co_await(CFuture<R>& f){
+  return CFutureAwaiter<R>(f);
+} //operator co_await
+
+/// Await a temporary future, such as the one returned by
+/// CCallableThreadManager::Submit(). The future lives until the end of the
+/// full expression that contains the `co_await`.
+/// \tparam R Result type.
+/// \param f The future.
+/// \return An awaitable for the result of f.
+
+template <class R> 
+CFutureAwaiter<R> operator co_await(CFuture<R>&& f){
+  return CFutureAwaiter<R>(f);
+} //operator co_await
+
+///////////////////////////////////////////////////////////////////////////////
+// CFinalAwaiter code.
+
+/// A finished coroutine is always suspended.
+/// \return false.
+
+inline bool CFinalAwaiter::await_ready() const noexcept{
+  return false;
+} //await_ready
+
+/// Finish a coroutine.
+/// \tparam CPromise Promise type.
+/// \param h Handle of the finished coroutine.
+/// \return Handle of the coroutine to transfer control to.
+
+template <class CPromise> 
+std::coroutine_handle<> CFinalAwaiter::await_suspend(
+  std::coroutine_handle<CPromise> h) noexcept
+{
+  return h.promise().Finish(h);
+} //await_suspend
+
+/// Never called, since a finished coroutine is never resumed.
+
+inline void CFinalAwaiter::await_resume() const noexcept{
+} //await_resume
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoPromiseBase code.
+
+/// Destructor. If the coroutine is being destroyed before it has finished,
+/// then fail its future with a broken promise if it was started, or else
+/// destroy the coroutine that awaited it, if any, after making sure that
+/// the awaiting coroutine's CCoTask will not destroy this one again.
+/// \tparam R Result type.
+
+template <class R>
+CCoPromiseBase<R>::~CCoPromiseBase(){
+  if(m_bFinished)return; //nothing to clean up
+
+  if(m_pState){ //started
+    m_pState->SetException(std::make_exception_ptr(
+      std::future_error(std::future_errc::broken_promise)));
+    m_pState->Release();
+  } //if
+
+  else if(m_hContinuation){ //awaited
+    *m_pOwner = nullptr;
+    m_hContinuation.destroy();
+  } //else if
+} //destructor
+
+/// Get the CCoTask that the coroutine returns to its caller.
+/// \tparam R Result type.
+/// \return A CCoTask that owns the coroutine.
+
+template <class R>
+CCoTask<R> CCoPromiseBase<R>::get_return_object(){
+  return CCoTask<R>(std::coroutine_handle<CCoPromise<R>>::from_promise(
+    static_cast<CCoPromise<R>&>(*this)));
+} //get_return_object
+
+/// A coroutine is suspended as soon as it is created, and does not run
+/// until it is awaited or started.
+/// \tparam R Result type.
+/// \return An awaitable that always suspends.
+
+template <class R>
+std::suspend_always CCoPromiseBase<R>::initial_suspend() const noexcept{
+  return std::suspend_always();
+} //initial_suspend
+
+/// Get the awaitable that a coroutine awaits when it finishes.
+/// \tparam R Result type.
+/// \return The final awaiter.
+
+template <class R>
+CFinalAwaiter CCoPromiseBase<R>::final_suspend() const noexcept{
+  return CFinalAwaiter();
+} //final_suspend
+
+/// Catch an exception thrown by the coroutine, to be rethrown to whoever
+/// awaits its result.
+/// \tparam R Result type.
+
+template <class R>
+void CCoPromiseBase<R>::unhandled_exception(){
+  m_pException = std::current_exception();
+} //unhandled_exception
+
+/// Set the coroutine to be resumed when this one finishes.
+/// \tparam R Result type.
+/// \param h Handle of the coroutine to be resumed, or nullptr for none.
+/// \param p Pointer to the handle of this coroutine in the CCoTask that it
+/// awaits.
+
+template <class R>
+void CCoPromiseBase<R>::SetContinuation(std::coroutine_handle<> h, 
+  std::coroutine_handle<CCoPromise<R>>* p)
+{
+  m_hContinuation = h;
+  m_pOwner = p;
+} //SetContinuation
+
+/// Set the future state that the result is to be delivered to. The
+/// coroutine will destroy itself when it finishes.
+/// \tparam R Result type.
+/// \param p Pointer to future state.
+
+template <class R>
+void CCoPromiseBase<R>::SetFuture(CFutureState<R>* p){
+  m_pState = p;
+} //SetFuture
+
+/// Finish the coroutine. If it was started, then deliver the result to the
+/// future and destroy the coroutine, which must not be used after that.
+/// Otherwise transfer control to the coroutine that awaited it.
+/// \tparam R Result type.
+/// \param h Handle of this coroutine.
+/// \return Handle of the coroutine to transfer control to.
+
+template <class R>
+std::coroutine_handle<> CCoPromiseBase<R>::Finish(std::coroutine_handle<> h){
+  m_bFinished = true;
+
+  if(m_pState){ //started
+    static_cast<CCoPromise<R>*>(this)->Deliver();
+    h.destroy();
+    return std::noop_coroutine();
+  } //if
+
+  if(m_hContinuation)
+    return m_hContinuation;
+
+  return std::noop_coroutine();
+} //Finish
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoPromise code.
+
+/// Set the result by moving it.
+/// \tparam R Result type.
+/// \param r The result.
+
+template <class R>
+void CCoPromise<R>::return_value(R&& r){
+  m_tValue.emplace(std::move(r));
+} //return_value
+
+/// Set the result by copying it.
+/// \tparam R Result type.
+/// \param r The result.
+
+template <class R>
+void CCoPromise<R>::return_value(const R& r){
+  m_tValue.emplace(r);
+} //return_value
+
+/// Move out the result, or rethrow the exception that the coroutine threw.
+/// \tparam R Result type.
+/// \return The result.
+
+template <class R>
+R CCoPromise<R>::GetResult(){
+  if(this->m_pException)
+    std::rethrow_exception(this->m_pException);
+
+  return std::move(*m_tValue);
+} //GetResult
+
+/// Deliver the result or the exception to the future state, then drop the
+/// coroutine's reference to it.
+/// \tparam R Result type.
+
+template <class R>
+void CCoPromise<R>::Deliver(){
+  if(this->m_pException)
+    this->m_pState->SetException(this->m_pException);
+  else this->m_pState->SetValue(std::move(*m_tValue));
+
+  this->m_pState->Release();
+  this->m_pState = nullptr;
+} //Deliver
+
+/// Return nothing.
+
+inline void CCoPromise<void>::return_void() const noexcept{
+} //return_void
+
+/// Rethrow the exception that the coroutine threw, if any.
+
+inline void CCoPromise<void>::GetResult(){
+  if(m_pException)
+    std::rethrow_exception(m_pException);
+} //GetResult
+
+/// Deliver completion or the exception to the future state, then drop the
+/// coroutine's reference to it.
+
+inline void CCoPromise<void>::Deliver(){
+  if(m_pException)
+    m_pState->SetException(m_pException);
+  else m_pState->SetValue();
+
+  m_pState->Release();
+  m_pState = nullptr;
+} //Deliver
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoTask code.
+
+/// Constructor.
+/// \tparam R Result type.
+/// \param h Handle of the coroutine.
+
+template <class R>
+CCoTask<R>::CCoTask(CHandle h):
+  m_hCoroutine(h){
+} //constructor
+
+/// Move constructor.
+/// \tparam R Result type.
+/// \param t CCoTask to move from.
+
+template <class R>
+CCoTask<R>::CCoTask(CCoTask&& t) noexcept:
+  m_hCoroutine(t.m_hCoroutine){
+  t.m_hCoroutine = nullptr;
+} //move constructor
+
+/// Move assignment.
+/// \tparam R Result type.
+/// \param t CCoTask to move from.
+/// \return Reference to this CCoTask.
+
+template <class R>
+CCoTask<R>& CCoTask<R>::operator=(CCoTask&& t) noexcept{
+  if(this != &t){
+    Destroy();
+    m_hCoroutine = t.m_hCoroutine;
+    t.m_hCoroutine = nullptr;
+  } //if
+
+  return *this;
+} //operator=
+
+/// Destructor. Destroys the coroutine unless it has been started. A
+/// coroutine that has been awaited will have finished by now.
+/// \tparam R Result type.
+
+template <class R>
+CCoTask<R>::~CCoTask(){
+  Destroy();
+} //destructor
+
+/// Destroy the coroutine, if any. It is told first that nothing is awaiting
+/// it, so that it does not destroy the coroutine that this CCoTask is in.
+/// \tparam R Result type.
+
+template <class R>
+void CCoTask<R>::Destroy(){
+  if(m_hCoroutine){
+    m_hCoroutine.promise().SetContinuation(nullptr, nullptr);
+    m_hCoroutine.destroy();
+  } //if
+} //Destroy
+
+/// The awaiting coroutine is always suspended while this one runs.
+/// \tparam R Result type.
+/// \return false.
+
+template <class R>
+bool CCoTask<R>::await_ready() const noexcept{
+  return false;
+} //await_ready
+
+/// Run this coroutine, resuming the awaiting coroutine when it finishes.
+/// \tparam R Result type.
+/// \param h Handle of the awaiting coroutine.
+/// \return Handle of this coroutine, to transfer control to.
+
+template <class R>
+std::coroutine_handle<> CCoTask<R>::await_suspend(std::coroutine_handle<> h){
+  m_hCoroutine.promise().SetContinuation(h, &m_hCoroutine);
+  return m_hCoroutine;
+} //await_suspend
+
+/// Get the result, rethrowing the exception that the coroutine threw, if
+/// any.
+/// \tparam R Result type.
+/// \return The result.
+
+template <class R>
+R CCoTask<R>::await_resume(){
+  return m_hCoroutine.promise().GetResult();
+} //await_resume
+
+/// Run this coroutine from a function that is not a coroutine. It runs on
+/// the calling thread until it first suspends, typically in
+/// CCallableThreadManager::Schedule(), then this function returns. The
+/// coroutine destroys itself when it finishes, and this CCoTask no longer
+/// refers to it.
+/// \tparam R Result type.
+/// \return A future for the result of the coroutine.
+
+template <class R>
+CFuture<R> CCoTask<R>::Start(){
+  CFutureState<R>* pState = new CFutureState<R>; //from pool
+  CHandle h = m_hCoroutine;
+  m_hCoroutine = nullptr;
+
+  h.promise().SetFuture(pState);
+  h.resume();
+
+  return CFuture<R>(pState);
+} //Start
+
+#endif //defined(__cpp_impl_coroutine)
+
+#endif //__Coroutine_h__
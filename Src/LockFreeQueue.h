@@ -0,0 +1,543 @@
+/// \file LockFreeQueue.h
+/// \brief Interface for the lock-free queue class CLockFreeQueue.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __LockFreeQueue_h__
+#define __LockFreeQueue_h__
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iterator>
+#include <deque>
+#include <cstddef>
+
+#include "BaseTask.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CLockFreeQueue definition.
+
+/// \brief Lock-free queue.
+///
+/// A bounded multi-producer, multi-consumer queue of task descriptors that
+/// can be used in place of CThreadSafeQueue. It is a ring buffer of cells,
+/// each with a sequence number that tells producers and consumers whether the
+/// cell is ready for them, so that a thread only ever contends with others
+/// on a single compare-and-swap instead of on a mutex. The head and tail
+/// positions are padded out to separate cache lines so that producers and
+/// consumers do not invalidate each other's caches.
+///
+/// The capacity of the ring buffer is rounded up to a power of two and can
+/// be changed with `SetCapacity()` before the queue is used. When the ring
+/// buffer is full, `Insert()` and `InsertBatch()` spill task descriptors
+/// into an overflow list protected by a mutex instead of waiting for room,
+/// and consumers take from the overflow list once the ring buffer is
+/// empty. A full queue therefore never blocks a producer, which matters
+/// because the threads are the producers for the result queue while the
+/// main thread may not be consuming from it at all. The queue is simply
+/// not lock-free again until the overflow list has drained, so make the
+/// capacity large enough for the usual number of task descriptors in the
+/// queue. `TryInsert()` refuses to spill, and reports a full queue instead.
+///
+/// Consumers that would rather wait for a task descriptor than poll for one
+/// can use `WaitDelete()`, `TryDeleteFor()`, or `TryDeleteUntil()`. Waiting
+/// consumers sleep on an `std::condition_variable`, but producers touch its
+/// mutex only when they see that there is somebody waiting, so insertion
+/// stays lock-free when nobody is.
+///
+/// `InsertBatch()` and `DeleteUpTo()` claim a run of consecutive cells
+/// with a single compare-and-swap, so that a batch of task descriptors costs
+/// about as much synchronization as a single one.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CLockFreeQueue{ 
+  private:
+    /// \brief Ring buffer cell.
+    ///
+    /// A cell holds an element and a sequence number. A cell at position
+    /// `pos` is free for a producer when its sequence number is `pos`, and
+    /// full for a consumer when it is `pos + 1`.
+
+    struct CCell{
+      std::atomic<size_t> m_nSequence; ///< Sequence number.
+      CTaskClass m_tElement; ///< The task descriptor.
+    }; //CCell
+
+    static const size_t DEFAULT_CAPACITY = 1 << 16; ///< Default capacity.
+
+    char m_pPad0[CACHE_LINE_SIZE]; ///< Padding.
+    CCell* m_pBuffer = nullptr; ///< Ring buffer.
+    size_t m_nMask = 0; ///< Capacity minus 1.
+    char m_pPad1[CACHE_LINE_SIZE]; ///< Padding.
+    std::atomic<size_t> m_nEnqueuePos; ///< Position of next insertion.
+    char m_pPad2[CACHE_LINE_SIZE]; ///< Padding.
+    std::atomic<size_t> m_nDequeuePos; ///< Position of next deletion.
+    char m_pPad3[CACHE_LINE_SIZE]; ///< Padding.
+
+    std::atomic<size_t> m_nNumWaiters; ///< Number of consumers waiting.
+    std::mutex m_stdMutex; ///< Mutex for waiting consumers.
+    std::condition_variable m_cvNotEmpty; ///< Signalled on insertion.
+
+    std::atomic<size_t> m_nNumSpilled; ///< Number in overflow list.
+    std::mutex m_stdSpillMutex; ///< Mutex for the overflow list.
+    std::deque<CTaskClass> m_qSpill; ///< Overflow list for when full.
+
+    void WakeWaiter(); ///< Wake a waiting consumer, if any.
+
+    template <class ForwardIt> 
+    void Spill(ForwardIt first, size_t n); ///< Insert into overflow list.
+
+    template <class OutputIt> 
+    size_t Unspill(OutputIt out, size_t n); ///< Delete from overflow list.
+
+  public:
+    CLockFreeQueue(size_t n=DEFAULT_CAPACITY); ///< Constructor.
+    ~CLockFreeQueue(); ///< Destructor.
+
+    void Insert(const CTaskClass& element); ///< Insert task at tail.
+    bool TryInsert(const CTaskClass& element); ///< Insert task unless full.
+    bool Delete(CTaskClass& element); ///< Delete task from head.
+    void Flush(); ///< Flush out and discard all tasks in queue.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt first, ForwardIt last); ///< Insert many tasks.
+
+    template <class OutputIt> 
+    size_t DeleteUpTo(OutputIt out, size_t n); ///< Delete many tasks.
+
+    void WaitDelete(CTaskClass& element); ///< Wait for task then delete it.
+
+    template <class Rep, class Period> 
+    bool TryDeleteFor(CTaskClass& element, 
+      const std::chrono::duration<Rep, Period>& timeout); ///< Wait for a time.
+
+    template <class Clock, class Duration> 
+    bool TryDeleteUntil(CTaskClass& element, 
+      const std::chrono::time_point<Clock, Duration>& deadline); ///< Wait until.
+
+    void SetCapacity(size_t n); ///< Set capacity.
+    const size_t GetCapacity() const; ///< Get capacity.
+}; //CLockFreeQueue
+
+///////////////////////////////////////////////////////////////////////////////
+// CLockFreeQueue code.
+
+/// Constructor.
+/// \tparam CTaskClass Task descriptor.
+/// \param n Minimum capacity, which will be rounded up to a power of two.
+
+template <class CTaskClass>
+CLockFreeQueue<CTaskClass>::CLockFreeQueue(size_t n):
+  m_nEnqueuePos(0), m_nDequeuePos(0), m_nNumWaiters(0), m_nNumSpilled(0){
+  SetCapacity(n);
+} //constructor
+
+/// Destructor.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+CLockFreeQueue<CTaskClass>::~CLockFreeQueue(){
+  delete [] m_pBuffer;
+} //destructor
+
+/// Discard the contents of the queue and reallocate the ring buffer with a
+/// new capacity. This is not thread-safe, so it must be called only when no
+/// other thread is using the queue.
+/// \tparam CTaskClass Task descriptor.
+/// \param n Minimum capacity, which will be rounded up to a power of two.
+
+template <class CTaskClass>
+void CLockFreeQueue<CTaskClass>::SetCapacity(size_t n){
+  size_t nCapacity = 2; //capacity must be a power of two, at least 2
+
+  while(nCapacity < n)
+    nCapacity <<= 1;
+
+  delete [] m_pBuffer;
+  m_pBuffer = new CCell[nCapacity];
+  m_nMask = nCapacity - 1;
+
+  for(size_t i=0; i<nCapacity; i++)
+    m_pBuffer[i].m_nSequence.store(i, std::memory_order_relaxed);
+
+  m_nEnqueuePos.store(0, std::memory_order_relaxed);
+  m_nDequeuePos.store(0, std::memory_order_relaxed);
+
+  m_qSpill.clear();
+  m_nNumSpilled.store(0, std::memory_order_relaxed);
+} //SetCapacity
+
+/// Reader function for the capacity.
+/// \tparam CTaskClass Task descriptor.
+/// \return Maximum number of task descriptors that the queue can hold.
+
+template <class CTaskClass>
+const size_t CLockFreeQueue<CTaskClass>::GetCapacity() const{
+  return m_nMask + 1;
+} //GetCapacity
+
+/// Insert a task descriptor into the queue if there is room for it in the
+/// ring buffer and nothing has spilled into the overflow list. The
+/// producer claims a cell by advancing the enqueue position with a
+/// compare-and-swap, then publishes the element by bumping the cell's
+/// sequence number. If there are consumers waiting for a task descriptor,
+/// then one of them is woken.
+/// \tparam CTaskClass Task descriptor.
+/// \param element The element to be inserted into the queue.
+/// \return true if the insert was successful, ie. the queue was not full.
+
+template <class CTaskClass>
+bool CLockFreeQueue<CTaskClass>::TryInsert(const CTaskClass& element){
+  if(m_nNumSpilled.load(std::memory_order_relaxed) > 0)
+    return false; //older task descriptors are waiting in the overflow list
+
+  size_t pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+
+  while(true){ //until we claim a cell or find the queue full
+    CCell* pCell = &m_pBuffer[pos & m_nMask];
+    const size_t seq = pCell->m_nSequence.load(std::memory_order_acquire);
+    const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+
+    if(diff == 0){ //cell is free
+      if(m_nEnqueuePos.compare_exchange_weak(pos, pos + 1,
+        std::memory_order_relaxed))
+      {
+        pCell->m_tElement = element;
+        pCell->m_nSequence.store(pos + 1, std::memory_order_release);
+        WakeWaiter(); //in case a consumer is waiting
+        return true;
+      } //if
+    } //if
+
+    else if(diff < 0) //cell still full from the last lap, so queue is full
+      return false;
+
+    else pos = m_nEnqueuePos.load(std::memory_order_relaxed); //lost a race
+  } //while
+} //TryInsert
+
+/// Insert a task descriptor into the queue, spilling it into the overflow
+/// list if the ring buffer is full.
+/// \tparam CTaskClass Task descriptor.
+/// \param element The element to be inserted into the queue.
+
+template <class CTaskClass>
+void CLockFreeQueue<CTaskClass>::Insert(const CTaskClass& element){
+  if(!TryInsert(element))
+    Spill(&element, 1);
+} //Insert
+
+/// Delete and return a task descriptor from the queue. The consumer claims a
+/// cell by advancing the dequeue position with a compare-and-swap, then
+/// frees it for the producers one lap ahead by bumping its sequence number.
+/// If the ring buffer is empty, then the task descriptor is taken from the
+/// overflow list instead.
+/// \tparam CTaskClass Task descriptor.
+/// \param element [OUT] The element deleted from the queue.
+/// \return true if the delete was successful, ie. the queue was not empty.
+
+template <class CTaskClass>
+bool CLockFreeQueue<CTaskClass>::Delete(CTaskClass& element){
+  size_t pos = m_nDequeuePos.load(std::memory_order_relaxed);
+
+  while(true){ //until we claim a cell or find the queue empty
+    CCell* pCell = &m_pBuffer[pos & m_nMask];
+    const size_t seq = pCell->m_nSequence.load(std::memory_order_acquire);
+    const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+
+    if(diff == 0){ //cell is full
+      if(m_nDequeuePos.compare_exchange_weak(pos, pos + 1,
+        std::memory_order_relaxed))
+      {
+        element = pCell->m_tElement;
+        pCell->m_nSequence.store(pos + m_nMask + 1, std::memory_order_release);
+        return true;
+      } //if
+    } //if
+
+    else if(diff < 0) //cell not yet written, so ring buffer is empty
+      return Unspill(&element, 1) == 1;
+
+    else pos = m_nDequeuePos.load(std::memory_order_relaxed); //lost a race
+  } //while
+} //Delete
+
+/// Insert a range of task descriptors into the queue. The producer scans
+/// forward from the enqueue position for a run of free cells and claims
+/// the whole run with a single compare-and-swap. Whatever does not fit
+/// into the ring buffer is spilled into the overflow list.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param last Iterator to one past the last element to be inserted.
+
+template <class CTaskClass>
+template <class ForwardIt> 
+void CLockFreeQueue<CTaskClass>::InsertBatch(ForwardIt first, ForwardIt last){
+  size_t n = (size_t)std::distance(first, last); //number left to insert
+  size_t pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+
+  if(m_nNumSpilled.load(std::memory_order_relaxed) > 0){ //keep order
+    Spill(first, n);
+    return;
+  } //if
+
+  while(n > 0){ //until everything is inserted
+    size_t k = 0; //length of run of free cells
+
+    while(k < n && k <= m_nMask && 
+      m_pBuffer[(pos + k) & m_nMask].m_nSequence.load(
+        std::memory_order_acquire) == pos + k)
+      k++;
+
+    if(k == 0){ //first cell is not free
+      const size_t seq = 
+        m_pBuffer[pos & m_nMask].m_nSequence.load(std::memory_order_acquire);
+
+      if((ptrdiff_t)seq - (ptrdiff_t)pos < 0){ //queue is full
+        Spill(first, n);
+        return;
+      } //if
+
+      pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+    } //if
+
+    else if(m_nEnqueuePos.compare_exchange_weak(pos, pos + k,
+      std::memory_order_relaxed))
+    { //claimed k cells starting at pos
+      for(size_t i=0; i<k; i++){
+        CCell* pCell = &m_pBuffer[(pos + i) & m_nMask];
+        pCell->m_tElement = *first++;
+        pCell->m_nSequence.store(pos + i + 1, std::memory_order_release);
+      } //for
+
+      n -= k;
+      pos += k;
+      WakeWaiter(); //in case a consumer is waiting
+    } //else if
+  } //while
+} //InsertBatch
+
+/// Delete and return up to a given number of task descriptors from the
+/// queue. The consumer scans forward from the dequeue position for a run
+/// of full cells and claims the whole run with a single compare-and-swap.
+/// If the ring buffer is empty, then they are taken from the overflow list
+/// instead.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \param n Maximum number of elements to delete.
+/// \return Number of elements deleted, which is 0 if the queue was empty.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CLockFreeQueue<CTaskClass>::DeleteUpTo(OutputIt out, size_t n){
+  size_t pos = m_nDequeuePos.load(std::memory_order_relaxed);
+
+  while(n > 0){ //until we claim some cells or find the queue empty
+    size_t k = 0; //length of run of full cells
+
+    while(k < n && k <= m_nMask && 
+      m_pBuffer[(pos + k) & m_nMask].m_nSequence.load(
+        std::memory_order_acquire) == pos + k + 1)
+      k++;
+
+    if(k == 0){ //first cell is not full
+      const size_t seq = 
+        m_pBuffer[pos & m_nMask].m_nSequence.load(std::memory_order_acquire);
+
+      if((ptrdiff_t)seq - (ptrdiff_t)(pos + 1) < 0) //ring buffer is empty
+        return Unspill(out, n);
+
+      pos = m_nDequeuePos.load(std::memory_order_relaxed); //lost a race
+    } //if
+
+    else if(m_nDequeuePos.compare_exchange_weak(pos, pos + k,
+      std::memory_order_relaxed))
+    { //claimed k cells starting at pos
+      for(size_t i=0; i<k; i++){
+        CCell* pCell = &m_pBuffer[(pos + i) & m_nMask];
+        *out++ = pCell->m_tElement;
+        pCell->m_nSequence.store(pos + i + m_nMask + 1, 
+          std::memory_order_release);
+      } //for
+
+      return k;
+    } //else if
+  } //while
+
+  return 0;
+} //DeleteUpTo
+
+/// Flush all task descriptors out of the queue without processing them.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+void CLockFreeQueue<CTaskClass>::Flush(){
+  CTaskClass element; //discarded element
+
+  while(Delete(element)); //delete until empty
+} //Flush
+
+/// Wake one waiting consumer after a task descriptor has been inserted. The
+/// fence pairs with the one in the waiting functions, so that either the
+/// waiting consumer sees the new task descriptor or we see the consumer.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+void CLockFreeQueue<CTaskClass>::WakeWaiter(){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(m_nNumWaiters.load(std::memory_order_relaxed) > 0){ //somebody waiting
+    m_stdMutex.lock(); //wait until the consumer is really waiting
+    m_stdMutex.unlock();
+    m_cvNotEmpty.notify_one();
+  } //if
+} //WakeWaiter
+
+/// Insert task descriptors into the overflow list when the ring buffer is
+/// full, and wake a waiting consumer.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param n Number of elements to be inserted.
+
+template <class CTaskClass>
+template <class ForwardIt> 
+void CLockFreeQueue<CTaskClass>::Spill(ForwardIt first, size_t n){
+  m_stdSpillMutex.lock();
+
+  for(size_t i=0; i<n; i++)
+    m_qSpill.push_back(*first++);
+
+  m_nNumSpilled.store(m_qSpill.size(), std::memory_order_relaxed);
+  m_stdSpillMutex.unlock();
+
+  WakeWaiter(); //in case a consumer is waiting
+} //Spill
+
+/// Delete up to a given number of task descriptors from the overflow list.
+/// This is cheap when nothing has spilled, since it checks the number in
+/// the overflow list before taking the mutex.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \param n Maximum number of elements to delete.
+/// \return Number of elements deleted.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CLockFreeQueue<CTaskClass>::Unspill(OutputIt out, size_t n){
+  if(m_nNumSpilled.load(std::memory_order_relaxed) == 0)
+    return 0; //fast path
+
+  std::lock_guard<std::mutex> lock(m_stdSpillMutex);
+  size_t k = 0; //number deleted
+
+  for(; k<n && !m_qSpill.empty(); k++){
+    *out++ = m_qSpill.front();
+    m_qSpill.pop_front();
+  } //for
+
+  m_nNumSpilled.store(m_qSpill.size(), std::memory_order_relaxed);
+
+  return k;
+} //Unspill
+
+/// Wait until the queue is not empty, then delete and return a task
+/// descriptor from it. This blocks until some other thread inserts a task
+/// descriptor, so make sure that one will.
+/// \tparam CTaskClass Task descriptor.
+/// \param element [OUT] The element deleted from the queue.
+
+template <class CTaskClass>
+void CLockFreeQueue<CTaskClass>::WaitDelete(CTaskClass& element){
+  if(Delete(element))return; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+  m_nNumWaiters++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  while(!Delete(element)) //guard against spurious wakeups
+    m_cvNotEmpty.wait(lock);
+
+  m_nNumWaiters--;
+} //WaitDelete
+
+/// Wait until the queue is not empty or a deadline passes, whichever comes
+/// first, then delete and return a task descriptor if there is one.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam Clock Clock that the deadline is measured on.
+/// \tparam Duration Duration type of the deadline.
+/// \param element [OUT] The element deleted from the queue.
+/// \param deadline Time point after which to give up.
+/// \return true if the delete was successful, false if the deadline passed.
+
+template <class CTaskClass>
+template <class Clock, class Duration> 
+bool CLockFreeQueue<CTaskClass>::TryDeleteUntil(CTaskClass& element,
+  const std::chrono::time_point<Clock, Duration>& deadline)
+{
+  if(Delete(element))return true; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+  m_nNumWaiters++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  bool success = Delete(element); //true if there was something to delete
+
+  while(!success && 
+    m_cvNotEmpty.wait_until(lock, deadline) == std::cv_status::no_timeout)
+    success = Delete(element);
+
+  if(!success) //one last try after timing out
+    success = Delete(element);
+
+  m_nNumWaiters--;
+
+  return success;
+} //TryDeleteUntil
+
+/// Wait until the queue is not empty or a timeout expires, whichever comes
+/// first, then delete and return a task descriptor if there is one.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param element [OUT] The element deleted from the queue.
+/// \param timeout Maximum amount of time to wait.
+/// \return true if the delete was successful, false if the timeout expired.
+
+template <class CTaskClass>
+template <class Rep, class Period> 
+bool CLockFreeQueue<CTaskClass>::TryDeleteFor(CTaskClass& element,
+  const std::chrono::duration<Rep, Period>& timeout)
+{
+  return TryDeleteUntil(element, std::chrono::steady_clock::now() + timeout);
+} //TryDeleteFor
+
+#endif //__LockFreeQueue_h__
@@ -0,0 +1,544 @@
+/// \file ParallelFor.h
+/// \brief Header and code for the parallel loops ParallelFor() and
+/// ParallelReduce().
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __ParallelFor_h__
+#define __ParallelFor_h__
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+#include "CallableThreadManager.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// eChunking definition.
+
+/// \brief Chunking policy.
+///
+/// How a parallel loop divides its iterations into chunks that are claimed
+/// one at a time by the participating threads.
+
+enum class eChunking{
+  Static, ///< One equal-sized chunk per participant.
+  Dynamic, ///< Fixed-size chunks of the grain size.
+  Guided, ///< Chunks shrink in proportion to the iterations left.
+  Adaptive ///< Chunks sized from the measured cost per iteration.
+}; //eChunking
+
+///////////////////////////////////////////////////////////////////////////////
+// CLoopChunk definition.
+
+/// \brief Loop chunk.
+///
+/// A range of iterations claimed by one participant in a parallel loop,
+/// together with what that participant has learned so far about the cost
+/// of an iteration.
+
+struct CLoopChunk{
+  size_t m_nBegin = 0; ///< First iteration in chunk.
+  size_t m_nEnd = 0; ///< One past the last iteration in chunk.
+  double m_fNsPerIter = 0; ///< Estimated nanoseconds per iteration.
+  std::chrono::steady_clock::time_point m_tStart; ///< When chunk started.
+}; //CLoopChunk
+
+///////////////////////////////////////////////////////////////////////////////
+// CLoopControl definition.
+
+/// \brief Loop control.
+///
+/// The part of a parallel loop's state that does not depend on the loop
+/// body: which iterations have been claimed, how many have been completed,
+/// and the first exception thrown by the loop body. Iterations are numbered
+/// from zero and claimed in chunks with a compare-and-swap on a single
+/// counter, so participants that finish early simply claim more chunks.
+/// Each participant counts the iterations it has completed and reports the
+/// total once, when there are no more to claim.
+
+class CLoopControl{
+  private:
+    std::atomic<size_t> m_nNext; ///< Next unclaimed iteration.
+    std::atomic<size_t> m_nDone; ///< Number of iterations completed.
+    std::mutex m_stdMutex; ///< Mutex for waiting and exceptions.
+    std::condition_variable m_cvDone; ///< Signalled when all completed.
+    std::exception_ptr m_pException; ///< First exception thrown by body.
+
+    size_t ChunkSize(size_t, const CLoopChunk&) const; ///< Choose size.
+
+  protected:
+    const size_t m_nCount; ///< Number of iterations.
+    const size_t m_nParticipants; ///< Number of participating threads.
+    const eChunking m_eChunking; ///< Chunking policy.
+    const size_t m_nGrain; ///< Minimum chunk size.
+
+    static const size_t TARGET_NS = 50000; ///< Adaptive chunk duration.
+
+    bool Claim(CLoopChunk&); ///< Claim a chunk.
+    void Abort(std::exception_ptr); ///< Give up after an exception.
+    void Complete(size_t); ///< Report iterations completed.
+
+  public:
+    CLoopControl(size_t, size_t, eChunking, size_t); ///< Constructor.
+
+    void Wait(); ///< Wait for all iterations to complete.
+}; //CLoopControl
+
+///////////////////////////////////////////////////////////////////////////////
+// CParallelFor definition.
+
+/// \brief Parallel for loop state.
+///
+/// The state of a call to ParallelFor(), shared between the caller and the
+/// tasks that help it.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam Body Loop body, callable with an Index.
+
+template <class Index, class Body>
+class CParallelFor: public CLoopControl{
+  private:
+    const Index m_tFirst; ///< First index.
+    Body m_fBody; ///< Loop body.
+
+  public:
+    CParallelFor(Index, size_t, const Body&, size_t, eChunking, 
+      size_t); ///< Constructor.
+
+    void Run(); ///< Claim and perform chunks until there are none left.
+}; //CParallelFor
+
+///////////////////////////////////////////////////////////////////////////////
+// CParallelReduce definition.
+
+/// \brief Parallel reduction state.
+///
+/// The state of a call to ParallelReduce(), shared between the caller and
+/// the tasks that help it.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam T Result type.
+/// \tparam Body Loop body, callable with an Index and returning a T.
+/// \tparam Combine Combining function, callable with two Ts.
+
+template <class Index, class T, class Body, class Combine>
+class CParallelReduce: public CLoopControl{
+  private:
+    const Index m_tFirst; ///< First index.
+    const T m_tIdentity; ///< Identity for Combine.
+    Body m_fBody; ///< Loop body.
+    Combine m_fCombine; ///< Combining function.
+    T m_tResult; ///< Result so far.
+    std::mutex m_stdMutex; ///< Mutex for m_tResult.
+
+  public:
+    CParallelReduce(Index, size_t, const T&, const Body&, const Combine&, 
+      size_t, eChunking, size_t); ///< Constructor.
+
+    void Run(); ///< Claim and perform chunks until there are none left.
+    const T& GetResult() const; ///< Get the result.
+}; //CParallelReduce
+
+///////////////////////////////////////////////////////////////////////////////
+// CLoopControl code.
+
+/// Constructor.
+/// \param n Number of iterations.
+/// \param p Number of participating threads.
+/// \param e Chunking policy.
+/// \param grain Minimum chunk size, or zero for a default.
+
+inline CLoopControl::CLoopControl(size_t n, size_t p, eChunking e, 
+  size_t grain):
+  m_nNext(0), m_nDone(0), m_nCount(n), m_nParticipants(std::max<size_t>(1, p)),
+  m_eChunking(e), m_nGrain(grain > 0? grain: 
+    e == eChunking::Dynamic? std::max<size_t>(1, n/(8*m_nParticipants)): 1)
+{
+} //constructor
+
+/// Choose the size of the next chunk. Static chunking gives each
+/// participant one equal share and dynamic chunking always uses the grain
+/// size. Guided chunking hands out half of each participant's share of the
+/// iterations left, so chunks start large and get smaller towards the end,
+/// where small chunks are needed to even out the load. Adaptive chunking
+/// aims for chunks that take TARGET_NS nanoseconds, based on the measured
+/// cost per iteration, at most doubling from one chunk to the next and
+/// capped like guided chunking so that the end of the loop is balanced.
+/// \param nLeft Number of iterations not yet claimed.
+/// \param chunk The previous chunk claimed by this participant.
+/// \return Chunk size.
+
+inline size_t CLoopControl::ChunkSize(size_t nLeft, 
+  const CLoopChunk& chunk) const
+{
+  const size_t nGuided = std::max(m_nGrain, nLeft/(2*m_nParticipants));
+
+  switch(m_eChunking){
+    case eChunking::Static: 
+      return (m_nCount + m_nParticipants - 1)/m_nParticipants;
+
+    case eChunking::Dynamic: 
+      return m_nGrain;
+
+    case eChunking::Guided: 
+      return nGuided;
+
+    case eChunking::Adaptive: {
+      const size_t nPrev = chunk.m_nEnd - chunk.m_nBegin; //previous size
+
+      if(nPrev == 0 || chunk.m_fNsPerIter <= 0) //first chunk, probe
+        return m_nGrain;
+
+      const size_t nTarget = (size_t)(TARGET_NS/chunk.m_fNsPerIter);
+      return std::max(m_nGrain, std::min(std::min(nTarget, 2*nPrev), nGuided));
+    } //case
+
+    default: return m_nGrain;
+  } //switch
+} //ChunkSize
+
+/// Claim the next chunk of iterations. For adaptive chunking, the time
+/// taken by the previous chunk is used to update the estimated cost per
+/// iteration.
+/// \param chunk [in, out] The previous chunk, replaced by the next one.
+/// \return true if a chunk was claimed, false if there are none left.
+
+inline bool CLoopControl::Claim(CLoopChunk& chunk){
+  if(m_eChunking == eChunking::Adaptive){
+    const auto tNow = std::chrono::steady_clock::now();
+    const size_t nPrev = chunk.m_nEnd - chunk.m_nBegin; //previous size
+
+    if(nPrev > 0){ //update estimate
+      const double ns = (double)std::chrono::duration_cast<
+        std::chrono::nanoseconds>(tNow - chunk.m_tStart).count()/nPrev;
+      chunk.m_fNsPerIter = chunk.m_fNsPerIter <= 0? ns: 
+        (chunk.m_fNsPerIter + ns)/2;
+    } //if
+
+    chunk.m_tStart = tNow;
+  } //if
+
+  size_t nNext = m_nNext.load(std::memory_order_relaxed);
+
+  while(nNext < m_nCount){
+    const size_t nEnd = std::min(m_nCount, 
+      nNext + std::max<size_t>(1, ChunkSize(m_nCount - nNext, chunk)));
+
+    if(m_nNext.compare_exchange_weak(nNext, nEnd, std::memory_order_relaxed)){
+      chunk.m_nBegin = nNext;
+      chunk.m_nEnd = nEnd;
+      return true;
+    } //if
+  } //while
+
+  return false;
+} //Claim
+
+/// Give up after the loop body throws an exception. The unclaimed
+/// iterations are counted as completed so that the loop ends as soon as the
+/// chunks already claimed have been finished. Only the first exception is
+/// kept.
+/// \param p Pointer to the exception.
+
+inline void CLoopControl::Abort(std::exception_ptr p){
+  m_stdMutex.lock();
+  if(!m_pException)m_pException = p;
+  m_stdMutex.unlock();
+
+  const size_t nNext = m_nNext.exchange(m_nCount);
+
+  if(nNext < m_nCount)
+    Complete(m_nCount - nNext);
+} //Abort
+
+/// Report a number of completed iterations, and wake the caller if that
+/// completes the loop.
+/// \param n Number of iterations completed.
+
+inline void CLoopControl::Complete(size_t n){
+  if(n > 0 && m_nDone.fetch_add(n, std::memory_order_acq_rel) + n == m_nCount){
+    m_stdMutex.lock();
+    m_stdMutex.unlock();
+    m_cvDone.notify_all();
+  } //if
+} //Complete
+
+/// Wait for all iterations to complete, then rethrow the first exception
+/// thrown by the loop body, if any.
+
+inline void CLoopControl::Wait(){
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+
+  while(m_nDone.load(std::memory_order_acquire) < m_nCount)
+    m_cvDone.wait(lock);
+
+  if(m_pException)
+    std::rethrow_exception(m_pException);
+} //Wait
+
+///////////////////////////////////////////////////////////////////////////////
+// CParallelFor code.
+
+/// Constructor.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam Body Loop body, callable with an Index.
+/// \param first First index.
+/// \param n Number of iterations.
+/// \param body Loop body.
+/// \param p Number of participating threads.
+/// \param e Chunking policy.
+/// \param grain Minimum chunk size, or zero for a default.
+
+template <class Index, class Body>
+CParallelFor<Index, Body>::CParallelFor(Index first, size_t n, 
+  const Body& body, size_t p, eChunking e, size_t grain):
+  CLoopControl(n, p, e, grain), m_tFirst(first), m_fBody(body)
+{
+} //constructor
+
+/// Claim chunks of iterations and call the loop body for each of them
+/// until there are none left.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam Body Loop body, callable with an Index.
+
+template <class Index, class Body>
+void CParallelFor<Index, Body>::Run(){
+  CLoopChunk chunk; //current chunk
+  size_t nDone = 0; //number of iterations completed
+
+  while(Claim(chunk)){
+    try{
+      for(size_t i=chunk.m_nBegin; i<chunk.m_nEnd; i++)
+        m_fBody(m_tFirst + i);
+    } //try
+
+    catch(...){
+      Abort(std::current_exception());
+    } //catch
+
+    nDone += chunk.m_nEnd - chunk.m_nBegin;
+  } //while
+
+  Complete(nDone);
+} //Run
+
+///////////////////////////////////////////////////////////////////////////////
+// CParallelReduce code.
+
+/// Constructor.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam T Result type.
+/// \tparam Body Loop body, callable with an Index and returning a T.
+/// \tparam Combine Combining function, callable with two Ts.
+/// \param first First index.
+/// \param n Number of iterations.
+/// \param identity Identity for the combining function.
+/// \param body Loop body.
+/// \param combine Combining function.
+/// \param p Number of participating threads.
+/// \param e Chunking policy.
+/// \param grain Minimum chunk size, or zero for a default.
+
+template <class Index, class T, class Body, class Combine>
+CParallelReduce<Index, T, Body, Combine>::CParallelReduce(Index first, 
+  size_t n, const T& identity, const Body& body, const Combine& combine, 
+  size_t p, eChunking e, size_t grain):
+  CLoopControl(n, p, e, grain), m_tFirst(first), m_tIdentity(identity), 
+  m_fBody(body), m_fCombine(combine), m_tResult(identity)
+{
+} //constructor
+
+/// Claim chunks of iterations and combine the results of the loop body for
+/// each of them into a partial result until there are none left, then
+/// combine the partial result into the result. The partial result is
+/// combined before the completed iterations are reported, so the result is
+/// final once they have all been reported.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam T Result type.
+/// \tparam Body Loop body, callable with an Index and returning a T.
+/// \tparam Combine Combining function, callable with two Ts.
+
+template <class Index, class T, class Body, class Combine>
+void CParallelReduce<Index, T, Body, Combine>::Run(){
+  CLoopChunk chunk; //current chunk
+  size_t nDone = 0; //number of iterations completed
+  T tPartial = m_tIdentity; //partial result
+
+  while(Claim(chunk)){
+    try{
+      for(size_t i=chunk.m_nBegin; i<chunk.m_nEnd; i++)
+        tPartial = m_fCombine(tPartial, m_fBody(m_tFirst + i));
+    } //try
+
+    catch(...){
+      Abort(std::current_exception());
+    } //catch
+
+    nDone += chunk.m_nEnd - chunk.m_nBegin;
+  } //while
+
+  if(nDone > 0){
+    std::lock_guard<std::mutex> lock(m_stdMutex);
+    m_tResult = m_fCombine(m_tResult, tPartial);
+  } //if
+
+  Complete(nDone);
+} //Run
+
+/// Get the result. This is final only after Wait() returns.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam T Result type.
+/// \tparam Body Loop body, callable with an Index and returning a T.
+/// \tparam Combine Combining function, callable with two Ts.
+/// \return The result.
+
+template <class Index, class T, class Body, class Combine>
+const T& CParallelReduce<Index, T, Body, Combine>::GetResult() const{
+  return m_tResult;
+} //GetResult
+
+///////////////////////////////////////////////////////////////////////////////
+// Parallel loop functions.
+
+/// Run a parallel loop. One helper task is submitted for each thread, up to
+/// one fewer than the number of chunks, and the calling thread also takes
+/// part. Since the calling thread claims chunks like everybody else, the
+/// loop finishes even if no threads have been spawned, or if they are busy,
+/// or if the loop is nested inside a task. Helpers that start late find no
+/// chunks left and return at once. The loop state is shared with the
+/// helpers, so it lives until the last of them has finished with it. The
+/// helpers' task descriptors are left in the result queue for the thread
+/// that owns the thread manager to recycle with Process(), since this may
+/// be called from inside a task or from several threads at once.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam CLoop Loop state class.
+/// \param tm Callable thread manager.
+/// \param pLoop Loop state.
+/// \param nChunks Upper bound on the number of chunks.
+
+template <class CQueueClass, class CLoop>
+void RunParallelLoop(CCallableThreadManager<CQueueClass>& tm, 
+  const std::shared_ptr<CLoop>& pLoop, size_t nChunks)
+{
+  const size_t nHelpers = std::min(tm.GetNumThreads(), nChunks - 1);
+
+  for(size_t i=0; i<nHelpers; i++)
+    tm.Submit([pLoop](){pLoop->Run();});
+
+  pLoop->Run(); //take part
+  pLoop->Wait(); //for helpers still working
+} //RunParallelLoop
+
+/// Call a loop body once for each index in a range, in parallel. This is
+/// the parallel version of
+///
+///     for(Index i=first; i<last; i++)body(i);
+///
+/// The iterations are divided into chunks according to a chunking policy.
+/// Static chunking has the least overhead and suits iterations of equal
+/// cost. Dynamic chunking suits iterations of varying cost, provided the
+/// grain size is right. Guided and adaptive chunking suit both, with
+/// adaptive chunking choosing chunk sizes from the measured cost per
+/// iteration so that no grain size need be guessed. If the loop body
+/// throws an exception, then the remaining chunks are abandoned and the
+/// first exception is rethrown. The threads are best spawned in persistent
+/// mode before the first parallel loop. This does not call Process(), so
+/// the owner of the thread manager should call it from time to time to
+/// recycle the helper tasks.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam Body Loop body, callable with an Index.
+/// \param tm Callable thread manager.
+/// \param first First index.
+/// \param last One past the last index.
+/// \param body Loop body.
+/// \param e Chunking policy.
+/// \param grain Minimum chunk size, or zero for a default.
+
+template <class CQueueClass, class Index, class Body>
+void ParallelFor(CCallableThreadManager<CQueueClass>& tm, Index first, 
+  Index last, const Body& body, eChunking e=eChunking::Adaptive, 
+  size_t grain=0)
+{
+  if(!(first < last))return; //nothing to do
+
+  const size_t n = (size_t)(last - first); //number of iterations
+  const size_t p = tm.GetNumThreads() + 1; //number of participants
+
+  std::shared_ptr<CParallelFor<Index, Body>> pLoop = 
+    std::make_shared<CParallelFor<Index, Body>>(first, n, body, p, e, grain);
+
+  RunParallelLoop(tm, pLoop, e == eChunking::Static? p: n);
+} //ParallelFor
+
+/// Combine the results of calling a loop body once for each index in a
+/// range, in parallel. This is the parallel version of
+///
+///     T t = identity;
+///     for(Index i=first; i<last; i++)t = combine(t, body(i));
+///
+/// except that the results are combined in an unspecified order, so the
+/// combining function must be associative and commutative. Each
+/// participating thread combines its own partial result without locking,
+/// and the partial results are combined at the end. Chunking and
+/// exceptions are as for ParallelFor().
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \tparam Index Integer type or random-access iterator.
+/// \tparam T Result type.
+/// \tparam Body Loop body, callable with an Index and returning a T.
+/// \tparam Combine Combining function, callable with two Ts.
+/// \param tm Callable thread manager.
+/// \param first First index.
+/// \param last One past the last index.
+/// \param identity Identity for the combining function.
+/// \param body Loop body.
+/// \param combine Combining function.
+/// \param e Chunking policy.
+/// \param grain Minimum chunk size, or zero for a default.
+/// \return The combined results.
+
+template <class CQueueClass, class Index, class T, class Body, class Combine>
+T ParallelReduce(CCallableThreadManager<CQueueClass>& tm, Index first, 
+  Index last, const T& identity, const Body& body, const Combine& combine, 
+  eChunking e=eChunking::Adaptive, size_t grain=0)
+{
+  if(!(first < last))return identity; //nothing to do
+
+  typedef CParallelReduce<Index, T, Body, Combine> CLoop; //shorthand
+
+  const size_t n = (size_t)(last - first); //number of iterations
+  const size_t p = tm.GetNumThreads() + 1; //number of participants
+
+  std::shared_ptr<CLoop> pLoop = std::make_shared<CLoop>(
+    first, n, identity, body, combine, p, e, grain);
+
+  RunParallelLoop(tm, pLoop, e == eChunking::Static? p: n);
+  return pLoop->GetResult();
+} //ParallelReduce
+
+#endif //__ParallelFor_h__
@@ -0,0 +1,399 @@
+/// \file PriorityQueue.h
+/// \brief Header and code for the class CPriorityQueue.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __PriorityQueue_h__
+#define __PriorityQueue_h__
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+
+#include "BaseTask.h"
+#include "ThreadSafeQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CPriorityQueue definition.
+
+/// \brief Priority queue.
+///
+/// A thread-safe queue of pointers to task descriptors that always gives up
+/// the one with the highest priority, as set by CBaseTask::SetPriority(),
+/// and among those of equal priority the one inserted first. It has the
+/// same interface as CThreadSafeQueue, so it can be used for the request
+/// queue by instantiating CBaseThreadManager with `CPriorityQueue<CTask*>`
+/// as its second template parameter. Latency-critical tasks then overtake
+/// bulk tasks that were inserted before them. The work-stealing deques
+/// ignore priorities, so do not combine this with work-stealing mode.
+///
+/// Rather than a heap under a single lock, this is an array of NUM_LEVELS
+/// FIFO buckets, one per priority level, each with its own lock, so that
+/// inserting or deleting costs the same as for a CThreadSafeQueue plus a
+/// scan of the per-level counts, and threads working on different levels
+/// do not contend. Priorities of NUM_LEVELS or more share the top level.
+/// The buckets are padded to separate cache lines.
+///
+/// Strict priority can starve low-priority tasks while high-priority tasks
+/// keep arriving. Call SetAging() with a positive value n, for example as
+/// `m_qRequest.SetAging(n)` from your thread manager, and every nth delete
+/// serves the lowest-priority nonempty level instead.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+
+template <class CTaskClass, size_t NUM_LEVELS=8>
+class CPriorityQueue{
+  private:
+    /// \brief Priority level.
+    ///
+    /// The bucket for one priority level, with a count of the task
+    /// descriptors in it so that empty levels can be skipped without
+    /// locking them.
+
+    struct CLevel{
+      CThreadSafeQueue<CTaskClass> m_qBucket; ///< Bucket for this level.
+      std::atomic<ptrdiff_t> m_nCount; ///< Number of elements in bucket.
+      char m_pPad[CACHE_LINE_SIZE]; ///< Padding.
+    }; //CLevel
+
+    CLevel m_pLevel[NUM_LEVELS]; ///< Priority levels.
+
+    size_t m_nAging = 0; ///< Serve lowest level every this many deletes.
+    std::atomic<size_t> m_nNumDeletes; ///< Number of deletes so far.
+
+    std::atomic<size_t> m_nNumWaiters; ///< Number of consumers waiting.
+    std::mutex m_stdMutex; ///< Mutex for waiting consumers.
+    std::condition_variable m_cvNotEmpty; ///< Signalled on insertion.
+
+    size_t GetLevel(const CTaskClass&) const; ///< Level for an element.
+    bool IsAgingTurn(); ///< Should this delete serve the lowest level?
+    void WakeWaiters(bool); ///< Wake waiting consumers, if any.
+
+  public:
+    CPriorityQueue(); ///< Constructor.
+
+    void Insert(const CTaskClass& element); ///< Insert task.
+    bool Delete(CTaskClass& element); ///< Delete highest priority task.
+    void Flush(); ///< Flush out and discard all tasks in queue.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt first, ForwardIt last); ///< Insert many tasks.
+
+    template <class OutputIt> 
+    size_t DeleteUpTo(OutputIt out, size_t n); ///< Delete many tasks.
+
+    void WaitDelete(CTaskClass& element); ///< Wait for task then delete it.
+
+    template <class Rep, class Period> 
+    bool TryDeleteFor(CTaskClass& element, 
+      const std::chrono::duration<Rep, Period>& timeout); ///< Wait for a time.
+
+    template <class Clock, class Duration> 
+    bool TryDeleteUntil(CTaskClass& element, 
+      const std::chrono::time_point<Clock, Duration>& deadline); ///< Wait until.
+
+    void SetAging(size_t n); ///< Set aging period.
+}; //CPriorityQueue
+
+///////////////////////////////////////////////////////////////////////////////
+// CPriorityQueue code.
+
+/// Default constructor.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+CPriorityQueue<CTaskClass, NUM_LEVELS>::CPriorityQueue():
+  m_nNumDeletes(0), m_nNumWaiters(0)
+{
+  for(size_t i=0; i<NUM_LEVELS; i++)
+    m_pLevel[i].m_nCount = 0;
+} //constructor
+
+/// Get the priority level that an element belongs in. A null pointer goes
+/// in the lowest level.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param element An element.
+/// \return Its priority level.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+size_t CPriorityQueue<CTaskClass, NUM_LEVELS>::GetLevel(
+  const CTaskClass& element) const
+{
+  if(element == nullptr)return 0;
+  return std::min<size_t>(element->GetPriority(), NUM_LEVELS - 1);
+} //GetLevel
+
+/// Determine whether this delete should serve the lowest-priority nonempty
+/// level instead of the highest.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \return true if it is the turn of the lowest level.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+bool CPriorityQueue<CTaskClass, NUM_LEVELS>::IsAgingTurn(){
+  return m_nAging > 0 && 
+    m_nNumDeletes.fetch_add(1, std::memory_order_relaxed)%m_nAging == 
+      m_nAging - 1;
+} //IsAgingTurn
+
+/// Wake waiting consumers, if there are any. The fence pairs with the one
+/// in TryDeleteUntil() so that either the consumer sees the new element or
+/// this sees the consumer waiting, and the mutex is locked and unlocked
+/// so that the consumer cannot miss the notification between checking the
+/// queue and going to sleep.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param bAll true to wake all waiting consumers, false to wake one.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::WakeWaiters(bool bAll){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(m_nNumWaiters.load(std::memory_order_relaxed) > 0){ //somebody waiting
+    m_stdMutex.lock(); //wait until the consumer is really waiting
+    m_stdMutex.unlock();
+
+    if(bAll)m_cvNotEmpty.notify_all();
+    else m_cvNotEmpty.notify_one();
+  } //if
+} //WakeWaiters
+
+/// Insert a task descriptor at the tail of the bucket for its priority.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param element The element to be inserted into the queue.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::Insert(const CTaskClass& element){
+  CLevel& level = m_pLevel[GetLevel(element)]; //level for this element
+
+  level.m_qBucket.Insert(element);
+  level.m_nCount.fetch_add(1, std::memory_order_release);
+
+  WakeWaiters(false); //in case a consumer is waiting
+} //Insert
+
+/// Delete and return the task descriptor at the head of the highest
+/// nonempty priority level, or the lowest on an aging turn. Levels whose
+/// count is zero are skipped without locking them.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param element [OUT] The element deleted from the queue.
+/// \return true if the delete was successful, ie. the queue was not empty.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+bool CPriorityQueue<CTaskClass, NUM_LEVELS>::Delete(CTaskClass& element){
+  const bool bAging = IsAgingTurn(); //serve lowest level first
+
+  for(size_t i=0; i<NUM_LEVELS; i++){ //for each level in order
+    CLevel& level = m_pLevel[bAging? i: NUM_LEVELS - 1 - i]; //current level
+
+    if(level.m_nCount.load(std::memory_order_acquire) > 0 && 
+      level.m_qBucket.Delete(element))
+    {
+      level.m_nCount.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    } //if
+  } //for
+
+  return false;
+} //Delete
+
+/// Flush all task descriptors out of the queue without processing them.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::Flush(){
+  CTaskClass element; //deleted element
+
+  while(Delete(element)); //delete until empty
+} //Flush
+
+/// Insert a range of task descriptors. Each run of consecutive task
+/// descriptors with the same priority level is inserted into its bucket at
+/// the cost of a single lock, so a batch of equal priority costs no more
+/// than it would in a CThreadSafeQueue.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param last Iterator to one past the last element to be inserted.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+template <class ForwardIt> 
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::InsertBatch(ForwardIt first, 
+  ForwardIt last)
+{
+  if(first == last)return; //nothing to insert
+
+  while(first != last){ //for each run of equal level
+    const size_t n = GetLevel(*first); //level of this run
+    ForwardIt it = first; //end of this run
+    ptrdiff_t nCount = 0; //length of this run
+
+    while(it != last && GetLevel(*it) == n){
+      ++it;
+      ++nCount;
+    } //while
+
+    m_pLevel[n].m_qBucket.InsertBatch(first, it);
+    m_pLevel[n].m_nCount.fetch_add(nCount, std::memory_order_release);
+    first = it;
+  } //while
+
+  WakeWaiters(true); //in case consumers are waiting
+} //InsertBatch
+
+/// Delete and return up to a given number of task descriptors, taking as
+/// many as possible from the highest nonempty priority level, then from
+/// the next highest, and so on (or from the lowest up, on an aging turn).
+/// Each level costs a single lock.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \param n Maximum number of elements to delete.
+/// \return Number of elements deleted, which is 0 if the queue was empty.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+template <class OutputIt> 
+size_t CPriorityQueue<CTaskClass, NUM_LEVELS>::DeleteUpTo(OutputIt out, 
+  size_t n)
+{
+  const bool bAging = IsAgingTurn(); //serve lowest level first
+  size_t count = 0; //number of elements deleted
+
+  for(size_t i=0; i<NUM_LEVELS && count<n; i++){ //for each level in order
+    CLevel& level = m_pLevel[bAging? i: NUM_LEVELS - 1 - i]; //current level
+
+    if(level.m_nCount.load(std::memory_order_acquire) > 0){
+      const size_t k = level.m_qBucket.DeleteUpTo(out, n - count);
+      level.m_nCount.fetch_sub((ptrdiff_t)k, std::memory_order_relaxed);
+
+      for(size_t j=0; j<k; j++) //move past the elements just written
+        ++out;
+
+      count += k;
+    } //if
+  } //for
+
+  return count;
+} //DeleteUpTo
+
+/// Wait until the queue is not empty, then delete and return the task
+/// descriptor with the highest priority. This blocks until some other
+/// thread inserts a task descriptor, so make sure that one will.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param element [OUT] The element deleted from the queue.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::WaitDelete(CTaskClass& element){
+  if(Delete(element))return; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+  m_nNumWaiters++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  while(!Delete(element)) //guard against spurious wakeups
+    m_cvNotEmpty.wait(lock);
+
+  m_nNumWaiters--;
+} //WaitDelete
+
+/// Wait until the queue is not empty or a deadline passes, whichever comes
+/// first, then delete and return the task descriptor with the highest
+/// priority if there is one.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \tparam Clock Clock that the deadline is measured on.
+/// \tparam Duration Duration type of the deadline.
+/// \param element [OUT] The element deleted from the queue.
+/// \param deadline Time point after which to give up.
+/// \return true if the delete was successful, false if the deadline passed.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+template <class Clock, class Duration> 
+bool CPriorityQueue<CTaskClass, NUM_LEVELS>::TryDeleteUntil(
+  CTaskClass& element, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+  if(Delete(element))return true; //fast path
+
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+  m_nNumWaiters++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  bool success = Delete(element); //true if there was something to delete
+
+  while(!success && 
+    m_cvNotEmpty.wait_until(lock, deadline) == std::cv_status::no_timeout)
+    success = Delete(element);
+
+  if(!success) //one last try after timing out
+    success = Delete(element);
+
+  m_nNumWaiters--;
+
+  return success;
+} //TryDeleteUntil
+
+/// Wait until the queue is not empty or a timeout expires, whichever comes
+/// first, then delete and return the task descriptor with the highest
+/// priority if there is one.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param element [OUT] The element deleted from the queue.
+/// \param timeout Maximum amount of time to wait.
+/// \return true if the delete was successful, false if the timeout expired.
+
+template <class CTaskClass, size_t NUM_LEVELS>
+template <class Rep, class Period> 
+bool CPriorityQueue<CTaskClass, NUM_LEVELS>::TryDeleteFor(CTaskClass& element,
+  const std::chrono::duration<Rep, Period>& timeout)
+{
+  return TryDeleteUntil(element, std::chrono::steady_clock::now() + timeout);
+} //TryDeleteFor
+
+/// Set the aging period. If this is positive, then every nth delete serves
+/// the lowest-priority nonempty level instead of the highest, so that low
+/// priority task descriptors get at least a 1/n share of the deletes. This
+/// is not thread-safe, so call it before the threads are spawned.
+/// \tparam CTaskClass Pointer to task descriptor derived from CBaseTask.
+/// \tparam NUM_LEVELS Number of priority levels.
+/// \param n Aging period, or 0 for strict priority (the default).
+
+template <class CTaskClass, size_t NUM_LEVELS>
+void CPriorityQueue<CTaskClass, NUM_LEVELS>::SetAging(size_t n){
+  m_nAging = n;
+} //SetAging
+
+#endif //__PriorityQueue_h__
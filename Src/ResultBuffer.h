@@ -0,0 +1,164 @@
+/// \file ResultBuffer.h
+/// \brief Interface for the per-thread result buffer class CResultBuffer.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef __ResultBuffer_h__
+#define __ResultBuffer_h__
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <iterator>
+#include <cstddef>
+
+#include "BaseTask.h"
+
+/// \brief Result order.
+///
+/// The order in which the thread manager processes completed task
+/// descriptors when each thread has its own result buffer. `Arbitrary`
+/// makes no promises. `PerThread` processes the results from any one
+/// thread in the order in which that thread performed them. `TaskId`
+/// processes the results collected at the same time in increasing order of
+/// task identifier, so that all results are processed in that order if
+/// they are all collected at once, for example by calling Process() after
+/// Wait().
+
+enum class eResultOrder{
+  Arbitrary, PerThread, TaskId
+}; //eResultOrder
+
+///////////////////////////////////////////////////////////////////////////////
+// CResultBuffer definition.
+
+/// \brief Result buffer.
+///
+/// A buffer of completed task descriptors owned by a single thread, which
+/// appends to it, and emptied all at once by the thread manager. It uses an
+/// `std::mutex` for safety, but since each thread has its own buffer the
+/// mutex is contended only when the thread manager empties it, and then
+/// only for as long as it takes to swap two vectors. The number of task
+/// descriptors in the buffer is kept in an atomic variable so that the
+/// thread manager can check for results without locking anything. The
+/// buffer is padded out to a whole number of cache lines so that an array
+/// of them does not suffer from false sharing.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CResultBuffer{ 
+  private:
+    std::mutex m_stdMutex; ///< Mutex for thread safety.
+    std::vector<CTaskClass> m_vBuffer; ///< The task descriptor buffer.
+    std::atomic<size_t> m_nSize; ///< Number of task descriptors in buffer.
+    char m_pPad[CACHE_LINE_SIZE]; ///< Padding.
+
+  public:
+    CResultBuffer(); ///< Constructor.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt first, ForwardIt last); ///< Insert many tasks.
+
+    template <class OutputIt> 
+    size_t DeleteAll(OutputIt out); ///< Delete all tasks.
+
+    void Flush(); ///< Flush out and discard all tasks in buffer.
+    const bool IsEmpty() const; ///< Is the buffer empty?
+}; //CResultBuffer
+
+///////////////////////////////////////////////////////////////////////////////
+// CResultBuffer code.
+
+/// Constructor.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+CResultBuffer<CTaskClass>::CResultBuffer(): m_nSize(0){
+} //constructor
+
+/// Append a range of task descriptors to the buffer at the cost of a single
+/// lock of the mutex. This is to be called by the thread that owns the
+/// buffer.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param last Iterator to one past the last element to be inserted.
+
+template <class CTaskClass>
+template <class ForwardIt> 
+void CResultBuffer<CTaskClass>::InsertBatch(ForwardIt first, ForwardIt last){
+  m_stdMutex.lock(); 
+  m_vBuffer.insert(m_vBuffer.end(), first, last); 
+  m_nSize.store(m_vBuffer.size(), std::memory_order_relaxed);
+  m_stdMutex.unlock();
+} //InsertBatch
+
+/// Delete and return all of the task descriptors in the buffer in the order
+/// in which they were inserted. The buffer is swapped with an empty one
+/// while the mutex is locked, so the owner is not held up while they are
+/// copied out.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \return Number of elements deleted, which is 0 if the buffer was empty.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CResultBuffer<CTaskClass>::DeleteAll(OutputIt out){
+  if(IsEmpty())return 0; //nothing to do, so don't touch the mutex
+
+  std::vector<CTaskClass> v; //for swapping with the buffer
+
+  m_stdMutex.lock(); 
+  m_vBuffer.swap(v);
+  m_nSize.store(0, std::memory_order_relaxed);
+  m_stdMutex.unlock();
+
+  for(const CTaskClass& element: v)
+    *out++ = element;
+
+  return v.size();
+} //DeleteAll
+
+/// Flush all task descriptors out of the buffer without processing them.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+void CResultBuffer<CTaskClass>::Flush(){
+  m_stdMutex.lock();
+  m_vBuffer.clear();
+  m_nSize.store(0, std::memory_order_relaxed);
+  m_stdMutex.unlock();
+} //Flush
+
+/// Reader function for whether the buffer is empty. This does not lock the
+/// mutex, so the answer may be out of date by the time it is used.
+/// \tparam CTaskClass Task descriptor.
+/// \return true if the buffer is empty.
+
+template <class CTaskClass>
+const bool CResultBuffer<CTaskClass>::IsEmpty() const{
+  return m_nSize.load(std::memory_order_relaxed) == 0;
+} //IsEmpty
+
+#endif //__ResultBuffer_h__
@@ -0,0 +1,399 @@
+/// \file Stats.cpp
+/// \brief Code for the runtime statistics classes CHistogram,
+/// CAtomicHistogram, CWorkerStats, and CStats.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "Stats.h"
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+  #include <intrin.h>
+#endif
+
+/// Get the position of the most significant bit of a nonzero value.
+/// \param n A nonzero value.
+/// \return Log base 2 of n, rounded down.
+
+static size_t Log2(uint64_t n){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  unsigned long i = 0; //bit index
+  _BitScanReverse64(&i, n);
+  return (size_t)i;
+#else //g++, *nix
+  return 63 - (size_t)__builtin_clzll(n);
+#endif
+} //Log2
+
+///////////////////////////////////////////////////////////////////////////////
+// CHistogram code.
+
+/// Constructor.
+
+CHistogram::CHistogram(){
+  std::fill(m_nBucket, m_nBucket + NUM_BUCKETS, 0);
+} //constructor
+
+/// Get the bucket that a value falls into. Values less than `SUB_BUCKETS`
+/// have a bucket each. Larger values are in the bucket for their most
+/// significant bit and the `SUB_BITS` bits after it.
+/// \param n A value.
+/// \return Index of the bucket that n falls into.
+
+size_t CHistogram::GetBucket(uint64_t n){
+  if(n < SUB_BUCKETS)
+    return (size_t)n;
+
+  const size_t e = Log2(n); //position of most significant bit
+  const size_t m = (size_t)(n >> (e - SUB_BITS)); //top bits
+
+  return (e - SUB_BITS + 1)*SUB_BUCKETS + m - SUB_BUCKETS;
+} //GetBucket
+
+/// Get the smallest value that falls into a bucket. This is the inverse of
+/// GetBucket().
+/// \param i Index of a bucket.
+/// \return The smallest value in bucket i.
+
+uint64_t CHistogram::GetLowerBound(size_t i){
+  if(i < SUB_BUCKETS)
+    return i;
+
+  const size_t e = i/SUB_BUCKETS + SUB_BITS - 1; //most significant bit
+  const uint64_t m = i%SUB_BUCKETS + SUB_BUCKETS; //top bits
+
+  return m << (e - SUB_BITS);
+} //GetLowerBound
+
+/// Insert a value.
+/// \param n A value.
+
+void CHistogram::Insert(uint64_t n){
+  m_nBucket[GetBucket(n)]++;
+  m_nCount++;
+  m_nSum += n;
+  m_nMax = std::max(m_nMax, n);
+} //Insert
+
+/// Add in the values from another histogram.
+/// \param h A histogram.
+
+void CHistogram::Merge(const CHistogram& h){
+  for(size_t i=0; i<NUM_BUCKETS; i++)
+    m_nBucket[i] += h.m_nBucket[i];
+
+  m_nCount += h.m_nCount;
+  m_nSum += h.m_nSum;
+  m_nMax = std::max(m_nMax, h.m_nMax);
+} //Merge
+
+/// Reader function for the number of values.
+/// \return Number of values.
+
+const uint64_t CHistogram::GetCount() const{
+  return m_nCount;
+} //GetCount
+
+/// Reader function for the sum of the values.
+/// \return Sum of values.
+
+const uint64_t CHistogram::GetSum() const{
+  return m_nSum;
+} //GetSum
+
+/// Reader function for the largest value.
+/// \return Largest value, or 0 if there are none.
+
+const uint64_t CHistogram::GetMax() const{
+  return m_nMax;
+} //GetMax
+
+/// Get the mean value.
+/// \return Mean value, or 0 if there are none.
+
+const double CHistogram::GetMean() const{
+  return m_nCount == 0? 0.0: (double)m_nSum/m_nCount;
+} //GetMean
+
+/// Get a percentile, for example 50 for the median or 99 for the 99th
+/// percentile. The answer is the largest value in the bucket that the
+/// percentile falls into, so it is an overestimate by less than 1 in
+/// `SUB_BUCKETS`, but it is never more than the largest value.
+/// \param p Percentile, from 0 to 100.
+/// \return An upper bound on the p-th percentile, or 0 if there are no values.
+
+const uint64_t CHistogram::GetPercentile(double p) const{
+  if(m_nCount == 0)return 0;
+
+  const double q = std::min(100.0, std::max(0.0, p))/100.0; //fraction
+  const uint64_t nRank = std::max<uint64_t>(1, (uint64_t)(q*m_nCount + 0.5));
+
+  uint64_t nSoFar = 0; //number of values in buckets so far
+
+  for(size_t i=0; i<NUM_BUCKETS; i++){
+    nSoFar += m_nBucket[i];
+
+    if(nSoFar >= nRank){ //found the bucket
+      if(i + 1 == NUM_BUCKETS)return m_nMax; //last bucket
+      return std::min(m_nMax, GetLowerBound(i + 1) - 1);
+    } //if
+  } //for
+
+  return m_nMax;
+} //GetPercentile
+
+/// Reader function for the number of values in a bucket.
+/// \param i Index of a bucket.
+/// \return Number of values in bucket i.
+
+const uint64_t CHistogram::GetBucketCount(size_t i) const{
+  return i < NUM_BUCKETS? m_nBucket[i]: 0;
+} //GetBucketCount
+
+///////////////////////////////////////////////////////////////////////////////
+// CAtomicHistogram code.
+
+/// Add to a counter that is written only by the calling thread. A relaxed
+/// load and store is enough, and is much cheaper than an atomic add.
+/// \param a A counter.
+/// \param n Amount to add.
+
+static inline void Bump(std::atomic<uint64_t>& a, uint64_t n){
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+} //Bump
+
+/// Constructor.
+
+CAtomicHistogram::CAtomicHistogram(): m_nCount(0), m_nSum(0), m_nMax(0){
+  Clear();
+} //constructor
+
+/// Insert a value. This must only be called by the thread that owns this
+/// histogram.
+/// \param n A value.
+
+void CAtomicHistogram::Insert(uint64_t n){
+  Bump(m_nBucket[CHistogram::GetBucket(n)], 1);
+  Bump(m_nCount, 1);
+  Bump(m_nSum, n);
+
+  if(n > m_nMax.load(std::memory_order_relaxed))
+    m_nMax.store(n, std::memory_order_relaxed);
+} //Insert
+
+/// Copy the values into a histogram. This can be called by any thread at
+/// any time, but if the owner is inserting values at the same time, then
+/// the count and sum may not quite agree with the buckets.
+/// \param h [OUT] A histogram.
+
+void CAtomicHistogram::Read(CHistogram& h) const{
+  for(size_t i=0; i<CHistogram::NUM_BUCKETS; i++)
+    h.m_nBucket[i] = m_nBucket[i].load(std::memory_order_relaxed);
+
+  h.m_nCount = m_nCount.load(std::memory_order_relaxed);
+  h.m_nSum = m_nSum.load(std::memory_order_relaxed);
+  h.m_nMax = m_nMax.load(std::memory_order_relaxed);
+} //Read
+
+/// Remove all values. This must not be called while the owner is inserting
+/// values.
+
+void CAtomicHistogram::Clear(){
+  for(size_t i=0; i<CHistogram::NUM_BUCKETS; i++)
+    m_nBucket[i].store(0, std::memory_order_relaxed);
+
+  m_nCount.store(0, std::memory_order_relaxed);
+  m_nSum.store(0, std::memory_order_relaxed);
+  m_nMax.store(0, std::memory_order_relaxed);
+} //Clear
+
+///////////////////////////////////////////////////////////////////////////////
+// CWorkerSnapshot code.
+
+/// Add in the statistics from another snapshot.
+/// \param s A snapshot.
+
+void CWorkerSnapshot::Merge(const CWorkerSnapshot& s){
+  m_nTasks += s.m_nTasks;
+  m_nSteals += s.m_nSteals;
+  m_nBusyNs += s.m_nBusyNs;
+  m_nIdleNs += s.m_nIdleNs;
+  m_nCpuNs += s.m_nCpuNs;
+  m_cWait.Merge(s.m_cWait);
+  m_cExec.Merge(s.m_cExec);
+} //Merge
+
+/// Get the fraction of time spent performing tasks, out of the time spent
+/// either performing tasks or parked.
+/// \return Utilization from 0 to 1, or 0 if no time has been recorded.
+
+const double CWorkerSnapshot::GetUtilization() const{
+  const uint64_t t = m_nBusyNs + m_nIdleNs; //total time
+  return t == 0? 0.0: (double)m_nBusyNs/t;
+} //GetUtilization
+
+/// Get the CPU time used divided by the time spent performing tasks. This
+/// is close to 1 if the tasks kept the thread's CPU busy, and less if they
+/// spent time blocked, for example on I/O or locks, or if the thread was
+/// preempted.
+/// \return CPU efficiency, or 0 if no busy time has been recorded.
+
+const double CWorkerSnapshot::GetCpuEfficiency() const{
+  return m_nBusyNs == 0? 0.0: (double)m_nCpuNs/m_nBusyNs;
+} //GetCpuEfficiency
+
+///////////////////////////////////////////////////////////////////////////////
+// CWorkerStats code.
+
+/// Constructor.
+
+CWorkerStats::CWorkerStats(): 
+  m_nTasks(0), m_nSteals(0), m_nBusyNs(0), m_nIdleNs(0), m_nCpuNs(0){
+} //constructor
+
+/// Count a task that has been performed.
+/// \param nWait Time from when the task was ready to when it was started.
+/// \param nExec Time taken to perform the task.
+
+void CWorkerStats::AddTask(uint64_t nWait, uint64_t nExec){
+  Bump(m_nTasks, 1);
+  m_cWait.Insert(nWait);
+  m_cExec.Insert(nExec);
+} //AddTask
+
+/// Count a task that has been stolen from another thread.
+
+void CWorkerStats::AddSteal(){
+  Bump(m_nSteals, 1);
+} //AddSteal
+
+/// Add to the time spent performing tasks.
+/// \param n Time in nanoseconds.
+
+void CWorkerStats::AddBusy(uint64_t n){
+  Bump(m_nBusyNs, n);
+} //AddBusy
+
+/// Add to the time spent parked.
+/// \param n Time in nanoseconds.
+
+void CWorkerStats::AddIdle(uint64_t n){
+  Bump(m_nIdleNs, n);
+} //AddIdle
+
+/// Add to the CPU time used.
+/// \param n Time in nanoseconds.
+
+void CWorkerStats::AddCpu(uint64_t n){
+  Bump(m_nCpuNs, n);
+} //AddCpu
+
+/// Take a snapshot.
+/// \param s [OUT] Snapshot.
+
+void CWorkerStats::Read(CWorkerSnapshot& s) const{
+  s.m_nTasks = m_nTasks.load(std::memory_order_relaxed);
+  s.m_nSteals = m_nSteals.load(std::memory_order_relaxed);
+  s.m_nBusyNs = m_nBusyNs.load(std::memory_order_relaxed);
+  s.m_nIdleNs = m_nIdleNs.load(std::memory_order_relaxed);
+  s.m_nCpuNs = m_nCpuNs.load(std::memory_order_relaxed);
+  m_cWait.Read(s.m_cWait);
+  m_cExec.Read(s.m_cExec);
+} //Read
+
+///////////////////////////////////////////////////////////////////////////////
+// CThrottleStats code.
+
+/// Constructor.
+
+CThrottleStats::CThrottleStats(): 
+  m_nBlocked(0), m_nBlockedNs(0), m_nRejected(0), m_nInline(0), 
+  m_nInlineNs(0){
+} //constructor
+
+/// Count an insertion that blocked because the request queue was full.
+/// \param n Time spent blocked in nanoseconds.
+
+void CThrottleStats::AddBlocked(uint64_t n){
+  m_nBlocked.fetch_add(1, std::memory_order_relaxed);
+  m_nBlockedNs.fetch_add(n, std::memory_order_relaxed);
+} //AddBlocked
+
+/// Count an insertion that was refused because the request queue was full.
+
+void CThrottleStats::AddRejected(){
+  m_nRejected.fetch_add(1, std::memory_order_relaxed);
+} //AddRejected
+
+/// Count a task that was performed by the producer because the request
+/// queue was full.
+/// \param n Time spent performing it in nanoseconds.
+
+void CThrottleStats::AddInline(uint64_t n){
+  m_nInline.fetch_add(1, std::memory_order_relaxed);
+  m_nInlineNs.fetch_add(n, std::memory_order_relaxed);
+} //AddInline
+
+/// Take a snapshot.
+/// \param s [OUT] Snapshot.
+
+void CThrottleStats::Read(CThrottleSnapshot& s) const{
+  s.m_nBlocked = m_nBlocked.load(std::memory_order_relaxed);
+  s.m_nBlockedNs = m_nBlockedNs.load(std::memory_order_relaxed);
+  s.m_nRejected = m_nRejected.load(std::memory_order_relaxed);
+  s.m_nInline = m_nInline.load(std::memory_order_relaxed);
+  s.m_nInlineNs = m_nInlineNs.load(std::memory_order_relaxed);
+} //Read
+
+///////////////////////////////////////////////////////////////////////////////
+// CStats code.
+
+/// Add up the snapshots for all of the threads.
+/// \return Snapshot for all threads together.
+
+CWorkerSnapshot CStats::GetTotal() const{
+  CWorkerSnapshot s; //result
+
+  for(const CWorkerSnapshot& w: m_vWorker)
+    s.Merge(w);
+
+  return s;
+} //GetTotal
+
+/// Get the load imbalance, which is the busy time of the busiest thread
+/// divided by the average busy time. This is 1 if the load is perfectly
+/// balanced, and large if there is a straggler.
+/// \return Imbalance, or 0 if no time has been recorded.
+
+const double CStats::GetImbalance() const{
+  uint64_t nMax = 0; //largest busy time
+  uint64_t nSum = 0; //total busy time
+
+  for(const CWorkerSnapshot& w: m_vWorker){
+    nMax = std::max(nMax, w.m_nBusyNs);
+    nSum += w.m_nBusyNs;
+  } //for
+
+  return nSum == 0? 0.0: (double)nMax*m_vWorker.size()/nSum;
+} //GetImbalance
@@ -0,0 +1,224 @@
+/// \file Stats.h
+/// \brief Interface for the runtime statistics classes CHistogram,
+/// CAtomicHistogram, CWorkerStats, and CStats.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef __Stats_h__
+#define __Stats_h__
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "BaseTask.h"
+#include "Timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CHistogram definition.
+
+/// \brief Log-linear histogram.
+///
+/// A histogram of durations in nanoseconds, or of any other non-negative
+/// integer values. Each power of 2 is split into `SUB_BUCKETS` equal
+/// buckets, so the buckets are fine for small values and coarse for large
+/// ones, and every value is recorded with a relative error of less than 1 in
+/// `SUB_BUCKETS` no matter how large it is. This is a plain copyable value
+/// that is used for snapshots. The threads record their values in a
+/// CAtomicHistogram instead.
+
+class CHistogram{
+  public:
+    static const size_t SUB_BITS = 3; ///< Log base 2 of sub-buckets.
+    static const size_t SUB_BUCKETS = 1 << SUB_BITS; ///< Per power of 2.
+    static const size_t NUM_BUCKETS = SUB_BUCKETS*(65 - SUB_BITS); ///< Buckets.
+
+  protected:
+    uint64_t m_nBucket[NUM_BUCKETS]; ///< Number of values in each bucket.
+    uint64_t m_nCount = 0; ///< Number of values.
+    uint64_t m_nSum = 0; ///< Sum of values.
+    uint64_t m_nMax = 0; ///< Largest value.
+
+    friend class CAtomicHistogram;
+
+  public:
+    CHistogram(); ///< Constructor.
+
+    static size_t GetBucket(uint64_t); ///< Get bucket for a value.
+    static uint64_t GetLowerBound(size_t); ///< Get smallest value in a bucket.
+
+    void Insert(uint64_t); ///< Insert a value.
+    void Merge(const CHistogram&); ///< Add in another histogram.
+
+    const uint64_t GetCount() const; ///< Get number of values.
+    const uint64_t GetSum() const; ///< Get sum of values.
+    const uint64_t GetMax() const; ///< Get largest value.
+    const double GetMean() const; ///< Get mean value.
+    const uint64_t GetPercentile(double) const; ///< Get a percentile.
+    const uint64_t GetBucketCount(size_t) const; ///< Get count for a bucket.
+}; //CHistogram
+
+///////////////////////////////////////////////////////////////////////////////
+// CAtomicHistogram definition.
+
+/// \brief Single-writer histogram.
+///
+/// A log-linear histogram with the same buckets as CHistogram that is
+/// written by one thread and may be read by others at any time. Since there
+/// is only one writer, each count is updated with a relaxed load and store
+/// rather than an atomic read-modify-write, which costs no more than an
+/// ordinary increment, but a reader never sees a torn value.
+
+class CAtomicHistogram{
+  private:
+    std::atomic<uint64_t> m_nBucket[CHistogram::NUM_BUCKETS]; ///< Counts.
+    std::atomic<uint64_t> m_nCount; ///< Number of values.
+    std::atomic<uint64_t> m_nSum; ///< Sum of values.
+    std::atomic<uint64_t> m_nMax; ///< Largest value.
+
+  public:
+    CAtomicHistogram(); ///< Constructor.
+
+    void Insert(uint64_t); ///< Insert a value.
+    void Read(CHistogram&) const; ///< Copy into a histogram.
+    void Clear(); ///< Remove all values.
+}; //CAtomicHistogram
+
+///////////////////////////////////////////////////////////////////////////////
+// CWorkerStats definition.
+
+/// \brief Snapshot of one thread's statistics.
+///
+/// The number of tasks that a thread has performed and stolen, the time
+/// that it has spent performing tasks and parked, the CPU time that it
+/// has used, and histograms of how long
+/// its tasks waited to be performed and how long they took to perform, all
+/// in nanoseconds.
+
+struct CWorkerSnapshot{
+  size_t m_nThreadId = 0; ///< Thread identifier.
+  uint64_t m_nTasks = 0; ///< Number of tasks performed.
+  uint64_t m_nSteals = 0; ///< Number of tasks stolen.
+  uint64_t m_nBusyNs = 0; ///< Time spent performing tasks.
+  uint64_t m_nIdleNs = 0; ///< Time spent parked.
+  uint64_t m_nCpuNs = 0; ///< CPU time used.
+  CHistogram m_cWait; ///< Time from ready to being performed.
+  CHistogram m_cExec; ///< Time taken by Perform().
+
+  void Merge(const CWorkerSnapshot&); ///< Add in another snapshot.
+  const double GetUtilization() const; ///< Fraction of time busy.
+  const double GetCpuEfficiency() const; ///< CPU time over busy time.
+}; //CWorkerSnapshot
+
+/// \brief One thread's statistics.
+///
+/// The counters and histograms updated by a single thread while it runs,
+/// which the thread manager can read at any time with Read(). Like the
+/// work-stealing deques, an array of these is allocated with one per thread,
+/// so they are padded out to a whole number of cache lines.
+
+class CWorkerStats{
+  private:
+    std::atomic<uint64_t> m_nTasks; ///< Number of tasks performed.
+    std::atomic<uint64_t> m_nSteals; ///< Number of tasks stolen.
+    std::atomic<uint64_t> m_nBusyNs; ///< Time spent performing tasks.
+    std::atomic<uint64_t> m_nIdleNs; ///< Time spent parked.
+    std::atomic<uint64_t> m_nCpuNs; ///< CPU time used.
+    CAtomicHistogram m_cWait; ///< Time from ready to being performed.
+    CAtomicHistogram m_cExec; ///< Time taken by Perform().
+    char m_pPad[CACHE_LINE_SIZE]; ///< Padding.
+
+  public:
+    CWorkerStats(); ///< Constructor.
+
+    void AddTask(uint64_t, uint64_t); ///< Count a task.
+    void AddSteal(); ///< Count a stolen task.
+    void AddBusy(uint64_t); ///< Add busy time.
+    void AddIdle(uint64_t); ///< Add idle time.
+    void AddCpu(uint64_t); ///< Add CPU time.
+
+    void Read(CWorkerSnapshot&) const; ///< Take a snapshot.
+}; //CWorkerStats
+
+///////////////////////////////////////////////////////////////////////////////
+// CThrottleStats definition.
+
+/// \brief Snapshot of backpressure statistics.
+///
+/// How often producers found the request queue full and what happened
+/// then, and how long they spent throttled, in nanoseconds, either blocked
+/// waiting for room or performing tasks themselves.
+
+struct CThrottleSnapshot{
+  uint64_t m_nBlocked = 0; ///< Number of insertions that blocked.
+  uint64_t m_nBlockedNs = 0; ///< Time spent blocked.
+  uint64_t m_nRejected = 0; ///< Number of insertions that were refused.
+  uint64_t m_nInline = 0; ///< Number of tasks performed by the producer.
+  uint64_t m_nInlineNs = 0; ///< Time spent performing them.
+}; //CThrottleSnapshot
+
+/// \brief Backpressure statistics.
+///
+/// The counters updated by producers when the request queue is full. There
+/// may be many producers, so unlike CWorkerStats these are updated with
+/// atomic additions, but only when a producer is throttled anyway.
+
+class CThrottleStats{
+  private:
+    std::atomic<uint64_t> m_nBlocked; ///< Number of insertions that blocked.
+    std::atomic<uint64_t> m_nBlockedNs; ///< Time spent blocked.
+    std::atomic<uint64_t> m_nRejected; ///< Number of insertions refused.
+    std::atomic<uint64_t> m_nInline; ///< Number of tasks performed inline.
+    std::atomic<uint64_t> m_nInlineNs; ///< Time spent performing them.
+
+  public:
+    CThrottleStats(); ///< Constructor.
+
+    void AddBlocked(uint64_t); ///< Count a blocked insertion.
+    void AddRejected(); ///< Count a refused insertion.
+    void AddInline(uint64_t); ///< Count a task performed inline.
+    void Read(CThrottleSnapshot&) const; ///< Take a snapshot.
+}; //CThrottleStats
+
+///////////////////////////////////////////////////////////////////////////////
+// CStats definition.
+
+/// \brief Snapshot of a thread manager's statistics.
+///
+/// A snapshot for each thread together with a histogram of end-to-end
+/// times, from when each task became ready to be performed until its result
+/// was processed, and the backpressure statistics. The counters only ever
+/// increase, so the difference between two snapshots gives the statistics
+/// for the time between them.
+
+struct CStats{
+  std::vector<CWorkerSnapshot> m_vWorker; ///< Snapshot for each thread.
+  CHistogram m_cEndToEnd; ///< Time from ready to being processed.
+  CThrottleSnapshot m_cThrottle; ///< Backpressure statistics.
+
+  CWorkerSnapshot GetTotal() const; ///< Sum over threads.
+  const double GetImbalance() const; ///< Busiest thread over average.
+}; //CStats
+
+#endif //__Stats_h__
@@ -0,0 +1,317 @@
+/// \file TaskPool.h
+/// \brief Interface for the task descriptor pool classes CTaskPool and
+/// CPooledTask.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __TaskPool_h__
+#define __TaskPool_h__
+
+#include <new>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "BaseTask.h"
+#include "Affinity.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CTaskPool definition.
+
+/// \brief Task descriptor pool.
+///
+/// A slab allocator for task descriptors of a single class. Memory is
+/// carved out of large slabs into slots that are a whole number of cache
+/// lines long and aligned on a cache line boundary, so that task
+/// descriptors performed by different threads never share a cache line.
+/// Freed slots are recycled rather than returned to the heap.
+///
+/// Each thread keeps its own free list of slots, so that allocation and
+/// deallocation in the hot path need no synchronization at all. Only when a
+/// thread's free list runs dry or grows too long is a batch of slots moved
+/// to or from a global free list under a mutex. Since task descriptors are
+/// usually created and deleted by the thread manager's thread, most of
+/// the traffic stays on that thread's free list.
+///
+/// There is one global free list for each NUMA node. A thread uses the one
+/// for the node that it was placed on by CBaseThreadManager::SetAffinity(),
+/// and slabs are bound to that node with AllocateOnNode(), so task
+/// descriptors that are created by a thread are in memory local to it.
+/// Threads that have not been placed share the global free list for node 0,
+/// and their slabs are not bound to any node.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CTaskPool{
+  public:
+    static const size_t SLOT_SIZE = (sizeof(CTaskClass) + CACHE_LINE_SIZE - 1)/
+      CACHE_LINE_SIZE*CACHE_LINE_SIZE; ///< Slot size in bytes.
+
+  private:
+    static const size_t SLAB_SLOTS = 256; ///< Number of slots per slab.
+    static const size_t BATCH_SLOTS = 64; ///< Slots moved to or from global.
+    static const size_t SLAB_SIZE = SLAB_SLOTS*SLOT_SIZE; ///< Slab in bytes.
+
+    /// \brief Free slot.
+    ///
+    /// A free slot holds a pointer to the next free slot in its free list.
+
+    struct CFreeSlot{
+      CFreeSlot* m_pNext; ///< Next free slot.
+    }; //CFreeSlot
+
+    /// \brief Global free list.
+    ///
+    /// The global free list and the slabs that all slots are carved from,
+    /// which are shared by all threads.
+
+    struct CGlobal{
+      std::mutex m_stdMutex; ///< Mutex for thread safety.
+      CFreeSlot* m_pHead = nullptr; ///< Global free list.
+      std::vector<void*> m_vSlab; ///< Slabs, from AllocateOnNode().
+
+      ~CGlobal(); ///< Destructor.
+    }; //CGlobal
+
+    /// \brief Thread-local free list.
+    ///
+    /// The free list of a single thread, which is handed back to the global
+    /// free list when the thread exits.
+
+    struct CLocal{
+      CFreeSlot* m_pHead = nullptr; ///< Thread-local free list.
+      size_t m_nCount = 0; ///< Number of slots in thread-local free list.
+      size_t m_nNode = GetCurrentNode(); ///< NUMA node of thread.
+
+      ~CLocal(); ///< Destructor.
+    }; //CLocal
+
+    static CGlobal& Global(size_t); ///< Get a node's global free list.
+    static CLocal& Local(); ///< Get this thread's free list.
+
+    static void Refill(CLocal&); ///< Move slots from global to local.
+    static void Spill(CLocal&, size_t); ///< Move slots from local to global.
+
+  public:
+    static void* Allocate(); ///< Allocate a slot.
+    static void Free(void*); ///< Free a slot.
+}; //CTaskPool
+
+///////////////////////////////////////////////////////////////////////////////
+// CPooledTask definition.
+
+/// \brief Pooled task descriptor.
+///
+/// Derive your task descriptor from this class as well as from CBaseTask to
+/// have it allocated from a CTaskPool instead of the heap. Overloading the
+/// class's `operator new` and `operator delete` means that nothing else
+/// changes: you still call CBaseThreadManager::Insert() with a task
+/// descriptor created with `new`, and CBaseThreadManager::Process() still
+/// deletes it with `delete`. For example,
+///
+///     class CTask: public CBaseTask, public CPooledTask<CTask>{ ... };
+///
+/// Objects of classes derived from your task descriptor that are too big
+/// for a slot are quietly allocated from the heap as usual. They are
+/// returned to the heap when deleted, even through a pointer to your task
+/// descriptor, because the virtual destructor of CBaseTask makes `delete`
+/// pass the size of the object that was actually allocated.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CPooledTask{
+  public:
+    static void* operator new(size_t); ///< Allocate from pool.
+    static void operator delete(void*, size_t); ///< Return to pool.
+}; //CPooledTask
+
+///////////////////////////////////////////////////////////////////////////////
+// CTaskPool code.
+
+/// The destructor releases all of the slabs. It is called at program exit.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+CTaskPool<CTaskClass>::CGlobal::~CGlobal(){
+  for(void* p: m_vSlab)
+    FreeOnNode(p, SLAB_SIZE);
+} //destructor
+
+/// When a thread exits, the destructor hands its free list back to the
+/// global free list so that the slots can be reused by other threads.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+CTaskPool<CTaskClass>::CLocal::~CLocal(){
+  Spill(*this, m_nCount);
+} //destructor
+
+/// Get the global free list for a NUMA node. The global free lists are
+/// created on first use. Threads on an unknown node use the one for node 0,
+/// and nodes beyond MAX_NUMA_NODES share the last one.
+/// \tparam CTaskClass Task descriptor.
+/// \param node NUMA node, or max_size_t if unknown.
+/// \return Reference to the global free list.
+
+template <class CTaskClass>
+typename CTaskPool<CTaskClass>::CGlobal& CTaskPool<CTaskClass>::Global(
+  size_t node)
+{
+  static CGlobal global[MAX_NUMA_NODES]; //one per node
+  return global[node == max_size_t? 0: std::min(node, MAX_NUMA_NODES - 1)];
+} //Global
+
+/// Get the calling thread's free list, which is created on first use.
+/// \tparam CTaskClass Task descriptor.
+/// \return Reference to this thread's free list.
+
+template <class CTaskClass>
+typename CTaskPool<CTaskClass>::CLocal& CTaskPool<CTaskClass>::Local(){
+  static thread_local CLocal local; //one per thread
+  return local;
+} //Local
+
+/// Move a batch of slots from the global free list to a thread-local free
+/// list, carving a new slab into slots if the global free list is empty.
+/// Slabs are page-aligned, so the slots are cache-line aligned.
+/// \tparam CTaskClass Task descriptor.
+/// \param local Thread-local free list.
+
+template <class CTaskClass>
+void CTaskPool<CTaskClass>::Refill(CLocal& local){
+  CGlobal& global = Global(local.m_nNode);
+  std::lock_guard<std::mutex> lock(global.m_stdMutex);
+
+  if(global.m_pHead == nullptr){ //carve a new slab into slots
+    void* pSlab = AllocateOnNode(SLAB_SIZE, local.m_nNode);
+    global.m_vSlab.push_back(pSlab);
+
+    const uintptr_t p = (uintptr_t)pSlab; //start of first slot
+
+    for(size_t i=0; i<SLAB_SLOTS; i++){ //push each slot onto free list
+      CFreeSlot* pSlot = (CFreeSlot*)(p + i*SLOT_SIZE);
+      pSlot->m_pNext = global.m_pHead;
+      global.m_pHead = pSlot;
+    } //for
+  } //if
+
+  for(size_t i=0; i<BATCH_SLOTS && global.m_pHead; i++){ //move a batch
+    CFreeSlot* pSlot = global.m_pHead;
+    global.m_pHead = pSlot->m_pNext;
+    pSlot->m_pNext = local.m_pHead;
+    local.m_pHead = pSlot;
+    local.m_nCount++;
+  } //for
+} //Refill
+
+/// Move slots from a thread-local free list to the global free list.
+/// \tparam CTaskClass Task descriptor.
+/// \param local Thread-local free list.
+/// \param n Number of slots to move.
+
+template <class CTaskClass>
+void CTaskPool<CTaskClass>::Spill(CLocal& local, size_t n){
+  CGlobal& global = Global(local.m_nNode);
+  std::lock_guard<std::mutex> lock(global.m_stdMutex);
+
+  for(size_t i=0; i<n && local.m_pHead; i++){ //move n slots
+    CFreeSlot* pSlot = local.m_pHead;
+    local.m_pHead = pSlot->m_pNext;
+    local.m_nCount--;
+    pSlot->m_pNext = global.m_pHead;
+    global.m_pHead = pSlot;
+  } //for
+} //Spill
+
+/// Allocate a cache-line aligned slot for a task descriptor from the
+/// calling thread's free list.
+/// \tparam CTaskClass Task descriptor.
+/// \return Pointer to an uninitialized slot of SLOT_SIZE bytes.
+
+template <class CTaskClass>
+void* CTaskPool<CTaskClass>::Allocate(){
+  CLocal& local = Local();
+
+  if(local.m_pHead == nullptr) //local free list is empty
+    Refill(local);
+
+  CFreeSlot* pSlot = local.m_pHead;
+  local.m_pHead = pSlot->m_pNext;
+  local.m_nCount--;
+
+  return pSlot;
+} //Allocate
+
+/// Return a slot to the calling thread's free list. If that free list has
+/// grown too long, then a batch of slots is moved to the global free list.
+/// \tparam CTaskClass Task descriptor.
+/// \param p Pointer to a slot returned by Allocate().
+
+template <class CTaskClass>
+void CTaskPool<CTaskClass>::Free(void* p){
+  CLocal& local = Local();
+
+  CFreeSlot* pSlot = (CFreeSlot*)p;
+  pSlot->m_pNext = local.m_pHead;
+  local.m_pHead = pSlot;
+  local.m_nCount++;
+
+  if(local.m_nCount > 2*BATCH_SLOTS) //too many, give some back
+    Spill(local, BATCH_SLOTS);
+} //Free
+
+///////////////////////////////////////////////////////////////////////////////
+// CPooledTask code.
+
+/// Allocate memory for a task descriptor from the pool.
+/// \tparam CTaskClass Task descriptor.
+/// \param n Size of the object to be allocated.
+/// \return Pointer to the memory allocated.
+
+template <class CTaskClass>
+void* CPooledTask<CTaskClass>::operator new(size_t n){
+  if(n > CTaskPool<CTaskClass>::SLOT_SIZE) //too big for a slot
+    return ::operator new(n);
+
+  return CTaskPool<CTaskClass>::Allocate();
+} //operator new
+
+/// Return the memory for a task descriptor to the pool.
+/// \tparam CTaskClass Task descriptor.
+/// \param p Pointer to the memory to be freed.
+/// \param n Size of the object being freed.
+
+template <class CTaskClass>
+void CPooledTask<CTaskClass>::operator delete(void* p, size_t n){
+  if(p == nullptr)return; //safety
+
+  if(n > CTaskPool<CTaskClass>::SLOT_SIZE) //was too big for a slot
+    ::operator delete(p);
+
+  else CTaskPool<CTaskClass>::Free(p);
+} //operator delete
+
+#endif //__TaskPool_h__
@@ -26,23 +26,51 @@
 #ifndef __Thread_h__
 #define __Thread_h__
 
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+
 #include "Common.h"
+#include "Affinity.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // CThread definition.
 
 /// \brief The thread class.
 ///
-/// Values and functionality for the threads.
+/// Values and functionality for the threads. Each thread has a pointer to
+/// the variables that it shares with its thread manager.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
 
-template <class CTaskClass>
-class CThread: public CCommon<CTaskClass>{
+template <class CTaskClass, class CQueueClass>
+class CThread{
   protected:
     size_t m_nThreadId = 0; ///< Thread identifier.
+    size_t m_nNodeId = max_size_t; ///< NUMA node identifier.
+    CCommon<CTaskClass, CQueueClass>* m_pCommon = nullptr; ///< Shared variables.
+    std::minstd_rand m_stdRandom; ///< PRNG for choosing steal victims.
+    size_t m_nSpinBudget = 0; ///< Pause instructions to spin for when idle.
+    bool m_bRetired = false; ///< Whether this thread retired.
+
+    bool GetTasks(std::vector<CTaskClass*>&); ///< Get the next tasks.
+    bool StealTask(std::vector<CTaskClass*>&); ///< Steal from another thread.
+    bool WaitTasks(std::vector<CTaskClass*>&); ///< Park until there are tasks.
+    bool Spin(std::vector<CTaskClass*>&); ///< Spin until there are tasks.
+    bool PerformTasks(std::vector<CTaskClass*>&); ///< Perform tasks.
+    void ReleaseSuccessors(CTaskClass*); ///< Make dependent tasks ready.
+    void Place(); ///< Pin to CPUs chosen by the thread manager.
+    bool Retire(); ///< Retire if this thread is not needed.
+    void Park(std::unique_lock<std::mutex>&, bool&); ///< Park once.
+
+    void Perform(CTaskClass*, std::true_type); ///< Perform task directly.
+    void Perform(CTaskClass*, std::false_type); ///< Perform task virtually.
     
   public:
-    CThread(size_t); ///< Constructor.
+    CThread(size_t, CCommon<CTaskClass, CQueueClass>*); ///< Constructor.
     
     void operator()(); ///< The code that gets run by each thread.
 }; //CThread
@@ -51,38 +79,462 @@ class CThread: public CCommon<CTaskClass>{
 // CThread code.
 
 /// Constructor.
-/// \param n Thread identifier.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param n Thread identifier.
+/// \param p Pointer to the variables shared with the thread manager.
 
-template <class CTaskClass>
-CThread<CTaskClass>::CThread(size_t n):
-  m_nThreadId(n){ //thread identifier
+template <class CTaskClass, class CQueueClass>
+CThread<CTaskClass, CQueueClass>::CThread(size_t n, 
+  CCommon<CTaskClass, CQueueClass>* p):
+  m_nThreadId(n), //thread identifier
+  m_pCommon(p), //shared variables
+  m_stdRandom((unsigned)n + 1), //seed differently for each thread
+  m_nSpinBudget(p->m_nMaxSpin){ //start with the largest spin budget
 } //constructor
 
-/// The function executed by a thread, which repeatedly pops a task from the
-/// thread-safe request queue, calls its Perform() function, then places it
-/// on the result queue. It exits when the request queue is empty or when an
-/// exit is forced by CCommon<CTaskClass>::m_bForceExit being set to true.
+/// Get the next batch of task descriptors to be performed. The batch size
+/// is set by CBaseThreadManager::SetBatchSize(), and is 1 by default. In
+/// work-stealing mode the batch is taken from the tail of this thread's own
+/// deque if possible, then from the request queue, and failing that a
+/// single task descriptor is stolen from another thread's deque. Otherwise
+/// the batch is taken from the request queue.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param vTask [OUT] Batch of pointers to task descriptors.
+/// \return true if at least one task descriptor was found.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::GetTasks(
+  std::vector<CTaskClass*>& vTask)
+{
+  const size_t nBatchSize = m_pCommon->m_nBatchSize; //max tasks to get
+  auto out = std::back_inserter(vTask); //output iterator
+  vTask.clear();
+
+  bool bFound = false; //whether any task descriptors were found
+
+  if(m_pCommon->m_nNumDeques == 0) //not work-stealing
+    bFound = m_pCommon->m_qRequest.DeleteUpTo(out, nBatchSize) > 0;
+
+  else{ //work-stealing
+    const size_t n = m_nThreadId%m_pCommon->m_nNumDeques; //own deque
+
+    bFound = m_pCommon->m_pDeque[n].DeleteUpTo(out, nBatchSize) > 0 ||
+      m_pCommon->m_qRequest.DeleteUpTo(out, nBatchSize) > 0 || 
+      StealTask(vTask);
+  } //else
+
+  if(bFound && m_pCommon->IsTrackingQueue()){ //track queue depth
+    m_pCommon->m_nNumQueued -= vTask.size();
+
+    if(m_pCommon->m_nCapacity > 0) //there may be room for a producer now
+      m_pCommon->WakeProducer();
+  } //if
+
+  if(bFound && m_pCommon->m_nNumTraces > 0) //tracing
+    for(CTaskClass* p: vTask)
+      if(p)m_pCommon->Trace(m_nThreadId, eTraceEvent::Dequeue, p->GetTaskId());
+
+  return bFound;
+} //GetTasks
+
+/// Steal a task descriptor from the head of the deque of another thread.
+/// The deques are tried in order starting at a random victim so that idle
+/// threads do not all converge on the same one. If the threads have been
+/// placed on NUMA nodes, then the deques of threads on the same node are
+/// tried first, so that task descriptors and their data tend to stay on
+/// the node where they were created.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param vTask [OUT] Batch that the stolen task descriptor is appended to.
+/// \return true if a task descriptor was stolen.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::StealTask(
+  std::vector<CTaskClass*>& vTask)
+{
+  const size_t n = m_pCommon->m_nNumDeques; //number of deques
+  const size_t nVictim = m_stdRandom()%n; //first victim
+  const std::vector<size_t>& vNode = m_pCommon->m_vNodeId; //thread nodes
+  CTaskClass* pTask = nullptr; //stolen task
+
+  for(size_t pass=0; pass<2; pass++) //same node first, then any node
+    for(size_t i=0; i<n; i++){ //try each deque in turn
+      const size_t j = (nVictim + i)%n; //victim
+
+      if(pass == 0 && !(j < vNode.size() && vNode[j] == m_nNodeId && 
+        m_nNodeId != max_size_t))continue; //not on same node
+
+      if(m_pCommon->m_pDeque[j].Steal(pTask)){
+        vTask.push_back(pTask);
+
+        if(m_pCommon->m_nNumStats > 0) //collecting statistics
+          m_pCommon->m_pStats[m_nThreadId%m_pCommon->m_nNumStats].AddSteal();
+
+        if(pTask) //a null pointer tells the thread to exit
+          m_pCommon->Trace(m_nThreadId, eTraceEvent::Steal, pTask->GetTaskId());
+
+        return true;
+      } //if
+    } //for
+
+  return false;
+} //StealTask
+
+/// Park this thread until a task descriptor becomes available. This is used
+/// only in persistent mode, where threads wait for more task descriptors
+/// to be inserted instead of exiting when they run out of tasks. Unless the
+/// idle policy is to park at once, the thread spins first. The thread
+/// announces that it is about to park before checking for tasks one more
+/// time, which guarantees that an insertion made in the meantime will either
+/// be found here or will see that this thread needs waking. In elastic mode
+/// a thread that stays parked for too long may retire instead.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param vTask [OUT] Batch of pointers to task descriptors.
+/// \return true if a task descriptor was found, false if the thread should
+/// exit.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::WaitTasks(
+  std::vector<CTaskClass*>& vTask)
+{
+  if(!m_pCommon->m_bPersistent || m_pCommon->m_bStop)
+    return false; //exit when out of tasks
+
+  const size_t nStats = m_pCommon->m_nNumStats; //number of statistics
+  const uint64_t t = nStats > 0? GetSteadyTimeNs(): 0; //idle start time
+
+  bool bFound = m_pCommon->m_eIdle != eIdle::Park && Spin(vTask);
+
+  if(!bFound){ //park
+    std::unique_lock<std::mutex> lock(m_pCommon->m_stdIdleMutex);
+    m_pCommon->m_nNumIdle++; //announce that we are about to park
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bFound = GetTasks(vTask); //check again now that we have announced
+
+    const bool bParked = !bFound; //whether this thread parks
+
+    if(bParked) //tracing, if on
+      m_pCommon->Trace(m_nThreadId, eTraceEvent::Park, 0);
+
+    bool bRetire = false; //whether this thread is to retire
+
+    while(!bFound && !bRetire && !m_pCommon->m_bStop && 
+      !m_pCommon->m_bForceExit)
+    {
+      Park(lock, bRetire); //park until woken
+      bFound = GetTasks(vTask); 
+    } //while
+
+    m_pCommon->m_nNumIdle--; //no longer parked
+
+    if(bParked) //tracing, if on
+      m_pCommon->Trace(m_nThreadId, eTraceEvent::Unpark, 0);
+  } //if
+
+  if(nStats > 0) //collecting statistics
+    m_pCommon->m_pStats[m_nThreadId%nStats].AddIdle(GetSteadyTimeNs() - t);
+
+  return bFound;
+} //WaitTasks
+
+/// Spin while waiting for a task descriptor, watching the count of ready
+/// task descriptors rather than the queues so that spinning threads do not
+/// fight over the queue locks. Each time around the loop costs one pause
+/// instruction until the spin budget runs out, then the thread yields its
+/// CPU a few times. Parked threads are not counted as idle while they spin,
+/// so a thread that inserts task descriptors does not try to wake them. In
+/// the adaptive idle policy, the spin budget is doubled if a task
+/// descriptor is found, up to the maximum, and halved if not.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param vTask [OUT] Batch of pointers to task descriptors.
+/// \return true if a task descriptor was found.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::Spin(std::vector<CTaskClass*>& vTask){
+  const size_t nSpin = m_nSpinBudget; //number of pause instructions
+  const size_t nYield = m_pCommon->m_nMaxYield; //number of yields
+  bool bFound = false; //whether a task descriptor was found
+
+  for(size_t i=0; i<nSpin + nYield && !bFound; i++){
+    if(m_pCommon->m_bStop || m_pCommon->m_bForceExit)
+      break; //let WaitTasks() deal with it
+
+    if(m_pCommon->m_nNumQueued.load(std::memory_order_relaxed) > 0)
+      bFound = GetTasks(vTask); //probably something there
+
+    else if(i < nSpin)CpuRelax();
+    else std::this_thread::yield();
+  } //for
+
+  if(m_pCommon->m_eIdle == eIdle::Adaptive){ //adjust spin budget
+    if(bFound)
+      m_nSpinBudget = std::min(2*m_nSpinBudget + 1, m_pCommon->m_nMaxSpin);
+    else m_nSpinBudget /= 2;
+  } //if
+
+  return bFound;
+} //Spin
+
+/// Perform a task by calling its Perform() function directly, bypassing the
+/// virtual function table so that the call can be inlined. This is used
+/// for task descriptors derived from CStaticTask.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param pTask Pointer to the task descriptor.
+
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::Perform(CTaskClass* pTask, 
+  std::true_type)
+{
+  pTask->CTaskClass::Perform();
+} //Perform
+
+/// Perform a task by calling its virtual Perform() function.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param pTask Pointer to the task descriptor.
+
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::Perform(CTaskClass* pTask, 
+  std::false_type)
+{
+  pTask->Perform();
+} //Perform
+
+/// Pin this thread to the CPUs chosen for it by the thread manager, if any,
+/// and record its NUMA node so that it can be given to the task descriptors
+/// it performs and to CTaskPool. Also point CBaseTask::StopRequested() at
+/// the thread manager's stop flag.
 /// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
 
-template <class CTaskClass>
-void CThread<CTaskClass>::operator()(){
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::Place(){
+  if(m_nThreadId < m_pCommon->m_vCpuSet.size())
+    PinCurrentThread(m_pCommon->m_vCpuSet[m_nThreadId]);
+
+  if(m_nThreadId < m_pCommon->m_vNodeId.size())
+    m_nNodeId = m_pCommon->m_vNodeId[m_nThreadId];
+
+  SetCurrentNode(m_nNodeId);
+  CBaseTask::SetStopFlag(&m_pCommon->m_bForceExit);
+} //Place
+
+/// Park until woken. In elastic mode, a thread that is not woken within the
+/// idle timeout asks to retire.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param lock Lock on the idle mutex.
+/// \param bRetire [OUT] Set to true if this thread is to retire.
+
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::Park(
+  std::unique_lock<std::mutex>& lock, bool& bRetire)
+{
+  if(!m_pCommon->m_bElastic)
+    m_pCommon->m_cvIdle.wait(lock);
+
+  else if(m_pCommon->m_cvIdle.wait_for(lock, m_pCommon->m_tIdleTimeout) == 
+    std::cv_status::timeout)
+    bRetire = Retire();
+} //Park
+
+/// Decide whether to retire after being idle for too long in elastic mode.
+/// A thread retires only if more than the minimum number of threads are
+/// still running, and the count of running threads is decremented with a
+/// compare-and-swap so that they cannot all retire at once.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \return true if this thread is to retire.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::Retire(){
+  size_t n = m_pCommon->m_nNumLive; //number of running threads
+
+  while(n > m_pCommon->m_nMinThreads)
+    if(m_pCommon->m_nNumLive.compare_exchange_weak(n, n - 1)){
+      m_bRetired = true;
+      return true;
+    } //if
+
+  return false;
+} //Retire
+
+/// Count down the pending dependencies of the tasks that depend on a task
+/// that has just been performed. Those that become ready are inserted into
+/// this thread's own deque in work-stealing mode, where they are likely to
+/// find their predecessor's data still in cache, and into the request queue
+/// otherwise. Idle threads are woken to help with them.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param pTask Pointer to a task descriptor that has just been performed.
+
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::ReleaseSuccessors(CTaskClass* pTask){
+  size_t nReady = 0; //number of tasks made ready
+
+  for(CBaseTask* p: pTask->GetSuccessors())
+    if(p->SatisfyDependency()){ //p is ready
+      CTaskClass* pReady = static_cast<CTaskClass*>(p); //same class
+
+      if(m_pCommon->IsTrackingQueue()) //track queue depth
+        m_pCommon->m_nNumQueued++;
+
+      if(m_pCommon->m_nNumStats > 0) //collecting statistics
+        pReady->SetEnqueueTime(GetSteadyTimeNs());
+
+      m_pCommon->Trace(m_nThreadId, eTraceEvent::Enqueue, pReady->GetTaskId());
+
+      if(m_pCommon->m_nNumDeques > 0) //work-stealing
+        m_pCommon->m_pDeque[m_nThreadId%m_pCommon->m_nNumDeques].Insert(pReady);
+      else m_pCommon->m_qRequest.Insert(pReady);
+
+      nReady++;
+    } //if
+
+  if(nReady > 0) 
+    m_pCommon->WakeIdleThread(nReady); //in case threads are parked
+} //ReleaseSuccessors
+
+/// Perform a batch of tasks and insert the completed task descriptors into
+/// the result queue all at once, or into this thread's own result buffer if
+/// the thread manager has asked for per-thread result buffers. A null
+/// pointer in the batch, or an exit forced by CCommon::m_bForceExit, stops
+/// the thread. The null pointer is consumed, since it was meant for this
+/// thread alone, and any task descriptors in the batch after it or not
+/// performed because of the forced exit are returned to the request queue
+/// so that they are not lost. If the thread manager is collecting
+/// statistics, then the steady clock is read once before each task and once
+/// after the last one, which gives the time each task waited, the time it
+/// took, and the time this thread was busy, and this thread's CPU time is
+/// read before and after the batch.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param vTask Batch of pointers to task descriptors.
+/// \return true to stay active, false to exit the thread.
+
+template <class CTaskClass, class CQueueClass>
+bool CThread<CTaskClass, CQueueClass>::PerformTasks(
+  std::vector<CTaskClass*>& vTask)
+{
+  const auto begin = vTask.begin(); //start of batch
+  auto it = begin; //current task descriptor
+
+  CWorkerStats* pStats = nullptr; //this thread's statistics, if any
+
+  if(m_pCommon->m_nNumStats > 0)
+    pStats = &m_pCommon->m_pStats[m_nThreadId%m_pCommon->m_nNumStats];
+
+  const uint64_t tStart = pStats? GetSteadyTimeNs(): 0; //batch start time
+  const uint64_t tCpu = pStats? CTimer::GetThreadCPUTimeNs(): 0; //CPU time
+  uint64_t t = tStart; //task start time
+
+  while(it != vTask.end() && *it && 
+    !m_pCommon->m_bForceExit.load(std::memory_order_relaxed))
+  {
+    (*it)->SetThreadId(m_nThreadId); //set task's thread identifier
+    (*it)->SetNodeId(m_nNodeId); //set task's NUMA node identifier
+    m_pCommon->Trace(m_nThreadId, eTraceEvent::Begin, (*it)->GetTaskId());
+    Perform(*it, typename std::is_base_of<CStaticTask<CTaskClass>, 
+      CTaskClass>::type()); //perform the task
+    m_pCommon->Trace(m_nThreadId, eTraceEvent::End, (*it)->GetTaskId());
+
+    if(pStats){ //collecting statistics
+      const uint64_t tEnd = GetSteadyTimeNs(); //task end time
+      const uint64_t tEnqueue = (*it)->GetEnqueueTime(); //task ready time
+      pStats->AddTask(t > tEnqueue? t - tEnqueue: 0, tEnd - t);
+      t = tEnd;
+    } //if
+
+    ReleaseSuccessors(*it); //tasks that were waiting for it
+    ++it;
+  } //while
+
+  if(pStats){ //collecting statistics
+    pStats->AddBusy(t - tStart);
+    pStats->AddCpu(CTimer::GetThreadCPUTimeNs() - tCpu);
+  } //if
+
+  if(m_pCommon->m_nNumTraces > 0) //tracing, before the results are deleted
+    for(auto p=begin; p!=it; ++p)
+      m_pCommon->Trace(m_nThreadId, eTraceEvent::Publish, (*p)->GetTaskId());
+
+  const size_t nBuffers = m_pCommon->m_nNumResultBuffers; //result buffers
+
+  if(nBuffers == 0) //shared result queue
+    m_pCommon->m_qResult.InsertBatch(begin, it); //performed task results
+
+  else if(it != begin){ //our own result buffer
+    m_pCommon->m_pResultBuffer[m_nThreadId%nBuffers].InsertBatch(begin, it);
+    m_pCommon->WakeResultWaiter();
+  } //else if
+
+  if(it == vTask.end()) //performed whole batch
+    return true;
+
+  if(*it == nullptr) //the null pointer that tells this thread to exit
+    ++it;
+
+  if(it != vTask.end()){ //return the rest for other threads
+    const size_t n = (size_t)std::distance(it, vTask.end()); //number left
+
+    if(m_pCommon->IsTrackingQueue()) //track queue depth
+      m_pCommon->m_nNumQueued += n;
+
+    m_pCommon->m_qRequest.InsertBatch(it, vTask.end());
+    m_pCommon->WakeIdleThread(n); //in case threads are parked
+  } //if
+
+  return false;
+} //PerformTasks
+
+/// The function executed by a thread, which repeatedly pops a batch of
+/// tasks from the thread-safe request queue (or its deque in work-stealing
+/// mode), calls their Perform() functions, then places them on the result
+/// queue. It exits when there are no tasks left to perform (or in
+/// persistent mode, when there are no tasks left and the thread manager has
+/// asked it to stop) or when an exit is forced by CCommon::m_bForceExit
+/// being set to true. In elastic mode it frees its place in the thread list
+/// as it exits. A thread that exits without retiring, for example because
+/// it took a null pointer, also stops being counted as live, since only
+/// Retire() counts the ones that retire.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CTaskClass, class CQueueClass>
+void CThread<CTaskClass, CQueueClass>::operator()(){
   bool bActive = true; //true to stay active, false to exit thread
+  std::vector<CTaskClass*> vTask; //current batch of task descriptors
+
+  Place(); //before allocating anything
 
   while(bActive){ //perform task loop
-    CTaskClass* pTask = nullptr; //current task descriptor
-   
-    if(CCommon<CTaskClass>::m_bForceExit) //forced exit
+    if(m_pCommon->m_bForceExit) //forced exit
       bActive = false; //trigger exit from loop
 
-    else if(CCommon<CTaskClass>::m_qRequest.Delete(pTask) && pTask){ //next task
-      pTask->SetThreadId(m_nThreadId); //set task's thread identifier
-      pTask->Perform(); //perform the task
-      CCommon<CTaskClass>::m_qResult.Insert(pTask); //performed task result
-    } //if
+    else if(GetTasks(vTask) || WaitTasks(vTask)) //next batch of tasks
+      bActive = PerformTasks(vTask);
 
     else bActive = false; //request queue empty, so trigger exit from loop
   } //while
+
+  std::lock_guard<std::mutex> lock(m_pCommon->m_stdThreadMutex);
+
+  if(m_pCommon->m_bElastic){ //free this thread's slot
+    if(!m_bRetired) //exiting for some other reason, such as a null pointer
+      m_pCommon->m_nNumLive--;
+
+    m_pCommon->m_vRetired[m_nThreadId] = true;
+  } //if
+
+  m_pCommon->m_nNumRunning--;
+  m_pCommon->m_cvExit.notify_all(); //in case of a shutdown with a deadline
+  m_pCommon->WakeProducer(); //in case one is waiting for this thread
 } //operator()()
 
 #endif //__BaseThread_h__
@@ -28,6 +28,10 @@
 
 #include <queue>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iterator>
+#include <cstddef>
 
 ///////////////////////////////////////////////////////////////////////////////
 // CThreadSafeQueue definition.
@@ -36,6 +40,11 @@
 ///
 /// A thread-safe queue of task descriptors for communicating between the
 /// threads and the thread manager. It uses an `std::mutex` for safety.
+/// Consumers that would rather wait for a task descriptor than poll for one
+/// can use `WaitDelete()`, `TryDeleteFor()`, or `TryDeleteUntil()`, which
+/// sleep on an `std::condition_variable` that is notified by `Insert()`.
+/// `InsertBatch()` and `DeleteUpTo()` insert and delete many task
+/// descriptors while locking the mutex only once.
 /// \tparam CTaskClass Task descriptor.
 
 template <class CTaskClass>
@@ -43,6 +52,8 @@ class CThreadSafeQueue{
   private:
     std::mutex m_stdMutex; ///< Mutex for thread safety.
     std::queue<CTaskClass> m_stdQueue; ///< The task descriptor queue.
+    std::condition_variable m_cvNotEmpty; ///< Signalled on insertion.
+    size_t m_nNumWaiters = 0; ///< Number of consumers waiting.
 
   public:
     CThreadSafeQueue(); ///< Constructor.
@@ -51,6 +62,22 @@ class CThreadSafeQueue{
     void Insert(const CTaskClass& element); ///< Insert task at tail.
     bool Delete(CTaskClass& element); ///< Delete task from head.
     void Flush(); ///< Flush out and discard all tasks in queue.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt first, ForwardIt last); ///< Insert many tasks.
+
+    template <class OutputIt> 
+    size_t DeleteUpTo(OutputIt out, size_t n); ///< Delete many tasks.
+
+    void WaitDelete(CTaskClass& element); ///< Wait for task then delete it.
+
+    template <class Rep, class Period> 
+    bool TryDeleteFor(CTaskClass& element, 
+      const std::chrono::duration<Rep, Period>& timeout); ///< Wait for a time.
+
+    template <class Clock, class Duration> 
+    bool TryDeleteUntil(CTaskClass& element, 
+      const std::chrono::time_point<Clock, Duration>& deadline); ///< Wait until.
 }; //CThreadSafeQueue
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -71,7 +98,8 @@ CThreadSafeQueue<CTaskClass>::~CThreadSafeQueue(){
 } //destructor
 
 /// Insert a task descriptor into the queue. A mutex is used to ensure
-/// thread safety.
+/// thread safety. If there are consumers waiting for a task descriptor,
+/// then one of them is woken.
 /// \tparam CTaskClass Task descriptor.
 /// \param element The element to be inserted into the queue.
 
@@ -79,7 +107,11 @@ template <class CTaskClass>
 void CThreadSafeQueue<CTaskClass>::Insert(const CTaskClass& element){
   m_stdMutex.lock(); 
   m_stdQueue.push(element); 
+  const bool bWake = m_nNumWaiters > 0; //true if a consumer is waiting
   m_stdMutex.unlock();
+
+  if(bWake)
+    m_cvNotEmpty.notify_one();
 } //Insert
 
 /// Delete and return a task descriptor from the queue. A mutex is used to
@@ -119,4 +151,128 @@ void CThreadSafeQueue<CTaskClass>::Flush(){
   m_stdMutex.unlock();
 } //Flush
 
+/// Insert a range of task descriptors into the queue at the cost of a
+/// single lock of the mutex. If there are consumers waiting for a task
+/// descriptor, then they are all woken.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param last Iterator to one past the last element to be inserted.
+
+template <class CTaskClass>
+template <class ForwardIt> 
+void CThreadSafeQueue<CTaskClass>::InsertBatch(ForwardIt first, 
+  ForwardIt last)
+{
+  if(first == last)return; //nothing to insert
+
+  m_stdMutex.lock(); 
+
+  for(ForwardIt it=first; it!=last; ++it) //for each element
+    m_stdQueue.push(*it); 
+
+  const bool bWake = m_nNumWaiters > 0; //true if a consumer is waiting
+  m_stdMutex.unlock();
+
+  if(bWake)
+    m_cvNotEmpty.notify_all();
+} //InsertBatch
+
+/// Delete and return up to a given number of task descriptors from the
+/// queue at the cost of a single lock of the mutex.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \param n Maximum number of elements to delete.
+/// \return Number of elements deleted, which is 0 if the queue was empty.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CThreadSafeQueue<CTaskClass>::DeleteUpTo(OutputIt out, size_t n){
+  size_t count = 0; //number of elements deleted
+  
+  m_stdMutex.lock();  
+
+  while(count < n && !m_stdQueue.empty()){ //queue has something in it
+    *out++ = m_stdQueue.front(); //get element from front of queue
+    m_stdQueue.pop(); //delete from front of queue
+    count++;
+  } //while
+  
+  m_stdMutex.unlock();
+
+  return count;
+} //DeleteUpTo
+
+/// Wait until the queue is not empty, then delete and return a task
+/// descriptor from it. This blocks until some other thread inserts a task
+/// descriptor, so make sure that one will.
+/// \tparam CTaskClass Task descriptor.
+/// \param element [OUT] The element deleted from the queue.
+
+template <class CTaskClass>
+void CThreadSafeQueue<CTaskClass>::WaitDelete(CTaskClass& element){
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+
+  m_nNumWaiters++;
+
+  while(m_stdQueue.empty()) //guard against spurious wakeups
+    m_cvNotEmpty.wait(lock);
+
+  m_nNumWaiters--;
+
+  element = m_stdQueue.front(); //get element from front of queue
+  m_stdQueue.pop(); //delete from front of queue
+} //WaitDelete
+
+/// Wait until the queue is not empty or a deadline passes, whichever comes
+/// first, then delete and return a task descriptor if there is one.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam Clock Clock that the deadline is measured on.
+/// \tparam Duration Duration type of the deadline.
+/// \param element [OUT] The element deleted from the queue.
+/// \param deadline Time point after which to give up.
+/// \return true if the delete was successful, false if the deadline passed.
+
+template <class CTaskClass>
+template <class Clock, class Duration> 
+bool CThreadSafeQueue<CTaskClass>::TryDeleteUntil(CTaskClass& element,
+  const std::chrono::time_point<Clock, Duration>& deadline)
+{
+  std::unique_lock<std::mutex> lock(m_stdMutex);
+
+  m_nNumWaiters++;
+
+  while(m_stdQueue.empty()) //guard against spurious wakeups
+    if(m_cvNotEmpty.wait_until(lock, deadline) == std::cv_status::timeout)
+      break;
+
+  m_nNumWaiters--;
+
+  if(m_stdQueue.empty()) //timed out
+    return false;
+
+  element = m_stdQueue.front(); //get element from front of queue
+  m_stdQueue.pop(); //delete from front of queue
+
+  return true;
+} //TryDeleteUntil
+
+/// Wait until the queue is not empty or a timeout expires, whichever comes
+/// first, then delete and return a task descriptor if there is one.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam Rep Arithmetic type of the number of ticks in the timeout.
+/// \tparam Period Tick period of the timeout.
+/// \param element [OUT] The element deleted from the queue.
+/// \param timeout Maximum amount of time to wait.
+/// \return true if the delete was successful, false if the timeout expired.
+
+template <class CTaskClass>
+template <class Rep, class Period> 
+bool CThreadSafeQueue<CTaskClass>::TryDeleteFor(CTaskClass& element,
+  const std::chrono::duration<Rep, Period>& timeout)
+{
+  return TryDeleteUntil(element, std::chrono::steady_clock::now() + timeout);
+} //TryDeleteFor
+
 #endif //__ThreadSafeQueue_h__
\ No newline at end of file
@@ -72,6 +72,32 @@ void AppendCommaSeparator(std::string& s){
   if(!s.empty())s += ", ";
 } //AppendCommaSeparator
 
+/// Read the steady clock. This is the clock used for elapsed times, since
+/// it never jumps backwards.
+/// \return Time since the steady clock's epoch in nanoseconds.
+
+uint64_t GetSteadyTimeNs(){
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    steadyclock::now().time_since_epoch()).count();
+} //GetSteadyTimeNs
+
+#if defined(_MSC_VER) //Windows Visual Studio 
+
+/// Add together two Windows file times, which are in units of 100
+/// nanoseconds, and convert to nanoseconds.
+/// \param ft0 A file time.
+/// \param ft1 Another file time.
+/// \return Sum in nanoseconds.
+
+static uint64_t FileTimeSumNs(const FILETIME& ft0, const FILETIME& ft1){
+  ULARGE_INTEGER t0, t1; //file times as 64-bit integers
+  t0.LowPart = ft0.dwLowDateTime; t0.HighPart = ft0.dwHighDateTime;
+  t1.LowPart = ft1.dwLowDateTime; t1.HighPart = ft1.dwHighDateTime;
+  return 100*(t0.QuadPart + t1.QuadPart);
+} //FileTimeSumNs
+
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // CTimer functions.
 
@@ -156,8 +182,8 @@ const std::string CTimer::TimeString(float fSeconds, size_t n) const{
 /// Start timing by saving the current elapsed and CPU times.
 
 void CTimer::Start(){
-  m_tpElapsedTimeStart = sysclock::now(); //time_point
-  m_fCPUTimeStart = CPUTime()/1000.0f;
+  m_tpElapsedTimeStart = steadyclock::now(); //time_point
+  m_nCPUTimeStart = GetProcessCPUTimeNs();
 } //Start
 
 /// Get time and date string from a systime_point.
@@ -182,41 +208,90 @@ const std::string CTimer::GetTimeAndDate() const{
 /// \return Elapsed time.
 
 const std::string CTimer::GetElapsedTime() const{
-  const std::chrono::duration<float> d = sysclock::now() - m_tpElapsedTimeStart;
-  return TimeString(d.count(), 2);
+  return TimeString(GetElapsedTimeNs()/1e9f, 2);
 } //GetElapsedTime
 
-/// Get CPU time for this process in seconds. It's annoying that `std::chron`
-/// has no cross-platform support for this.
-/// \return User CPU time in milliseconds.
+/// Get the amount of CPU time used since the timer was started.
+/// \return CPU time in seconds.
+
+const std::string CTimer::GetCPUTime() const{
+  return TimeString(GetCPUTimeNs()/1e9f, 2);
+} //GetCPUTime
 
-const uint64_t CTimer::CPUTime() const{
+/// Get the amount of time elapsed since the timer was started as a number.
+/// \return Elapsed time in nanoseconds.
+
+const uint64_t CTimer::GetElapsedTimeNs() const{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    steadyclock::now() - m_tpElapsedTimeStart).count();
+} //GetElapsedTimeNs
+
+/// Get the amount of CPU time used by this process since the timer was
+/// started as a number.
+/// \return CPU time in nanoseconds.
+
+const uint64_t CTimer::GetCPUTimeNs() const{
+  return GetProcessCPUTimeNs() - m_nCPUTimeStart;
+} //GetCPUTimeNs
+
+/// Get the parallel efficiency since the timer was started, which is the
+/// CPU time divided by the elapsed time multiplied by the number of threads.
+/// This is 1 if all of the threads were busy all of the time, and less if
+/// they spent time waiting for work or for each other.
+/// \param nThreads Number of threads, including the main thread if it does
+/// useful work.
+/// \return Parallel efficiency, or 0 if no time has elapsed.
+
+const double CTimer::GetParallelEfficiency(size_t nThreads) const{
+  const uint64_t t = GetElapsedTimeNs(); //elapsed time
+  if(t == 0 || nThreads == 0)return 0.0;
+  return (double)GetCPUTimeNs()/((double)t*nThreads);
+} //GetParallelEfficiency
+
+/// Get the CPU time used so far by this process, summed over all threads
+/// and including time spent in the kernel on its behalf. It's annoying that
+/// `std::chrono` has no cross-platform support for this.
+/// \return CPU time in nanoseconds.
+
+uint64_t CTimer::GetProcessCPUTimeNs(){
 #if defined(_MSC_VER) //Windows Visual Studio 
-  uint64_t llCNS = 0; //for CPU time in centinanoseconds
+  FILETIME ftCreation, ftExit, ftKernel, ftUser; //process times
 
-  HANDLE hProcess = //handle to this process
-    OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, GetCurrentProcessId()); 
+  if(GetProcessTimes(GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, 
+    &ftUser))
+    return FileTimeSumNs(ftKernel, ftUser);
 
-  if(hProcess != nullptr){ //handle is valid
-    FILETIME ftCreation, ftExit, ftKernel; //unused
-    FILETIME ftUser; //this one we want 
+  return 0;
+#else //g++, *nix
+  timespec ts; //for CPU time
 
-    if(GetProcessTimes(hProcess, &ftCreation, &ftExit, &ftKernel, &ftUser))
-      llCNS = *((uint64_t*)&ftUser);  //get time values
-    
-    CloseHandle(hProcess); //close the process handle
-  } //if
+  if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+    return 1000000000ULL*(uint64_t)ts.tv_sec + (uint64_t)ts.tv_nsec;
 
-  return uint64_t(llCNS)/10000; 
-#else //g++, *nix
-  return uint64_t(1000.0*(double)(clock())/CLOCKS_PER_SEC);
+  return 0;
 #endif
-} //CPUTime
+} //GetProcessCPUTimeNs
 
-/// Get the amount of CPU time used since the timer was started.
-/// \return CPU time in seconds.
+/// Get the CPU time used so far by the calling thread, including time spent
+/// in the kernel on its behalf. This is what a thread calls to measure its
+/// own share of the CPU time.
+/// \return CPU time in nanoseconds.
 
-const std::string CTimer::GetCPUTime() const{
-  return TimeString(CPUTime()/1000.0f - m_fCPUTimeStart, 2);
-} //GetCPUTime
+uint64_t CTimer::GetThreadCPUTimeNs(){
+#if defined(_MSC_VER) //Windows Visual Studio 
+  FILETIME ftCreation, ftExit, ftKernel, ftUser; //thread times
+
+  if(GetThreadTimes(GetCurrentThread(), &ftCreation, &ftExit, &ftKernel, 
+    &ftUser))
+    return FileTimeSumNs(ftKernel, ftUser);
+
+  return 0;
+#else //g++, *nix
+  timespec ts; //for CPU time
+
+  if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return 1000000000ULL*(uint64_t)ts.tv_sec + (uint64_t)ts.tv_nsec;
 
+  return 0;
+#endif
+} //GetThreadCPUTimeNs
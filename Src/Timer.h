@@ -37,6 +37,10 @@ typedef std::chrono::system_clock sysclock; ///< Shorthand for system clock.
 typedef std::chrono::time_point
   <std::chrono::system_clock> systime_point; ///< Shorthand for sysclock time point.
 
+typedef std::chrono::steady_clock steadyclock; ///< Shorthand for steady clock.
+
+uint64_t GetSteadyTimeNs(); ///< Steady clock time in nanoseconds.
+
 /// \brief Timer for elapsed time and CPU time.
 ///
 /// The timer is charged with everything that is time-related, in particular,
@@ -44,13 +48,20 @@ typedef std::chrono::time_point
 /// intervals measured from the time `Start()` is called to the current time.
 /// The CPU time reported is the total summed over all threads. Uses
 /// `std::chrono` to do the heavy lifting. 
+///
+/// Elapsed time is measured with the steady clock, which unlike the system
+/// clock never jumps when the time of day is adjusted. The functions whose
+/// names end in `Ns` return times as numbers of nanoseconds instead of
+/// strings, so that they can be used in calculations and in code that runs
+/// often. The static functions read the steady clock and the CPU time used
+/// by the process or by the calling thread directly, so that, for example,
+/// each thread can measure its own CPU time.
 
 class CTimer{
   private:
-    systime_point m_tpElapsedTimeStart; ///< Clock time.
-    float m_fCPUTimeStart; ///< CPU time in seconds.
+    steadyclock::time_point m_tpElapsedTimeStart; ///< Clock time.
+    uint64_t m_nCPUTimeStart = 0; ///< CPU time in nanoseconds.
 
-    const uint64_t CPUTime() const; ///< Compute CPU time.
     const std::string TimeString(float seconds, size_t n) const; ///< Time as a string.
 
     const std::string GetTimeAndDate(const systime_point) const; ///< Get date and time.
@@ -64,6 +75,13 @@ class CTimer{
     
     const std::string GetElapsedTime() const; ///< Get elapsed time in seconds.
     const std::string GetCPUTime() const; ///< Get CPU time in seconds.
+
+    const uint64_t GetElapsedTimeNs() const; ///< Get elapsed time.
+    const uint64_t GetCPUTimeNs() const; ///< Get CPU time.
+    const double GetParallelEfficiency(size_t) const; ///< Get efficiency.
+
+    static uint64_t GetProcessCPUTimeNs(); ///< CPU time used by process.
+    static uint64_t GetThreadCPUTimeNs(); ///< CPU time used by this thread.
 }; //CTimer
 
 ///////////////////////////////////////////////////////////////////////////////
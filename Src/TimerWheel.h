@@ -0,0 +1,304 @@
+/// \file TimerWheel.h
+/// \brief Header and code for the class CTimerWheel.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef __TimerWheel_h__
+#define __TimerWheel_h__
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "BaseTask.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CTimerWheel definition.
+
+/// \brief Hierarchical timer wheel.
+///
+/// A hierarchical timer wheel holds elements that are due at some time in
+/// the future, measured in ticks, and hands them back when the time comes.
+/// Level 0 has one slot per tick for the next 64 ticks, level 1 has one slot
+/// per 64 ticks for the next 64 of those, and so on. An element goes into
+/// the lowest level whose current block contains its due time, so
+/// insertion takes constant time however far ahead it is. When the time
+/// reaches the start of a slot in a higher level, that slot's elements
+/// cascade down into lower levels, and when it reaches a level 0 slot, its
+/// elements are due. Elements due beyond the top level wait in an overflow
+/// list until the top level wraps around.
+///
+/// Advance() skips straight over empty slots, and GetNextTick() tells the
+/// caller how long it can sleep before anything can happen, so nobody has
+/// to wake up once a tick. The timer wheel is not thread-safe, so the
+/// caller must hold a lock while using it.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+
+template <class CTaskClass>
+class CTimerWheel{
+  public:
+    static const size_t SLOT_BITS = 6; ///< Log base 2 of slots per level.
+    static const size_t NUM_SLOTS = 1 << SLOT_BITS; ///< Slots per level.
+    static const size_t NUM_LEVELS = 4; ///< Number of levels.
+
+  private:
+    /// \brief An element and when it is due.
+
+    struct CEntry{
+      uint64_t m_nDue; ///< Tick at which the element is due.
+      CTaskClass m_tValue; ///< The element.
+    }; //CEntry
+
+    std::vector<CEntry> m_vSlot[NUM_LEVELS][NUM_SLOTS]; ///< The slots.
+    std::vector<CEntry> m_vOverflow; ///< Elements beyond the top level.
+    uint64_t m_nNow = 0; ///< Current tick.
+    size_t m_nSize = 0; ///< Number of elements.
+
+    void Place(const CEntry&); ///< Put an entry in the right slot.
+    void Cascade(); ///< Move entries down at the start of a block.
+
+  public:
+    void Insert(uint64_t, const CTaskClass&); ///< Insert an element.
+
+    template <class OutputIt> 
+    size_t Advance(uint64_t, OutputIt); ///< Advance time, get due elements.
+
+    template <class OutputIt> 
+    size_t DeleteAll(OutputIt); ///< Delete all elements.
+
+    void SetTime(uint64_t); ///< Set the current tick, if empty.
+    const uint64_t GetTime() const; ///< Get the current tick.
+    const uint64_t GetNextTick() const; ///< When something may happen next.
+    const size_t GetSize() const; ///< Get the number of elements.
+    const bool IsEmpty() const; ///< Is the timer wheel empty?
+}; //CTimerWheel
+
+///////////////////////////////////////////////////////////////////////////////
+// CTimerWheel code.
+
+/// Put an entry into the slot of the lowest level whose current block
+/// contains its due time, or into the overflow list if there is none. The
+/// due time must be later than the current tick.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \param e Entry.
+
+template <class CTaskClass>
+void CTimerWheel<CTaskClass>::Place(const CEntry& e){
+  const uint64_t x = e.m_nDue ^ m_nNow; //bits that differ
+
+  for(size_t i=0; i<NUM_LEVELS; i++){ //lowest level first
+    const size_t nShift = i*SLOT_BITS; //ticks per slot is 2 to this
+
+    if((x >> (nShift + SLOT_BITS)) == 0){ //due in this level's current block
+      m_vSlot[i][(e.m_nDue >> nShift)%NUM_SLOTS].push_back(e);
+      return;
+    } //if
+  } //for
+
+  m_vOverflow.push_back(e);
+} //Place
+
+/// Move the entries in the slots that start at the current tick down into
+/// lower levels. Level 1 is checked if the current tick is the start of a
+/// level 0 block, level 2 if it is also the start of a level 1 block, and
+/// so on up to the overflow list.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+
+template <class CTaskClass>
+void CTimerWheel<CTaskClass>::Cascade(){
+  std::vector<CEntry> v; //entries to be moved
+
+  for(size_t i=1; i<=NUM_LEVELS; i++){ //higher levels
+    const size_t nShift = i*SLOT_BITS; //ticks per slot is 2 to this
+
+    if((m_nNow & ((uint64_t(1) << nShift) - 1)) != 0)
+      return; //not the start of a block in level i - 1
+
+    if(i < NUM_LEVELS)
+      v.swap(m_vSlot[i][(m_nNow >> nShift)%NUM_SLOTS]);
+    else v.swap(m_vOverflow);
+
+    for(const CEntry& e: v)
+      Place(e);
+
+    v.clear();
+  } //for
+} //Cascade
+
+/// Insert an element. An element that is due at or before the current
+/// tick is due at the next one.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \param nDue Tick at which the element is due.
+/// \param t The element.
+
+template <class CTaskClass>
+void CTimerWheel<CTaskClass>::Insert(uint64_t nDue, const CTaskClass& t){
+  CEntry e; //new entry
+  e.m_nDue = nDue > m_nNow? nDue: m_nNow + 1;
+  e.m_tValue = t;
+
+  Place(e);
+  m_nSize++;
+} //Insert
+
+/// Advance the current tick and delete and return the elements that are
+/// now due, in order of due time. Slots that are empty are skipped over
+/// without being visited.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \tparam OutputIt Output iterator type.
+/// \param nTick New current tick, which is ignored if it is in the past.
+/// \param out [OUT] Output iterator that the due elements are written to.
+/// \return Number of elements written.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CTimerWheel<CTaskClass>::Advance(uint64_t nTick, OutputIt out){
+  size_t n = 0; //number of elements written
+
+  while(m_nNow < nTick){
+    const uint64_t nNext = GetNextTick(); //next tick worth visiting
+
+    if(nNext > nTick){ //nothing happens before nTick
+      m_nNow = nTick;
+      break;
+    } //if
+
+    m_nNow = nNext;
+    Cascade();
+
+    std::vector<CEntry>& v = m_vSlot[0][m_nNow%NUM_SLOTS]; //due now
+
+    for(const CEntry& e: v)
+      *out++ = e.m_tValue;
+
+    n += v.size();
+    m_nSize -= v.size();
+    v.clear();
+  } //while
+
+  return n;
+} //Advance
+
+/// Delete and return all of the elements, whether they are due or not.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the elements are written to.
+/// \return Number of elements written.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CTimerWheel<CTaskClass>::DeleteAll(OutputIt out){
+  const size_t n = m_nSize; //number of elements
+
+  for(size_t i=0; i<NUM_LEVELS; i++)
+    for(size_t j=0; j<NUM_SLOTS; j++){
+      for(const CEntry& e: m_vSlot[i][j])
+        *out++ = e.m_tValue;
+
+      m_vSlot[i][j].clear();
+    } //for
+
+  for(const CEntry& e: m_vOverflow)
+    *out++ = e.m_tValue;
+
+  m_vOverflow.clear();
+  m_nSize = 0;
+
+  return n;
+} //DeleteAll
+
+/// Set the current tick, but only if the timer wheel is empty, since the
+/// slots that elements are in depend on it. Use this to catch up after the
+/// timer wheel has been idle for a long time.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \param nTick New current tick.
+
+template <class CTaskClass>
+void CTimerWheel<CTaskClass>::SetTime(uint64_t nTick){
+  if(m_nSize == 0)
+    m_nNow = nTick;
+} //SetTime
+
+/// Reader function for the current tick.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \return The current tick.
+
+template <class CTaskClass>
+const uint64_t CTimerWheel<CTaskClass>::GetTime() const{
+  return m_nNow;
+} //GetTime
+
+/// Get the next tick at which Advance() may have something to do, which is
+/// the start of the next non-empty slot in any level. Nothing can become
+/// due before then, although it may be that nothing is due then either
+/// and elements merely cascade down.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \return The next tick worth visiting, or the largest `uint64_t` if empty.
+
+template <class CTaskClass>
+const uint64_t CTimerWheel<CTaskClass>::GetNextTick() const{
+  uint64_t nNext = UINT64_MAX; //result
+
+  if(m_nSize == 0)
+    return nNext;
+
+  for(size_t i=0; i<NUM_LEVELS; i++){ //for each level
+    const size_t nShift = i*SLOT_BITS; //ticks per slot is 2 to this
+    const uint64_t nBlock = 
+      (m_nNow >> (nShift + SLOT_BITS)) << (nShift + SLOT_BITS); //block start
+
+    for(size_t j=(m_nNow >> nShift)%NUM_SLOTS + 1; j<NUM_SLOTS; j++)
+      if(!m_vSlot[i][j].empty()){ //first non-empty slot after current one
+        nNext = std::min(nNext, nBlock + (uint64_t(j) << nShift));
+        break;
+      } //if
+  } //for
+
+  if(!m_vOverflow.empty()){ //next time the top level wraps around
+    const size_t nShift = NUM_LEVELS*SLOT_BITS; //ticks per top level block
+    nNext = std::min(nNext, ((m_nNow >> nShift) + 1) << nShift);
+  } //if
+
+  return nNext;
+} //GetNextTick
+
+/// Reader function for the number of elements.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \return The number of elements.
+
+template <class CTaskClass>
+const size_t CTimerWheel<CTaskClass>::GetSize() const{
+  return m_nSize;
+} //GetSize
+
+/// Check whether the timer wheel is empty.
+/// \tparam CTaskClass Task descriptor, or whatever else is to be scheduled.
+/// \return true if there are no elements.
+
+template <class CTaskClass>
+const bool CTimerWheel<CTaskClass>::IsEmpty() const{
+  return m_nSize == 0;
+} //IsEmpty
+
+#endif //__TimerWheel_h__
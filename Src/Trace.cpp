@@ -0,0 +1,172 @@
+/// \file Trace.cpp
+/// \brief Code for the trace event buffer class CTraceBuffer and the
+/// Chrome trace writer.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <algorithm>
+#include <iomanip>
+
+#include "Trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceBuffer code.
+
+/// Constructor. The buffer has no room for events until SetCapacity() is
+/// called.
+
+CTraceBuffer::CTraceBuffer(): m_nSize(0){
+} //constructor
+
+/// Set the number of events that the buffer can hold, and throw away any
+/// that it already holds. This must not be called while other threads are
+/// recording events.
+/// \param n Capacity in events.
+
+void CTraceBuffer::SetCapacity(size_t n){
+  m_vEvent.assign(n, CTraceEvent());
+  m_nSize.store(0, std::memory_order_relaxed);
+} //SetCapacity
+
+/// Record an event at the current time.
+/// \param e Event type.
+/// \param nTaskId Task identifier, if any.
+
+void CTraceBuffer::Record(eTraceEvent e, size_t nTaskId){
+  const size_t i = m_nSize.fetch_add(1, std::memory_order_relaxed); //slot
+
+  if(i < m_vEvent.size()){ //there is room
+    CTraceEvent& event = m_vEvent[i]; //the slot
+    event.m_nTime = GetSteadyTimeNs();
+    event.m_nTaskId = nTaskId;
+    event.m_eType = e;
+  } //if
+} //Record
+
+/// Reader function for the number of events recorded.
+/// \return Number of events recorded.
+
+const size_t CTraceBuffer::GetSize() const{
+  return std::min(m_nSize.load(std::memory_order_relaxed), m_vEvent.size());
+} //GetSize
+
+/// Reader function for the number of events that were not recorded because
+/// the buffer was full.
+/// \return Number of events dropped.
+
+const size_t CTraceBuffer::GetNumDropped() const{
+  const size_t n = m_nSize.load(std::memory_order_relaxed); //number of events
+  return n > m_vEvent.size()? n - m_vEvent.size(): 0;
+} //GetNumDropped
+
+/// Reader function for an event.
+/// \param i Index of an event, less than GetSize().
+/// \return Reference to event i.
+
+const CTraceEvent& CTraceBuffer::GetEvent(size_t i) const{
+  return m_vEvent[i];
+} //GetEvent
+
+///////////////////////////////////////////////////////////////////////////////
+// Chrome trace writer.
+
+/// Write one event in Chrome trace event format. Perform() calls and parked
+/// periods become duration events, which show up as bars on the timeline,
+/// and everything else becomes an instant event, which shows up as a tick.
+/// \param out Output stream.
+/// \param event Trace event.
+/// \param tid Thread identifier, which is the row on the timeline.
+/// \param t0 Time at which the trace starts, in nanoseconds.
+
+static void WriteEvent(std::ostream& out, const CTraceEvent& event, 
+  size_t tid, uint64_t t0)
+{
+  static const char* strName[] = { //event names, in order of eTraceEvent
+    "Enqueue", "Dequeue", "Steal", "Task", "Task", "Publish", "Process", 
+    "Parked", "Parked"
+  }; //strName
+
+  const eTraceEvent e = event.m_eType; //event type
+  const bool bPark = e == eTraceEvent::Park || e == eTraceEvent::Unpark;
+  const char* ph = "i"; //phase, instant by default
+
+  if(e == eTraceEvent::Begin || e == eTraceEvent::Park)ph = "B";
+  else if(e == eTraceEvent::End || e == eTraceEvent::Unpark)ph = "E";
+
+  out << ",\n{\"name\":\"" << strName[(size_t)e];
+  if(!bPark)out << ' ' << event.m_nTaskId;
+  out << "\",\"ph\":\"" << ph << "\",\"ts\":" << 
+    (event.m_nTime > t0? event.m_nTime - t0: 0)/1000.0 << 
+    ",\"pid\":0,\"tid\":" << tid;
+
+  if(*ph == 'i')out << ",\"s\":\"t\"";
+  if(!bPark)out << ",\"args\":{\"task\":" << event.m_nTaskId << "}";
+
+  out << "}";
+} //WriteEvent
+
+/// Write trace events in Chrome trace event format, which can be viewed in
+/// a browser with `chrome://tracing` or https://ui.perfetto.dev, both of
+/// which load the file locally. Each buffer gets its own row on the
+/// timeline, named "Thread 0", "Thread 1", and so on, except that the last
+/// buffer is named "Manager". Times are in microseconds from the earliest
+/// event. The stream's format flags and precision are restored afterwards.
+/// \param out Output stream.
+/// \param pBuffer Array of trace buffers.
+/// \param n Number of trace buffers.
+
+void WriteChromeTrace(std::ostream& out, const CTraceBuffer* pBuffer, 
+  size_t n)
+{
+  uint64_t t0 = 0; //earliest event time
+  const std::ios_base::fmtflags flags = out.flags(); //caller's format flags
+  const std::streamsize nPrecision = out.precision(); //caller's precision
+
+  for(size_t i=0; i<n; i++)
+    if(pBuffer[i].GetSize() > 0){
+      const uint64_t t = pBuffer[i].GetEvent(0).m_nTime; //earliest in buffer
+      if(t0 == 0 || t < t0)t0 = t;
+    } //if
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+    "\"args\":{\"name\":\"threadplusplus\"}}";
+
+  for(size_t i=0; i<n; i++){ //for each buffer
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" <<
+      i << ",\"args\":{\"name\":\"";
+
+    if(i + 1 == n)out << "Manager";
+    else out << "Thread " << i;
+
+    out << "\"}}";
+
+    for(size_t j=0; j<pBuffer[i].GetSize(); j++)
+      WriteEvent(out, pBuffer[i].GetEvent(j), i, t0);
+  } //for
+
+  out << "\n]}" << std::endl;
+  out.flags(flags);
+  out.precision(nPrecision);
+} //WriteChromeTrace
@@ -0,0 +1,98 @@
+/// \file Trace.h
+/// \brief Interface for the trace event buffer class CTraceBuffer and the
+/// Chrome trace writer.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef __Trace_h__
+#define __Trace_h__
+
+#include <atomic>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+#include "BaseTask.h"
+#include "Timer.h"
+
+/// \brief Trace event type.
+///
+/// The things that can happen to a task descriptor or a thread that are
+/// recorded in a trace. `Enqueue` is when a task becomes ready and is
+/// inserted into the request queue or a deque, `Dequeue` and `Steal` are
+/// when a thread takes it from there or from another thread's deque,
+/// `Begin` and `End` bracket its Perform() function, `Publish` is when it is
+/// inserted into the result queue or a result buffer, and `Process` is
+/// when the thread manager processes its result. `Park` and `Unpark`
+/// bracket the time a thread spends parked.
+
+enum class eTraceEvent{
+  Enqueue, Dequeue, Steal, Begin, End, Publish, Process, Park, Unpark
+}; //eTraceEvent
+
+/// \brief Trace event.
+///
+/// A trace event records what happened, when, and to which task descriptor.
+
+struct CTraceEvent{
+  uint64_t m_nTime = 0; ///< Steady clock time in nanoseconds.
+  size_t m_nTaskId = 0; ///< Task identifier, if any.
+  eTraceEvent m_eType = eTraceEvent::Enqueue; ///< Event type.
+}; //CTraceEvent
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceBuffer definition.
+
+/// \brief Trace event buffer.
+///
+/// A fixed-size buffer of trace events belonging to one thread. Recording
+/// an event claims the next slot with a single atomic increment and then
+/// fills it in, so it never locks or allocates and costs about as much as
+/// reading the clock. The buffer used by the thread manager may be written
+/// by more than one thread, which is why the slot is claimed atomically.
+/// When the buffer is full, further events are counted but not recorded.
+/// The buffer should only be read once the threads that write to it have
+/// stopped. The buffer is padded out to a whole number of cache lines so
+/// that an array of them does not suffer from false sharing.
+
+class CTraceBuffer{
+  private:
+    std::vector<CTraceEvent> m_vEvent; ///< Events.
+    std::atomic<size_t> m_nSize; ///< Number of events, including dropped.
+    char m_pPad[CACHE_LINE_SIZE]; ///< Padding.
+
+  public:
+    CTraceBuffer(); ///< Constructor.
+
+    void SetCapacity(size_t); ///< Set capacity and clear.
+    void Record(eTraceEvent, size_t=0); ///< Record an event.
+
+    const size_t GetSize() const; ///< Get number of events recorded.
+    const size_t GetNumDropped() const; ///< Get number of events dropped.
+    const CTraceEvent& GetEvent(size_t) const; ///< Get an event.
+}; //CTraceBuffer
+
+void WriteChromeTrace(std::ostream&, const CTraceBuffer*, size_t); ///< Write trace.
+
+#endif //__Trace_h__
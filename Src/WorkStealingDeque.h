@@ -0,0 +1,186 @@
+/// \file WorkStealingDeque.h
+/// \brief Interface for the work-stealing deque class CWorkStealingDeque.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef __WorkStealingDeque_h__
+#define __WorkStealingDeque_h__
+
+#include <deque>
+#include <mutex>
+#include <iterator>
+#include <cstddef>
+
+#include "BaseTask.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CWorkStealingDeque definition.
+
+/// \brief Work-stealing deque.
+///
+/// A double-ended queue of task descriptors owned by a single thread. The
+/// owner inserts and deletes at the tail, which is the hot end where the
+/// most recently inserted and most likely cached tasks are. Other threads
+/// that have run out of work steal from the head, which is the cold end.
+/// It uses an `std::mutex` for safety, but since each thread has its own
+/// deque the mutex is almost always uncontended. The deque is padded out to
+/// a whole number of cache lines so that an array of them does not suffer
+/// from false sharing.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+class CWorkStealingDeque{ 
+  private:
+    std::mutex m_stdMutex; ///< Mutex for thread safety.
+    std::deque<CTaskClass> m_stdDeque; ///< The task descriptor deque.
+    char m_pPad[CACHE_LINE_SIZE]; ///< Padding.
+
+  public:
+    void Insert(const CTaskClass& element); ///< Insert task at tail.
+    bool Delete(CTaskClass& element); ///< Delete task from tail.
+    bool Steal(CTaskClass& element); ///< Delete task from head.
+
+    template <class ForwardIt> 
+    void InsertBatch(ForwardIt first, ForwardIt last); ///< Insert many tasks.
+
+    template <class OutputIt> 
+    size_t DeleteUpTo(OutputIt out, size_t n); ///< Delete many tasks.
+    void Flush(); ///< Flush out and discard all tasks in deque.
+}; //CWorkStealingDeque
+
+///////////////////////////////////////////////////////////////////////////////
+// CWorkStealingDeque code.
+
+/// Insert a task descriptor at the tail of the deque.
+/// \tparam CTaskClass Task descriptor.
+/// \param element The element to be inserted into the deque.
+
+template <class CTaskClass>
+void CWorkStealingDeque<CTaskClass>::Insert(const CTaskClass& element){
+  m_stdMutex.lock(); 
+  m_stdDeque.push_back(element); 
+  m_stdMutex.unlock();
+} //Insert
+
+/// Delete and return a task descriptor from the tail of the deque. This is
+/// to be called by the thread that owns the deque.
+/// \tparam CTaskClass Task descriptor.
+/// \param element [OUT] The element deleted from the deque.
+/// \return true if the delete was successful, ie. the deque was not empty.
+
+template <class CTaskClass>
+bool CWorkStealingDeque<CTaskClass>::Delete(CTaskClass& element){
+  bool success = false; //true if there was something to delete
+  
+  m_stdMutex.lock();  
+
+  if(!m_stdDeque.empty()){ //deque has something in it
+    element = m_stdDeque.back(); //get element from tail of deque
+    m_stdDeque.pop_back(); //delete from tail of deque
+    success = true; //success
+  } //if
+  
+  m_stdMutex.unlock();
+
+  return success;
+} //Delete
+
+/// Delete and return a task descriptor from the head of the deque. This is
+/// to be called by threads other than the owner when they run out of work.
+/// \tparam CTaskClass Task descriptor.
+/// \param element [OUT] The element stolen from the deque.
+/// \return true if the steal was successful, ie. the deque was not empty.
+
+template <class CTaskClass>
+bool CWorkStealingDeque<CTaskClass>::Steal(CTaskClass& element){
+  bool success = false; //true if there was something to steal
+  
+  m_stdMutex.lock();  
+
+  if(!m_stdDeque.empty()){ //deque has something in it
+    element = m_stdDeque.front(); //get element from head of deque
+    m_stdDeque.pop_front(); //delete from head of deque
+    success = true; //success
+  } //if
+  
+  m_stdMutex.unlock();
+
+  return success;
+} //Steal
+
+/// Insert a range of task descriptors at the tail of the deque at the cost
+/// of a single lock of the mutex.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam ForwardIt Forward iterator type.
+/// \param first Iterator to the first element to be inserted.
+/// \param last Iterator to one past the last element to be inserted.
+
+template <class CTaskClass>
+template <class ForwardIt> 
+void CWorkStealingDeque<CTaskClass>::InsertBatch(ForwardIt first, 
+  ForwardIt last)
+{
+  m_stdMutex.lock(); 
+  m_stdDeque.insert(m_stdDeque.end(), first, last); 
+  m_stdMutex.unlock();
+} //InsertBatch
+
+/// Delete and return up to a given number of task descriptors from the tail
+/// of the deque at the cost of a single lock of the mutex. This is to be
+/// called by the thread that owns the deque.
+/// \tparam CTaskClass Task descriptor.
+/// \tparam OutputIt Output iterator type.
+/// \param out [OUT] Output iterator that the deleted elements are written to.
+/// \param n Maximum number of elements to delete.
+/// \return Number of elements deleted, which is 0 if the deque was empty.
+
+template <class CTaskClass>
+template <class OutputIt> 
+size_t CWorkStealingDeque<CTaskClass>::DeleteUpTo(OutputIt out, size_t n){
+  size_t count = 0; //number of elements deleted
+  
+  m_stdMutex.lock();  
+
+  while(count < n && !m_stdDeque.empty()){ //deque has something in it
+    *out++ = m_stdDeque.back(); //get element from tail of deque
+    m_stdDeque.pop_back(); //delete from tail of deque
+    count++;
+  } //while
+  
+  m_stdMutex.unlock();
+
+  return count;
+} //DeleteUpTo
+
+/// Flush all task descriptors out of the deque without processing them.
+/// \tparam CTaskClass Task descriptor.
+
+template <class CTaskClass>
+void CWorkStealingDeque<CTaskClass>::Flush(){
+  m_stdMutex.lock();
+  m_stdDeque.clear();
+  m_stdMutex.unlock();
+} //Flush
+
+#endif //__WorkStealingDeque_h__
@@ -0,0 +1,166 @@
+/// \file Check.cpp
+/// \brief Code for running the behavioral checks.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdlib>
+
+#include "Check.h"
+
+static std::atomic<size_t> g_nNumFailed(0); ///< Number of failed checks.
+
+/// \brief A named check.
+
+struct CCheckEntry{
+  const char* m_szName; ///< Name to report.
+  void (*m_pfnCheck)(); ///< Function that performs the check.
+}; //CCheckEntry
+
+/// The checks, in the order that they are run.
+
+static const CCheckEntry g_pCheck[] = {
+  {"Lock-free queue", CheckLockFreeQueue},
+  {"Thread-safe queue", CheckThreadSafeQueue},
+  {"Work stealing", CheckWorkStealing},
+  {"Persistent mode", CheckPersistent},
+  {"Process next", CheckProcessNext},
+  {"Batches", CheckBatches},
+  {"Instances", CheckInstances},
+  {"Task pool", CheckTaskPool},
+  {"Static dispatch", CheckStaticDispatch},
+  {"Futures", CheckFutures},
+  {"Parallel loops", CheckParallelFor},
+  {"Dependencies", CheckDependencies},
+  {"Priority queue", CheckPriorityQueue},
+  {"Affinity", CheckAffinity},
+  {"Elastic", CheckElastic},
+  {"Streaming", CheckStreaming},
+  {"Result buffers", CheckResultBuffers},
+  {"Statistics", CheckStats},
+  {"Timer", CheckTimer},
+  {"Trace", CheckTrace},
+  {"Cancellation", CheckCancellation},
+  {"Timer wheel", CheckTimerWheel},
+  {"Capacity", CheckCapacity},
+  {"Idle policy", CheckIdlePolicy},
+#if defined(__cpp_impl_coroutine) //C++20 coroutines
+  {"Coroutines", CheckCoroutines},
+#endif //defined(__cpp_impl_coroutine)
+}; //g_pCheck
+
+/// Record the outcome of a check, and report it if it failed. This is
+/// called by the CHECK macro.
+/// \param b true if the check passed.
+/// \param szCheck Text of the condition that was checked.
+/// \param szFile Source file that the check is in.
+/// \param nLine Line number of the check.
+
+void Check(bool b, const char* szCheck, const char* szFile, int nLine){
+  if(!b){
+    g_nNumFailed++;
+    std::cout << szFile << "(" << nLine << "): check failed: " << 
+      szCheck << std::endl;
+  } //if
+} //Check
+
+/// Wait until a counter reaches a given value, polling it every
+/// millisecond. If it never does, then the watchdog will catch it.
+/// \param n The counter.
+/// \param k The value to wait for.
+
+void WaitForCount(const std::atomic<size_t>& n, size_t k){
+  while(n < k)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+} //WaitForCount
+
+/// Constructor.
+/// \param p Pointer to the counter to increment when performed, or nullptr.
+/// \param nSleepUs Time to sleep when performed, in microseconds.
+
+CCheckTask::CCheckTask(std::atomic<size_t>* p, size_t nSleepUs): 
+  CBaseTask(), m_pCount(p), m_nSleepUs(nSleepUs){
+} //constructor
+
+/// Perform the task by sleeping, if need be, then incrementing the counter.
+
+void CCheckTask::Perform(){
+  if(m_nSleepUs > 0)
+    std::this_thread::sleep_for(std::chrono::microseconds(m_nSleepUs));
+
+  if(m_pCount)(*m_pCount)++;
+} //Perform
+
+/// Run all of the checks in turn, reporting each one to the standard output.
+/// A watchdog thread gives up on the whole run if any one check takes
+/// longer than a minute, since a check that hangs is a failure too.
+/// \return Number of checks that failed.
+
+int RunChecks(){
+  const std::chrono::seconds timeout(60); //time limit for each check
+  const size_t n = sizeof(g_pCheck)/sizeof(CCheckEntry); //number of checks
+
+  std::mutex stdMutex; //mutex for the watchdog
+  std::condition_variable cvProgress; //signalled after each check
+  size_t nCurrent = 0; //index of the current check
+  size_t nNumFailed = 0; //number of checks that failed
+
+  std::thread watchdog([&](){
+    std::unique_lock<std::mutex> lock(stdMutex);
+
+    while(nCurrent < n){
+      const size_t i = nCurrent; //check being watched
+
+      if(!cvProgress.wait_for(lock, timeout, [&](){return nCurrent != i;})){
+        std::cout << " timed out" << std::endl;
+        std::_Exit(EXIT_FAILURE);
+      } //if
+    } //while
+  }); //watchdog
+
+  for(size_t i=0; i<n; i++){
+    const size_t nFailed = g_nNumFailed; //failures before this check
+    std::cout << g_pCheck[i].m_szName << std::flush;
+    g_pCheck[i].m_pfnCheck();
+    const bool bFailed = g_nNumFailed != nFailed; //did this check fail?
+    std::cout << (bFailed? " FAILED": " ok") << std::endl;
+    if(bFailed)nNumFailed++;
+
+    stdMutex.lock();
+    nCurrent = i + 1;
+    stdMutex.unlock();
+    cvProgress.notify_one();
+  } //for
+
+  watchdog.join();
+
+  std::cout << n << " checks, " << nNumFailed << " failed" << std::endl;
+
+  return (int)nNumFailed;
+} //RunChecks
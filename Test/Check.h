@@ -0,0 +1,157 @@
+/// \file Check.h
+/// \brief Interface for the behavioral checks run by `Test -check`.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#ifndef __Check_h__
+#define __Check_h__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+#include "BaseThreadManager.h"
+
+/// Check a condition, reporting the file and line if it is false.
+
+#define CHECK(b) Check((b), #b, __FILE__, __LINE__)
+
+void Check(bool, const char*, const char*, int); ///< Record a check.
+int RunChecks(); ///< Run all checks.
+void WaitForCount(const std::atomic<size_t>&, size_t); ///< Poll a counter.
+
+///////////////////////////////////////////////////////////////////////////////
+// CCheckTask definition.
+
+/// \brief Check task descriptor.
+///
+/// A task descriptor for the checks, which counts the number of times that
+/// it is performed in a counter shared with other task descriptors, and
+/// optionally sleeps so that it takes long enough for other threads to
+/// notice it.
+
+class CCheckTask: public CBaseTask{
+  private:
+    std::atomic<size_t>* m_pCount = nullptr; ///< Counter to increment.
+    size_t m_nSleepUs = 0; ///< Time to sleep in microseconds.
+
+  public:
+    CCheckTask(std::atomic<size_t>* =nullptr, size_t=0); ///< Constructor.
+
+    virtual void Perform(); ///< Perform the task.
+}; //CCheckTask
+
+///////////////////////////////////////////////////////////////////////////////
+// CCheckManager definition.
+
+/// \brief Check thread manager.
+///
+/// A thread manager for the checks, which counts the task descriptors that
+/// it processes and remembers the order in which it processed them.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CQueueClass=CThreadSafeQueue<CCheckTask*>>
+class CCheckManager: public CBaseThreadManager<CCheckTask, CQueueClass>{
+  private:
+    std::mutex m_stdMutex; ///< Mutex for the processing order.
+    std::vector<size_t> m_vOrder; ///< Task identifiers in processing order.
+
+  protected:
+    void ProcessTask(CCheckTask*); ///< Process the result of a task.
+
+  public:
+    std::atomic<size_t> m_nNumProcessed; ///< Number of results processed.
+
+    CCheckManager(); ///< Constructor.
+
+    std::vector<size_t> GetOrder(); ///< Get the processing order.
+}; //CCheckManager
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks.
+
+void CheckLockFreeQueue(); ///< Check CLockFreeQueue.
+void CheckThreadSafeQueue(); ///< Check CThreadSafeQueue.
+void CheckWorkStealing(); ///< Check work-stealing mode.
+void CheckPersistent(); ///< Check persistent mode.
+void CheckProcessNext(); ///< Check ProcessNext().
+void CheckBatches(); ///< Check batched insertion and deletion.
+void CheckInstances(); ///< Check that thread managers are independent.
+void CheckTaskPool(); ///< Check pooled task descriptors.
+void CheckStaticDispatch(); ///< Check static dispatch.
+void CheckFutures(); ///< Check futures.
+void CheckParallelFor(); ///< Check parallel loops.
+void CheckDependencies(); ///< Check task dependencies.
+void CheckPriorityQueue(); ///< Check CPriorityQueue.
+void CheckAffinity(); ///< Check thread placement.
+void CheckElastic(); ///< Check elastic mode.
+void CheckStreaming(); ///< Check streaming mode.
+void CheckResultBuffers(); ///< Check per-thread result buffers.
+void CheckStats(); ///< Check runtime statistics.
+void CheckTimer(); ///< Check CTimer.
+void CheckTrace(); ///< Check tracing.
+void CheckCancellation(); ///< Check cancellation and shutdown.
+void CheckTimerWheel(); ///< Check delayed and periodic tasks.
+void CheckCapacity(); ///< Check backpressure.
+void CheckIdlePolicy(); ///< Check idle policies.
+
+#if defined(__cpp_impl_coroutine) //C++20 coroutines
+void CheckCoroutines(); ///< Check coroutines.
+#endif //defined(__cpp_impl_coroutine)
+
+///////////////////////////////////////////////////////////////////////////////
+// CCheckManager code.
+
+/// Constructor.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+
+template <class CQueueClass>
+CCheckManager<CQueueClass>::CCheckManager(): m_nNumProcessed(0){
+} //constructor
+
+/// Count the result and record its task identifier.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \param pTask Pointer to a task descriptor.
+
+template <class CQueueClass>
+void CCheckManager<CQueueClass>::ProcessTask(CCheckTask* pTask){
+  m_stdMutex.lock();
+  m_vOrder.push_back(pTask->GetTaskId());
+  m_stdMutex.unlock();
+  m_nNumProcessed++;
+} //ProcessTask
+
+/// Reader function for the processing order.
+/// \tparam CQueueClass Queue of pointers to task descriptors.
+/// \return Task identifiers in the order that they were processed.
+
+template <class CQueueClass>
+std::vector<size_t> CCheckManager<CQueueClass>::GetOrder(){
+  std::lock_guard<std::mutex> lock(m_stdMutex);
+  return m_vOrder;
+} //GetOrder
+
+#endif //__Check_h__
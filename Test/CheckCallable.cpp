@@ -0,0 +1,200 @@
+/// \file CheckCallable.cpp
+/// \brief Code for the behavioral checks of callables and futures.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <future>
+#include <stdexcept>
+#include <functional>
+
+#include "Check.h"
+#include "CallableThreadManager.h"
+#include "ParallelFor.h"
+
+/// \brief Named object.
+///
+/// An object with a member function that returns a reference.
+
+class CNamed{
+  private:
+    std::string m_strName; ///< Name.
+
+  public:
+    CNamed(const std::string&); ///< Constructor.
+    const std::string& GetName() const; ///< Reader function for name.
+}; //CNamed
+
+/// Constructor.
+/// \param s Name.
+
+CNamed::CNamed(const std::string& s): m_strName(s){
+} //constructor
+
+/// Reader function for the name.
+/// \return A reference to the name.
+
+const std::string& CNamed::GetName() const{
+  return m_strName;
+} //GetName
+
+/// Check futures. A future must deliver the value returned by its task, an
+/// exception thrown by it, or nothing for a void task. A task that returns
+/// a reference must deliver a reference to the same object. A task that is
+/// discarded without being performed must fail its future with a broken
+/// promise.
+
+void CheckFutures(){
+  CNamed named("Ian"); //has a reference to return
+  std::atomic<size_t> nCalled(0); //number of void tasks called
+
+  {
+    CCallableThreadManager<> tm; //thread manager
+    tm.SetNumThreads(2);
+
+    CFuture<int> f0 = tm.Submit([](int x){return x*x;}, 7);
+    CFuture<std::string> f1 = tm.Submit([](){return std::string("abc");});
+    CFuture<void> f2 = tm.Submit([&nCalled](){nCalled++;});
+    CFuture<int> f3 = tm.Submit([]() -> int{
+      throw std::runtime_error("oops");});
+    CFuture<const std::string&> f4 = 
+      tm.Submit(&CNamed::GetName, std::cref(named));
+
+    tm.Spawn();
+
+    CHECK(f0.Get() == 49);
+    CHECK(f1.Get() == "abc");
+    f2.Get();
+    CHECK(nCalled == 1);
+
+    bool bThrown = false; //whether the exception came through
+
+    try{
+      f3.Get();
+    } //try
+    catch(const std::runtime_error& e){
+      bThrown = std::string(e.what()) == "oops";
+    } //catch
+
+    CHECK(bThrown);
+
+    const std::string& s = f4.Get(); //reference to the name
+    CHECK(&s == &named.GetName());
+
+    tm.Wait();
+    tm.Process();
+  }
+
+  CFuture<int> f; //future for a task that is never performed
+
+  {
+    CCallableThreadManager<> tm; //never spawned
+    f = tm.Submit([](){return 1;});
+  } //destructor discards the task
+
+  CHECK(f.IsReady());
+
+  bool bBroken = false; //whether the promise was broken
+
+  try{
+    f.Get();
+  } //try
+  catch(const std::future_error& e){
+    bBroken = e.code() == std::future_errc::broken_promise;
+  } //catch
+
+  CHECK(bBroken);
+} //CheckFutures
+
+/// Check ParallelFor() and ParallelReduce(). Every iteration must be
+/// performed exactly once under each chunking policy, a reduction must
+/// combine every result, and an exception thrown by the loop body must be
+/// rethrown to the caller. Parallel loops must also work when called from
+/// two threads at once and when nested inside a task, neither of which may
+/// process the thread manager's results.
+
+void CheckParallelFor(){
+  const int n = 10000; //number of iterations
+  CCallableThreadManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  for(eChunking e: {eChunking::Static, eChunking::Dynamic, 
+    eChunking::Guided, eChunking::Adaptive})
+  {
+    std::vector<int> v(n, 0); //number of times each iteration is performed
+    ParallelFor(tm, 0, n, [&v](int i){v[i]++;}, e, 16);
+
+    size_t nOnce = 0; //number of iterations performed once
+
+    for(int i: v)
+      if(i == 1)nOnce++;
+
+    CHECK(nOnce == n);
+  } //for
+
+  std::vector<size_t> v(n); //values to sum over iterators
+  
+  for(int i=0; i<n; i++)
+    v[i] = i + 1;
+
+  const size_t nSum = ParallelReduce(tm, v.begin(), v.end(), (size_t)0, 
+    [](std::vector<size_t>::iterator it){return *it;}, std::plus<size_t>());
+  
+  CHECK(nSum == (size_t)n*(n + 1)/2);
+
+  bool bThrown = false; //whether the exception came through
+
+  try{
+    ParallelFor(tm, 0, n, [](int i){
+      if(i == n/2)throw std::runtime_error("oops");});
+  } //try
+  catch(const std::runtime_error&){
+    bThrown = true;
+  } //catch
+
+  CHECK(bThrown);
+
+  auto sum = [&tm](){ //sum of indices in a parallel loop
+    return ParallelReduce(tm, 0, n, (size_t)0, 
+      [](int i){return (size_t)i;}, std::plus<size_t>());
+  }; //sum
+
+  CFuture<size_t> f = tm.Submit(sum); //nested inside a task
+  size_t nOther = 0; //sum from another thread
+  std::thread t([&](){nOther = sum();});
+  const size_t nHere = sum(); //sum from this thread
+  t.join();
+
+  CHECK(f.Get() == (size_t)n*(n - 1)/2);
+  CHECK(nOther == (size_t)n*(n - 1)/2);
+  CHECK(nHere == (size_t)n*(n - 1)/2);
+
+  tm.Stop();
+  tm.Process(); //recycle the helpers, from the owner's thread
+} //CheckParallelFor
@@ -0,0 +1,193 @@
+/// \file CheckCoroutine.cpp
+/// \brief Code for the behavioral checks of the coroutines.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#if defined(__cpp_impl_coroutine) //C++20 coroutines
+
+#include <atomic>
+#include <string>
+#include <future>
+#include <stdexcept>
+
+#include "Check.h"
+#include "CallableThreadManager.h"
+
+/// \brief Guard.
+///
+/// An object that counts its own destruction, so that a check can tell
+/// whether a coroutine frame that it lives in has been destroyed.
+
+class CGuard{
+  private:
+    std::atomic<size_t>& m_nDestroyed; ///< Number of guards destroyed.
+
+  public:
+    CGuard(std::atomic<size_t>&); ///< Constructor.
+    ~CGuard(); ///< Destructor.
+}; //CGuard
+
+/// Constructor.
+/// \param n Number of guards destroyed.
+
+CGuard::CGuard(std::atomic<size_t>& n): m_nDestroyed(n){
+} //constructor
+
+/// Destructor.
+
+CGuard::~CGuard(){
+  m_nDestroyed++;
+} //destructor
+
+/// Square a number on a thread.
+/// \param tm Thread manager.
+/// \param x Number to square.
+/// \return The square of x.
+
+static CCoTask<int> Square(CCallableThreadManager<>& tm, int x){
+  co_await tm.Schedule();
+  co_return co_await tm.Submit([](int y){return y*y;}, x);
+} //Square
+
+/// Add one to the square of a number using a nested coroutine.
+/// \param tm Thread manager.
+/// \param x Number to square.
+/// \return One more than the square of x.
+
+static CCoTask<int> SquarePlusOne(CCallableThreadManager<>& tm, int x){
+  co_await tm.Schedule();
+  int y = co_await Square(tm, x);
+  co_return y + 1;
+} //SquarePlusOne
+
+/// Throw an exception from a nested coroutine.
+/// \param tm Thread manager.
+/// \return Nothing, since it throws.
+
+static CCoTask<int> Throw(CCallableThreadManager<>& tm){
+  co_await tm.Schedule();
+  throw std::runtime_error("oops");
+  co_return 0;
+} //Throw
+
+/// Await a coroutine that throws.
+/// \param tm Thread manager.
+/// \return Nothing, since the awaited coroutine throws.
+
+static CCoTask<int> AwaitThrow(CCallableThreadManager<>& tm){
+  int x = co_await Throw(tm);
+  co_return x;
+} //AwaitThrow
+
+/// Wait on a thread, with a guard in the coroutine frame.
+/// \param tm Thread manager.
+/// \param n Number of guards destroyed.
+/// \return 1.
+
+static CCoTask<int> Guarded(CCallableThreadManager<>& tm, 
+  std::atomic<size_t>& n)
+{
+  CGuard guard(n);
+  co_await tm.Schedule();
+  co_return 1;
+} //Guarded
+
+/// Await a guarded coroutine, with a guard in this coroutine frame too.
+/// \param tm Thread manager.
+/// \param n Number of guards destroyed.
+/// \return 2.
+
+static CCoTask<int> AwaitGuarded(CCallableThreadManager<>& tm, 
+  std::atomic<size_t>& n)
+{
+  CGuard guard(n);
+  int x = co_await Guarded(tm, n);
+  co_return x + 1;
+} //AwaitGuarded
+
+/// Check coroutines. A started coroutine must deliver the value computed by
+/// it and the coroutines that it awaits, or an exception thrown by any of
+/// them. A coroutine whose resumption is discarded by the thread manager
+/// must be destroyed along with the coroutines awaiting it, and the future
+/// of the one that was started must fail with a broken promise.
+
+void CheckCoroutines(){
+  std::atomic<size_t> nDestroyed(0); //number of guards destroyed
+
+  {
+    CCallableThreadManager<> tm; //thread manager
+    tm.SetNumThreads(2);
+
+    CFuture<int> f0 = SquarePlusOne(tm, 7).Start();
+    CFuture<int> f1 = AwaitThrow(tm).Start();
+    CFuture<int> f2 = AwaitGuarded(tm, nDestroyed).Start();
+
+    tm.Spawn();
+
+    CHECK(f0.Get() == 50);
+
+    bool bThrown = false; //whether the exception came through
+
+    try{
+      f1.Get();
+    } //try
+    catch(const std::runtime_error& e){
+      bThrown = std::string(e.what()) == "oops";
+    } //catch
+
+    CHECK(bThrown);
+    CHECK(f2.Get() == 2);
+    CHECK(nDestroyed == 2);
+
+    tm.Wait();
+    tm.Process();
+  }
+
+  nDestroyed = 0;
+  CFuture<int> f; //future for a coroutine that is never resumed
+
+  {
+    CCallableThreadManager<> tm; //never spawned
+    f = AwaitGuarded(tm, nDestroyed).Start();
+    CHECK(!f.IsReady());
+    CHECK(nDestroyed == 0);
+  } //destructor discards the resumption
+
+  CHECK(nDestroyed == 2);
+  CHECK(f.IsReady());
+
+  bool bBroken = false; //whether the promise was broken
+
+  try{
+    f.Get();
+  } //try
+  catch(const std::future_error& e){
+    bBroken = e.code() == std::future_errc::broken_promise;
+  } //catch
+
+  CHECK(bBroken);
+} //CheckCoroutines
+
+#endif //defined(__cpp_impl_coroutine)
@@ -0,0 +1,921 @@
+/// \file CheckManager.cpp
+/// \brief Code for the behavioral checks of the thread manager.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#include <set>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+
+#include "Check.h"
+#include "CallableThreadManager.h"
+#include "Timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Dependent task descriptor.
+
+/// \brief Dependent task descriptor.
+///
+/// A task descriptor that records when it was performed relative to the
+/// others, so that the order of dependent tasks can be checked.
+
+class CDagTask: public CBaseTask{
+  public:
+    std::atomic<size_t>* m_pCount = nullptr; ///< Shared sequence counter.
+    size_t m_nSeq = max_size_t; ///< Position in the order performed.
+
+    virtual void Perform(); ///< Perform the task.
+}; //CDagTask
+
+///////////////////////////////////////////////////////////////////////////////
+// Cancellable task descriptor.
+
+/// \brief Cancellable task descriptor.
+///
+/// A task descriptor that runs until a stop is requested, counting when it
+/// starts and when it notices the stop.
+
+class CStopTask: public CBaseTask{
+  public:
+    std::atomic<size_t>* m_pStarted = nullptr; ///< Number started.
+    std::atomic<size_t>* m_pStopped = nullptr; ///< Number stopped.
+
+    virtual void Perform(); ///< Perform the task.
+}; //CStopTask
+
+/// Perform the task by taking the next sequence number.
+
+void CDagTask::Perform(){
+  m_nSeq = (*m_pCount)++;
+} //Perform
+
+/// Perform the task by polling for a stop request.
+
+void CStopTask::Perform(){
+  (*m_pStarted)++;
+
+  while(!StopRequested())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  (*m_pStopped)++;
+} //Perform
+
+/// Check work-stealing mode. A task with many successors makes them all
+/// ready on its own thread's deque at once, so the other threads can only
+/// get at them by stealing.
+
+void CheckWorkStealing(){
+  const size_t n = 200; //number of successors
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(4);
+  tm.SetWorkStealing(true);
+  tm.SetStats(true);
+
+  CCheckTask* pRoot = new CCheckTask(&nPerformed); //task with successors
+  std::vector<CCheckTask*> vSucc; //its successors
+
+  for(size_t i=0; i<n; i++){
+    vSucc.push_back(new CCheckTask(&nPerformed, 200));
+    tm.AddDependency(pRoot, vSucc.back());
+  } //for
+
+  tm.Insert(pRoot);
+  tm.InsertBatch(vSucc.begin(), vSucc.end());
+
+  tm.Spawn();
+  tm.Wait();
+
+  const CWorkerSnapshot total = tm.GetStats().GetTotal(); //all threads
+  tm.Process();
+
+  CHECK(nPerformed == n + 1);
+  CHECK(tm.m_nNumProcessed == n + 1);
+  CHECK(total.m_nTasks == n + 1);
+  CHECK(total.m_nSteals > 0);
+} //CheckWorkStealing
+
+/// Check persistent mode. Threads spawned before anything is inserted must
+/// park between batches instead of exiting, must exit when stopped, and
+/// must be able to be spawned again afterwards.
+
+void CheckPersistent(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetPersistent(true);
+  tm.SetStats(true);
+  tm.Spawn();
+
+  for(size_t i=0; i<50; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  WaitForCount(nPerformed, 50);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20)); //threads park
+
+  CHECK(tm.GetNumLiveThreads() == 2);
+
+  for(size_t i=0; i<50; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Stop();
+
+  CHECK(nPerformed == 100);
+  CHECK(tm.GetStats().GetTotal().m_nIdleNs > 0); //recorded on waking
+  CHECK(tm.GetNumLiveThreads() == 0);
+
+  tm.Spawn(); //same thread manager, new threads
+
+  for(size_t i=0; i<10; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Stop();
+  tm.Process();
+
+  CHECK(nPerformed == 110);
+  CHECK(tm.m_nNumProcessed == 110);
+} //CheckPersistent
+
+/// Check ProcessNext(). It must process each result as it arrives and
+/// return false once they have all been processed, even when a null pointer
+/// has been inserted to tell a thread to exit, since that has no result.
+
+void CheckProcessNext(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+
+  for(size_t i=0; i<5; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Insert(nullptr); //tell a thread to exit
+  tm.Spawn();
+
+  size_t n = 0; //number of results processed
+
+  while(tm.ProcessNext())
+    n++;
+
+  tm.Wait();
+
+  CHECK(n == 5);
+  CHECK(nPerformed == 5);
+  CHECK(!tm.ProcessNextFor(std::chrono::milliseconds(1)));
+} //CheckProcessNext
+
+/// Check batched insertion and deletion. A batch that contains a null
+/// pointer must stop only the thread that takes it. The task descriptors
+/// after the null pointer must still be performed by the other thread, which
+/// must also still be there to perform any that are inserted later.
+
+void CheckBatches(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetBatchSize(16);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  std::vector<CCheckTask*> vTask; //batch with a null pointer in the middle
+
+  for(size_t i=0; i<10; i++)
+    vTask.push_back(new CCheckTask(&nPerformed));
+
+  vTask.insert(vTask.begin() + 5, nullptr);
+  tm.InsertBatch(vTask.begin(), vTask.end());
+  WaitForCount(nPerformed, 10);
+
+  vTask.clear();
+
+  for(size_t i=0; i<10; i++)
+    vTask.push_back(new CCheckTask(&nPerformed));
+
+  tm.InsertBatch(vTask.begin(), vTask.end());
+  WaitForCount(nPerformed, 20);
+
+  tm.Stop();
+
+  size_t n = 0; //number of results processed
+
+  while(tm.ProcessNext())
+    n++;
+
+  CHECK(n == 20);
+} //CheckBatches
+
+/// Check that thread managers are independent. Two of them running at the
+/// same time must each perform and process only their own task descriptors,
+/// and stopping one must not stop the other.
+
+void CheckInstances(){
+  std::atomic<size_t> nPerformed0(0); //tasks performed by first manager
+  std::atomic<size_t> nPerformed1(0); //tasks performed by second manager
+  CCheckManager<> tm0; //first thread manager
+  CCheckManager<> tm1; //second thread manager
+
+  tm0.SetNumThreads(2);
+  tm1.SetNumThreads(2);
+  tm1.SetPersistent(true);
+  tm1.Spawn();
+
+  for(size_t i=0; i<300; i++)
+    tm0.Insert(new CCheckTask(&nPerformed0));
+
+  for(size_t i=0; i<200; i++)
+    tm1.Insert(new CCheckTask(&nPerformed1));
+
+  tm0.Spawn();
+  tm0.Wait();
+  tm0.Process();
+
+  CHECK(nPerformed0 == 300);
+  CHECK(tm0.m_nNumProcessed == 300);
+
+  WaitForCount(nPerformed1, 200);
+
+  for(size_t i=0; i<100; i++) //second is still running
+    tm1.Insert(new CCheckTask(&nPerformed1));
+
+  tm1.Stop();
+  tm1.Process();
+
+  CHECK(nPerformed1 == 300);
+  CHECK(tm1.m_nNumProcessed == 300);
+  CHECK(nPerformed0 == 300);
+} //CheckInstances
+
+/// Check task dependencies. In a layered graph inserted all at once, last
+/// layer first, every task must be performed exactly once and only after
+/// all of its predecessors, both with and without work stealing.
+
+void CheckDependencies(){
+  const size_t nLayers = 5; //number of layers
+  const size_t nWidth = 20; //number of tasks per layer
+
+  for(bool bSteal: {false, true}){
+    std::atomic<size_t> nPerformed(0); //number of tasks performed
+    CBaseThreadManager<CDagTask> tm; //thread manager
+    std::vector<CDagTask*> vTask(nLayers*nWidth); //layer by layer
+
+    tm.SetNumThreads(4);
+    tm.SetWorkStealing(bSteal);
+
+    for(CDagTask*& p: vTask){
+      p = new CDagTask;
+      p->m_pCount = &nPerformed;
+    } //for
+
+    for(size_t k=1; k<nLayers; k++)
+      for(size_t i=0; i<nWidth; i++)
+        for(size_t j: {i, (i + 1)%nWidth, (i + 7)%nWidth})
+          tm.AddDependency(vTask[(k - 1)*nWidth + j], vTask[k*nWidth + i]);
+
+    tm.InsertBatch(vTask.rbegin(), vTask.rend()); //successors first
+    tm.Spawn();
+    tm.Wait();
+
+    CHECK(nPerformed == nLayers*nWidth);
+
+    size_t nBad = 0; //number of tasks performed before a predecessor
+
+    for(size_t k=1; k<nLayers; k++)
+      for(size_t i=0; i<nWidth; i++)
+        for(size_t j: {i, (i + 1)%nWidth, (i + 7)%nWidth})
+          if(vTask[(k - 1)*nWidth + j]->m_nSeq > vTask[k*nWidth + i]->m_nSeq)
+            nBad++;
+
+    CHECK(nBad == 0);
+    tm.Process();
+  } //for
+} //CheckDependencies
+
+/// Check thread placement. The topology must have at least one CPU and one
+/// node. Compact and scatter placement must give each thread one allowed
+/// CPU, using every CPU before using any twice, and per-node placement must
+/// give each thread the CPUs of its node. Threads spawned with a placement
+/// policy must know which node they are on.
+
+void CheckAffinity(){
+  const CTopology topology; //topology of this machine
+  const size_t n = topology.GetNumCpus(); //number of allowed CPUs
+
+  CHECK(n >= 1 && topology.GetNumNodes() >= 1);
+  CHECK(GetNumAvailableCpus() >= 1);
+
+  std::vector<std::vector<size_t>> vCpuSet; //CPUs for each thread
+  std::vector<size_t> vNode; //node for each thread
+
+  topology.Plan(eAffinity::None, 2*n, {}, vCpuSet, vNode);
+
+  CHECK(vCpuSet.size() == 2*n && vCpuSet[0].empty());
+
+  for(eAffinity e: {eAffinity::Compact, eAffinity::Scatter}){
+    topology.Plan(e, 2*n, {}, vCpuSet, vNode);
+
+    std::set<size_t> setCpu; //CPUs used by the first n threads
+    size_t nBad = 0; //number of threads badly placed
+
+    for(size_t i=0; i<2*n; i++){
+      if(vCpuSet[i].size() != 1 || topology.GetNode(vCpuSet[i][0]) != vNode[i])
+        nBad++;
+      else if(i < n)setCpu.insert(vCpuSet[i][0]);
+    } //for
+
+    CHECK(nBad == 0);
+    CHECK(setCpu.size() == n);
+  } //for
+
+  const size_t cpu = vCpuSet[0][0]; //an allowed CPU
+  topology.Plan(eAffinity::Explicit, 3, {cpu}, vCpuSet, vNode);
+
+  CHECK(vCpuSet[2].size() == 1 && vCpuSet[2][0] == cpu);
+
+  topology.Plan(eAffinity::PerNode, 4, {}, vCpuSet, vNode);
+  size_t nBad = 0; //number of CPUs not on their thread's node
+
+  for(size_t i=0; i<4; i++)
+    for(size_t j: vCpuSet[i])
+      if(topology.GetNode(j) != vNode[i])nBad++;
+
+  CHECK(nBad == 0 && !vCpuSet[3].empty());
+
+  //threads placed by a thread manager
+
+  CCallableThreadManager<> tm; //thread manager
+  std::vector<CFuture<size_t>> vFuture; //nodes that tasks ran on
+
+  tm.SetNumThreads(2);
+  tm.SetAffinity(eAffinity::Compact);
+
+  for(size_t i=0; i<20; i++)
+    vFuture.push_back(tm.Submit(GetCurrentNode));
+
+  tm.Spawn();
+  topology.Plan(eAffinity::Compact, 2, {}, vCpuSet, vNode);
+  nBad = 0;
+
+  for(CFuture<size_t>& f: vFuture){
+    const size_t node = f.Get(); //node that the task ran on
+    if(node != vNode[0] && node != vNode[1])nBad++;
+  } //for
+
+  tm.Wait();
+  tm.Process();
+
+  CHECK(nBad == 0);
+} //CheckAffinity
+
+/// Check elastic mode. A deep request queue must make the thread manager
+/// spawn more threads, but no more than the maximum, and the extra threads
+/// must retire once they have been idle for the idle timeout, leaving the
+/// thread manager able to perform tasks inserted later. A thread that exits
+/// because it took a null pointer must no longer be counted as live, so
+/// that a short queue can spawn a thread to replace it.
+
+void CheckElastic(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(0);
+  CHECK(tm.GetNumThreads() == 1); //at least one
+
+  tm.SetElastic(3, std::chrono::milliseconds(20), 
+    std::chrono::milliseconds(1));
+  tm.Spawn();
+
+  size_t nPeak = 0; //most threads live at once
+
+  for(size_t i=0; i<400; i++){ //faster than one thread can keep up
+    tm.Insert(new CCheckTask(&nPerformed, 500));
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    nPeak = std::max(nPeak, tm.GetNumLiveThreads());
+  } //for
+
+  WaitForCount(nPerformed, 400);
+
+  CHECK(nPeak > 1 && nPeak <= 3);
+
+  for(size_t i=0; i<200 && tm.GetNumLiveThreads() > 1; i++) //extras retire
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  CHECK(tm.GetNumLiveThreads() == 1);
+
+  tm.Insert(nullptr); //the last thread exits without retiring
+
+  for(size_t i=0; i<200 && tm.GetNumLiveThreads() > 0; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  CHECK(tm.GetNumLiveThreads() == 0);
+
+  tm.Insert(new CCheckTask(&nPerformed)); //the queue is now deep
+  std::this_thread::sleep_for(std::chrono::milliseconds(5)); //grow delay
+  tm.Insert(new CCheckTask(&nPerformed)); //so a thread is spawned
+
+  WaitForCount(nPerformed, 402);
+
+  for(size_t i=0; i<10; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Stop();
+  tm.Process();
+
+  CHECK(nPerformed == 412);
+  CHECK(tm.m_nNumProcessed == 412);
+} //CheckElastic
+
+/// Check streaming mode. Results must be processed on the consumer thread
+/// while the threads are still running, and stopping streaming mode must
+/// leave nothing behind for Process(), both in persistent mode and when the
+/// threads exit after a batch.
+
+void CheckStreaming(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+
+  {
+    CCheckManager<> tm; //persistent thread manager
+
+    tm.SetNumThreads(2);
+    tm.SetPersistent(true);
+    tm.Spawn();
+    tm.StartStreaming();
+
+    CHECK(tm.IsStreaming());
+
+    for(size_t i=0; i<1000; i++)
+      tm.Insert(new CCheckTask(&nPerformed));
+
+    WaitForCount(tm.m_nNumProcessed, 1000); //threads still running
+
+    CHECK(tm.GetNumLiveThreads() == 2);
+
+    tm.StopStreaming();
+    tm.Stop();
+
+    CHECK(!tm.IsStreaming());
+    CHECK(!tm.ProcessNextFor(std::chrono::milliseconds(1)));
+  }
+
+  CCheckManager<> tm; //thread manager whose threads exit after a batch
+
+  tm.SetNumThreads(2);
+
+  for(size_t i=0; i<1000; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.StartStreaming();
+  tm.Spawn();
+  tm.Wait();
+  tm.StopStreaming();
+  tm.Process(); //nothing left
+
+  CHECK(nPerformed == 2000);
+  CHECK(tm.m_nNumProcessed == 1000);
+} //CheckStreaming
+
+/// Check per-thread result buffers. Every result must be processed exactly
+/// once by Process(), by ProcessNext(), and in streaming mode, and results
+/// collected all at once must be processed in order of task identifier when
+/// asked.
+
+void CheckResultBuffers(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetResultBuffers(true, eResultOrder::TaskId);
+
+  for(size_t i=0; i<500; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process();
+
+  const std::vector<size_t> vOrder = tm.GetOrder(); //order processed
+  bool bInOrder = vOrder.size() == 500; //whether in task identifier order
+
+  for(size_t i=1; i<vOrder.size(); i++)
+    bInOrder = bInOrder && vOrder[i - 1] < vOrder[i];
+
+  CHECK(bInOrder);
+
+  //results as they arrive, one at a time
+
+  tm.SetResultBuffers(true, eResultOrder::PerThread);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  for(size_t i=0; i<500; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  size_t n = 0; //number of results processed
+
+  while(n < 500 && tm.ProcessNext())
+    n++;
+
+  CHECK(n == 500);
+
+  //streaming
+
+  tm.StartStreaming();
+
+  for(size_t i=0; i<500; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  WaitForCount(tm.m_nNumProcessed, 1500);
+  tm.StopStreaming();
+  tm.Stop();
+  tm.Process();
+
+  CHECK(nPerformed == 1500);
+  CHECK(tm.m_nNumProcessed == 1500);
+} //CheckResultBuffers
+
+/// Check the runtime statistics. A histogram must give exact counts, sums,
+/// and maxima, and percentiles that overestimate by less than one part in
+/// CHistogram::SUB_BUCKETS. A thread manager collecting statistics must
+/// count every task performed and every result processed, and must account
+/// for the time that the tasks took.
+
+void CheckStats(){
+  CHistogram h; //histogram of 1 to 1000
+
+  for(uint64_t i=1; i<=1000; i++)
+    h.Insert(i);
+
+  CHECK(h.GetCount() == 1000 && h.GetSum() == 500500 && h.GetMax() == 1000);
+  CHECK(h.GetPercentile(50) >= 500 && 
+    h.GetPercentile(50) <= 500 + 500/CHistogram::SUB_BUCKETS);
+  CHECK(h.GetPercentile(100) == 1000);
+
+  bool bInverse = true; //whether GetLowerBound() inverts GetBucket()
+
+  for(size_t i=0; i<CHistogram::NUM_BUCKETS; i++)
+    bInverse = bInverse && 
+      CHistogram::GetBucket(CHistogram::GetLowerBound(i)) == i;
+
+  CHECK(bInverse);
+
+  h.Merge(h);
+  CHECK(h.GetCount() == 2000 && h.GetSum() == 1001000);
+
+  //statistics from a thread manager
+
+  const size_t n = 100; //number of tasks
+  const uint64_t nSleepUs = 200; //time taken by each task
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetStats(true);
+
+  for(size_t i=0; i<n; i++)
+    tm.Insert(new CCheckTask(&nPerformed, nSleepUs));
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process();
+
+  const CStats stats = tm.GetStats(); //snapshot
+  const CWorkerSnapshot total = stats.GetTotal(); //all threads
+
+  CHECK(stats.m_vWorker.size() == 2);
+  CHECK(total.m_nTasks == n);
+  CHECK(total.m_cExec.GetCount() == n && total.m_cWait.GetCount() == n);
+  CHECK(total.m_cExec.GetPercentile(0) >= nSleepUs*1000);
+  CHECK(total.m_nBusyNs >= n*nSleepUs*1000);
+  CHECK(stats.m_cEndToEnd.GetCount() == n);
+  CHECK(stats.GetImbalance() >= 1.0);
+} //CheckStats
+
+/// Count the occurrences of a string in another string.
+/// \param s String to search.
+/// \param t String to search for.
+/// \return Number of times t occurs in s.
+
+static size_t CountOf(const std::string& s, const std::string& t){
+  size_t n = 0; //number found
+
+  for(size_t i=s.find(t); i!=std::string::npos; i=s.find(t, i + 1))
+    n++;
+
+  return n;
+} //CountOf
+
+/// Check tracing. The trace must have a row for each thread and for the
+/// manager, and must record the insertion, the beginning and end of
+/// Perform(), and the processing of every task. Writing the trace must
+/// leave the stream's number format as it was.
+
+void CheckTrace(){
+  const size_t n = 50; //number of tasks
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetTrace(true);
+
+  for(size_t i=0; i<n; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process();
+
+  std::ostringstream out; //output stream
+  tm.WriteTrace(out);
+  out << 1.5; //in the caller's format
+
+  const std::string s = out.str(); //the trace
+
+  CHECK(CountOf(s, "\"thread_name\"") == 3);
+  CHECK(CountOf(s, "\"Manager\"") == 1);
+  CHECK(CountOf(s, "\"name\":\"Enqueue ") == n);
+  CHECK(CountOf(s, "\"name\":\"Task ") == 2*n);
+  CHECK(CountOf(s, "\"name\":\"Process ") == n);
+  CHECK(s.size() > 4 && s.substr(s.size() - 4) == "\n1.5");
+} //CheckTrace
+
+/// Check cancellation. Drain() must stop tasks that poll for a stop, and
+/// must hand back every task that was not started, each after any that it
+/// depends on. Shutdown() must let the threads finish their tasks if they
+/// can do so in time, and must request a stop if they cannot.
+
+void CheckCancellation(){
+  std::atomic<size_t> nPerformed(0); //number of check tasks performed
+  std::atomic<size_t> nStarted(0); //number of stop tasks started
+  std::atomic<size_t> nStopped(0); //number of stop tasks stopped
+
+  auto stop = [&](){ //new stop task
+    CStopTask* p = new CStopTask;
+    p->m_pStarted = &nStarted;
+    p->m_pStopped = &nStopped;
+    return p;
+  }; //stop
+
+  {
+    CBaseThreadManager<CBaseTask> tm; //thread manager
+
+    tm.SetNumThreads(2);
+    tm.Insert(stop()); //keeps both threads busy
+    tm.Insert(stop());
+
+    CCheckTask* pPred = new CCheckTask(&nPerformed); //predecessor
+    CCheckTask* pSucc = new CCheckTask(&nPerformed); //its successor
+    tm.AddDependency(pPred, pSucc);
+    tm.Insert(pSucc);
+
+    for(size_t i=0; i<100; i++)
+      tm.Insert(new CCheckTask(&nPerformed));
+
+    tm.Insert(pPred);
+    tm.Spawn();
+    WaitForCount(nStarted, 2);
+
+    CHECK(!tm.GetStopToken().StopRequested());
+
+    std::vector<CBaseTask*> vTask; //unstarted tasks
+    const size_t n = tm.Drain(std::back_inserter(vTask));
+
+    CHECK(tm.GetStopToken().StopRequested());
+    CHECK(nStopped == 2 && nPerformed == 0);
+    CHECK(n == 102 && vTask.size() == 102);
+
+    const auto itPred = std::find(vTask.begin(), vTask.end(), pPred);
+    const auto itSucc = std::find(vTask.begin(), vTask.end(), pSucc);
+
+    CHECK(itPred < itSucc && itSucc != vTask.end());
+
+    for(CBaseTask* p: vTask)
+      delete p;
+
+    tm.Process(); //the stop tasks
+  }
+
+  //shut down in time
+
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  for(size_t i=0; i<20; i++)
+    tm.Insert(new CCheckTask(&nPerformed, 100));
+
+  CHECK(tm.Shutdown(std::chrono::seconds(30)));
+  CHECK(nPerformed == 20);
+
+  tm.Process();
+
+  //shut down too late
+
+  typedef std::chrono::steady_clock CClock; //shorthand
+
+  CBaseThreadManager<CBaseTask> tm2; //thread manager
+
+  tm2.SetNumThreads(2);
+  tm2.SetPersistent(true);
+  tm2.Spawn();
+  tm2.Insert(stop());
+  WaitForCount(nStarted, 3);
+
+  const CClock::time_point t0 = CClock::now(); //start time
+  CHECK(!tm2.Shutdown(std::chrono::milliseconds(20)));
+  CHECK(CClock::now() - t0 >= std::chrono::milliseconds(20));
+  CHECK(nStopped == 3);
+
+  tm2.Process();
+} //CheckCancellation
+
+/// Check delayed and periodic tasks. A delayed task must not be performed
+/// before its time, a periodic schedule must keep inserting tasks until it
+/// is cancelled and none afterwards, and Drain() must hand back a task whose
+/// time has not yet come.
+
+void CheckTimerWheel(){
+  typedef std::chrono::steady_clock CClock; //shorthand
+  typedef std::chrono::milliseconds ms; //shorthand
+
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  std::atomic<size_t> nMade(0); //number of periodic tasks made
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(2);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  const CClock::time_point t0 = CClock::now(); //start time
+  tm.InsertAfter(new CCheckTask(&nPerformed), ms(30));
+  tm.InsertAt(new CCheckTask(&nPerformed), t0 + ms(10));
+
+  WaitForCount(nPerformed, 1);
+  CHECK(CClock::now() - t0 >= ms(10));
+
+  WaitForCount(nPerformed, 2);
+  CHECK(CClock::now() - t0 >= ms(30));
+
+  //periodic tasks
+
+  const size_t id = tm.InsertEvery([&](){
+    nMade++;
+    return new CCheckTask(&nPerformed);
+  }, ms(2));
+
+  WaitForCount(nPerformed, 7);
+
+  CHECK(tm.CancelSchedule(id));
+  CHECK(!tm.CancelSchedule(id));
+
+  const size_t n = nMade; //number made before the schedule was cancelled
+  std::this_thread::sleep_for(ms(20));
+
+  CHECK(nMade == n);
+  WaitForCount(nPerformed, n + 2); //everything made has been performed
+
+  //a task that is drained before its time
+
+  CCheckTask* pLate = new CCheckTask(&nPerformed); //task for later
+  tm.InsertAfter(pLate, std::chrono::hours(1));
+
+  std::vector<CCheckTask*> vTask; //unstarted tasks
+  tm.Drain(std::back_inserter(vTask));
+
+  CHECK(vTask.size() == 1 && vTask[0] == pLate);
+
+  delete pLate;
+  tm.Process();
+} //CheckTimerWheel
+
+/// Check backpressure. A producer that is faster than the threads must be
+/// blocked by the `Block` policy and must perform tasks itself under the
+/// `Inline` policy, and TryInsert() must refuse task descriptors when the
+/// request queue is full. Every task descriptor accepted must be performed
+/// and processed.
+
+void CheckCapacity(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+
+  for(eOverflow e: {eOverflow::Block, eOverflow::Inline}){
+    CCheckManager<> tm; //thread manager
+
+    tm.SetNumThreads(2);
+    tm.SetCapacity(4, e);
+    tm.SetPersistent(true);
+    tm.Spawn();
+
+    for(size_t i=0; i<200; i++)
+      tm.Insert(new CCheckTask(&nPerformed, 200));
+
+    tm.Stop();
+    tm.Process();
+
+    const CThrottleSnapshot throttle = tm.GetStats().m_cThrottle; //stats
+
+    if(e == eOverflow::Block)
+      CHECK(throttle.m_nBlocked > 0 && throttle.m_nInline == 0);
+    else CHECK(throttle.m_nInline > 0 && throttle.m_nBlocked == 0);
+
+    CHECK(tm.m_nNumProcessed == 200);
+  } //for
+
+  CHECK(nPerformed == 400);
+
+  //refusing task descriptors
+
+  CCheckManager<> tm; //thread manager
+
+  tm.SetNumThreads(1);
+  tm.SetCapacity(1);
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  size_t nRefused = 0; //number of task descriptors refused
+
+  for(size_t i=0; i<10; i++){
+    CCheckTask* p = new CCheckTask(&nPerformed, 20000);
+
+    if(!tm.TryInsert(p)){
+      delete p;
+      nRefused++;
+    } //if
+  } //for
+
+  tm.Stop();
+  tm.Process();
+
+  CHECK(nRefused > 0);
+  CHECK(tm.GetStats().m_cThrottle.m_nRejected == nRefused);
+  CHECK(nPerformed == 400 + 10 - nRefused);
+} //CheckCapacity
+
+/// Check the idle policies. Under each policy, threads in persistent mode
+/// must pick up bursts of tasks that arrive after they have run out of work,
+/// and must park once they have been idle for a while rather than keep
+/// using CPU time.
+
+void CheckIdlePolicy(){
+  for(eIdle e: {eIdle::Park, eIdle::Spin, eIdle::Adaptive}){
+    std::atomic<size_t> nPerformed(0); //number of tasks performed
+    CCheckManager<> tm; //thread manager
+
+    tm.SetNumThreads(2);
+    tm.SetIdlePolicy(e);
+    tm.SetPersistent(true);
+    tm.SetStats(true);
+    tm.Spawn();
+
+    for(size_t i=0; i<20; i++){ //bursts of tasks with gaps between them
+      for(size_t j=0; j<5; j++)
+        tm.Insert(new CCheckTask(&nPerformed));
+
+      WaitForCount(nPerformed, 5*(i + 1));
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } //for
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10)); //to park
+
+    CTimer timer; //for CPU time while idle
+    timer.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t nCpuNs = timer.GetCPUTimeNs(); //CPU time while idle
+
+    tm.Stop();
+    tm.Process();
+
+    CHECK(tm.m_nNumProcessed == 100);
+    CHECK(nCpuNs < 25000000); //less than half of one CPU
+    CHECK(tm.GetStats().GetTotal().m_nIdleNs > 0);
+  } //for
+} //CheckIdlePolicy
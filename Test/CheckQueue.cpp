@@ -0,0 +1,241 @@
+/// \file CheckQueue.cpp
+/// \brief Code for the behavioral checks of the queues.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <map>
+#include <cstddef>
+
+#include "Check.h"
+#include "LockFreeQueue.h"
+#include "PriorityQueue.h"
+
+/// Check CLockFreeQueue. A small queue must keep its elements in order when
+/// it overflows, must not lose or duplicate any under concurrent use, and
+/// must not block the threads when a thread manager uses it for a result
+/// queue that fills up while the main thread is waiting for them.
+
+void CheckLockFreeQueue(){
+  CLockFreeQueue<size_t> q(4); //small queue that will overflow
+  size_t element = 0; //element deleted from queue
+
+  for(size_t i=0; i<100; i++)
+    q.Insert(i);
+
+  CHECK(!q.TryInsert(100));
+
+  std::vector<size_t> v; //elements deleted from queue
+  CHECK(q.DeleteUpTo(std::back_inserter(v), 10) > 0);
+
+  while(q.Delete(element))
+    v.push_back(element);
+
+  bool bInOrder = v.size() == 100; //whether the elements came out in order
+
+  for(size_t i=0; i<v.size(); i++)
+    bInOrder = bInOrder && v[i] == i;
+
+  CHECK(bInOrder);
+  CHECK(!q.Delete(element));
+
+  //producers and consumers at the same time
+
+  const size_t nThreads = 4; //number of producers and of consumers
+  const size_t n = 20000; //number of elements per producer
+  CLockFreeQueue<size_t> q2(256); //queue shared by all of them
+  std::vector<std::atomic<size_t>> vSeen(nThreads*n); //times each one seen
+  std::atomic<size_t> nDeleted(0); //number of elements deleted
+  std::vector<std::thread> vThread; //producers and consumers
+
+  for(size_t i=0; i<vSeen.size(); i++)
+    vSeen[i] = 0;
+
+  for(size_t t=0; t<nThreads; t++){
+    vThread.push_back(std::thread([&, t](){ //producer
+      for(size_t i=0; i<n; i+=10){
+        std::vector<size_t> vBatch; //batch of elements
+
+        for(size_t j=i; j<i + 10; j++)
+          vBatch.push_back(t*n + j);
+
+        if(i%20 == 0)q2.InsertBatch(vBatch.begin(), vBatch.end());
+        else for(size_t j: vBatch)q2.Insert(j);
+      } //for
+    })); //producer
+
+    vThread.push_back(std::thread([&](){ //consumer
+      size_t j = 0; //element deleted
+
+      while(nDeleted < nThreads*n)
+        if(q2.Delete(j)){
+          vSeen[j]++;
+          nDeleted++;
+        } //if
+        else std::this_thread::yield();
+    })); //consumer
+  } //for
+
+  for(std::thread& t: vThread)
+    t.join();
+
+  bool bOnce = true; //whether each element was deleted exactly once
+
+  for(size_t i=0; i<vSeen.size(); i++)
+    bOnce = bOnce && vSeen[i] == 1;
+
+  CHECK(bOnce);
+
+  //a result queue that fills up while the main thread waits
+
+  const size_t nTasks = 70000; //more than the default capacity
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CCheckManager<CLockFreeQueue<CCheckTask*>> tm; //thread manager
+
+  tm.SetPersistent(true);
+  tm.Spawn();
+
+  for(size_t i=0; i<nTasks; i++)
+    tm.Insert(new CCheckTask(&nPerformed));
+
+  tm.Stop();
+  tm.Process();
+
+  CHECK(nPerformed == nTasks);
+  CHECK(tm.m_nNumProcessed == nTasks);
+} //CheckLockFreeQueue
+
+/// Check the blocking and timed deletes of CThreadSafeQueue. A timed
+/// delete from an empty queue must wait for the timeout and then give up,
+/// and a waiting delete must get an element inserted by another thread.
+
+void CheckThreadSafeQueue(){
+  typedef std::chrono::steady_clock CClock; //shorthand
+
+  CThreadSafeQueue<size_t> q; //queue
+  size_t element = 0; //element deleted from queue
+
+  const CClock::time_point t0 = CClock::now(); //start time
+  CHECK(!q.TryDeleteFor(element, std::chrono::milliseconds(20)));
+  CHECK(CClock::now() - t0 >= std::chrono::milliseconds(20));
+
+  CHECK(!q.TryDeleteUntil(element, CClock::now()));
+
+  std::thread producer([&](){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.Insert(42);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.Insert(43);
+  }); //producer
+
+  q.WaitDelete(element);
+  CHECK(element == 42);
+
+  CHECK(q.TryDeleteFor(element, std::chrono::seconds(10)));
+  CHECK(element == 43);
+
+  producer.join();
+} //CheckThreadSafeQueue
+
+/// Check CPriorityQueue. Task descriptors must come out highest priority
+/// first and in insertion order within a priority, priorities beyond the top
+/// level must share it, and aging must serve the lowest level on every nth
+/// delete. A thread manager with a single thread must perform its tasks in
+/// priority order.
+
+void CheckPriorityQueue(){
+  CPriorityQueue<CCheckTask*, 4> q; //queue with 4 levels
+  std::vector<CCheckTask*> vTask; //task descriptors in insertion order
+  CCheckTask* pTask = nullptr; //task deleted from queue
+
+  for(size_t i=0; i<12; i++){
+    vTask.push_back(new CCheckTask);
+    vTask.back()->SetPriority(i == 11? 10: i%4); //10 shares the top level
+    q.Insert(vTask.back());
+  } //for
+
+  std::vector<CCheckTask*> vOut; //task descriptors in deletion order
+
+  while(q.Delete(pTask))
+    vOut.push_back(pTask);
+
+  const size_t pExpected[] = {3, 7, 11, 2, 6, 10, 1, 5, 9, 0, 4, 8};
+  bool bInOrder = vOut.size() == 12; //whether in the expected order
+
+  for(size_t i=0; i<vOut.size(); i++)
+    bInOrder = bInOrder && vOut[i] == vTask[pExpected[i]];
+
+  CHECK(bInOrder);
+
+  //aging
+
+  q.SetAging(3);
+
+  for(size_t i=0; i<12; i++){ //one low-priority task after the others
+    vTask[i]->SetPriority(i == 11? 0: 3);
+    q.Insert(vTask[i]);
+  } //for
+
+  vOut.clear();
+
+  while(q.Delete(pTask))
+    vOut.push_back(pTask);
+
+  CHECK(vOut.size() == 12 && vOut[2] == vTask[11]);
+
+  for(CCheckTask* p: vTask)
+    delete p;
+
+  //a thread manager with a priority request queue
+
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  std::map<size_t, size_t> mapPriority; //priority for each task identifier
+  CCheckManager<CPriorityQueue<CCheckTask*>> tm; //thread manager
+
+  tm.SetNumThreads(1);
+
+  for(size_t i=0; i<40; i++){
+    CCheckTask* p = new CCheckTask(&nPerformed);
+    p->SetPriority((i*5)%8);
+    mapPriority[p->GetTaskId()] = p->GetPriority();
+    tm.Insert(p);
+  } //for
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process();
+
+  const std::vector<size_t> vOrder = tm.GetOrder(); //order processed
+  bool bByPriority = vOrder.size() == 40; //whether in priority order
+
+  for(size_t i=1; i<vOrder.size(); i++)
+    bByPriority = bByPriority && 
+      mapPriority[vOrder[i - 1]] >= mapPriority[vOrder[i]];
+
+  CHECK(nPerformed == 40);
+  CHECK(bByPriority);
+} //CheckPriorityQueue
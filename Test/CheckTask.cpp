@@ -0,0 +1,181 @@
+/// \file CheckTask.cpp
+/// \brief Code for the behavioral checks of the task descriptors.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+
+#include <set>
+#include <cstddef>
+
+#include "Check.h"
+#include "TaskPool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Pooled task descriptors.
+
+/// \brief Pooled task descriptor.
+///
+/// A task descriptor that is allocated from a CTaskPool.
+
+class CPoolTask: public CBaseTask, public CPooledTask<CPoolTask>{
+  public:
+    std::atomic<size_t>* m_pCount = nullptr; ///< Counter to increment.
+
+    virtual void Perform(); ///< Perform the task.
+}; //CPoolTask
+
+/// \brief Big pooled task descriptor.
+///
+/// A task descriptor derived from a pooled one that is too big for a slot
+/// in its pool, and which counts how many times it has been destroyed.
+
+class CBigPoolTask: public CPoolTask{
+  public:
+    static std::atomic<size_t> m_nNumDestroyed; ///< Number destroyed.
+    char m_pData[4096]; ///< Too big for a slot.
+
+    ~CBigPoolTask(); ///< Destructor.
+}; //CBigPoolTask
+
+std::atomic<size_t> CBigPoolTask::m_nNumDestroyed(0); ///< Number destroyed.
+
+///////////////////////////////////////////////////////////////////////////////
+// Static dispatch.
+
+/// \brief Static task descriptor.
+///
+/// A task descriptor whose Perform() is called directly by the threads.
+
+class CStaticCheckTask final: 
+  public CBaseTask, 
+  public CStaticTask<CStaticCheckTask>
+{
+  public:
+    std::atomic<size_t>* m_pCount = nullptr; ///< Counter to increment.
+
+    void Perform(); ///< Perform the task.
+}; //CStaticCheckTask
+
+/// \brief Static thread manager.
+///
+/// A thread manager whose ProcessTask() is called directly.
+
+class CStaticManager: public CBaseThreadManager<CStaticCheckTask, 
+  CThreadSafeQueue<CStaticCheckTask*>, CStaticManager>
+{
+  public:
+    size_t m_nNumProcessed = 0; ///< Number of results processed.
+
+    void ProcessTask(CStaticCheckTask*); ///< Process the result of a task.
+}; //CStaticManager
+
+/// Perform the task by incrementing the counter.
+
+void CPoolTask::Perform(){
+  if(m_pCount)(*m_pCount)++;
+} //Perform
+
+/// Destructor.
+
+CBigPoolTask::~CBigPoolTask(){
+  m_nNumDestroyed++;
+} //destructor
+
+/// Check pooled task descriptors. Deleted task descriptors must be recycled
+/// by the pool, and a task descriptor of a derived class that is too big
+/// for a slot must be destroyed properly and returned to the heap rather
+/// than to the pool, even when it is deleted through a pointer to the base.
+
+void CheckTaskPool(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  std::set<CPoolTask*> setUsed; //addresses of deleted task descriptors
+  CBaseThreadManager<CPoolTask> tm; //thread manager
+
+  for(size_t i=0; i<1000; i++){
+    CPoolTask* p = new CPoolTask;
+    p->m_pCount = &nPerformed;
+    setUsed.insert(p);
+    tm.Insert(p);
+  } //for
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process(); //deletes them, from this thread
+
+  CHECK(nPerformed == 1000);
+
+  CPoolTask* pRecycled = new CPoolTask; //should reuse a slot
+  CHECK(setUsed.count(pRecycled) == 1);
+  delete pRecycled;
+
+  CPoolTask* pBig = new CBigPoolTask; //too big for a slot
+  CPoolTask* pOld = pBig; //its address
+  delete pBig;
+
+  CHECK(CBigPoolTask::m_nNumDestroyed == 1);
+
+  CPoolTask* pSmall = new CPoolTask; //must not get the big one's memory
+  CHECK(pSmall != pOld);
+  delete pSmall;
+} //CheckTaskPool
+
+/// Perform the task by incrementing the counter.
+
+void CStaticCheckTask::Perform(){
+  if(m_pCount)(*m_pCount)++;
+} //Perform
+
+/// Count the result, which must have been performed by one of the threads.
+/// \param pTask Pointer to a task descriptor.
+
+void CStaticManager::ProcessTask(CStaticCheckTask* pTask){
+  if(pTask->GetThreadId() != max_size_t)
+    m_nNumProcessed++;
+} //ProcessTask
+
+/// Check static dispatch. The threads must call the Perform() of a task
+/// descriptor derived from CStaticTask, and Process() must call the
+/// ProcessTask() of a thread manager that names itself as the third
+/// template parameter, even though neither is reached through the virtual
+/// functions of the base classes.
+
+void CheckStaticDispatch(){
+  std::atomic<size_t> nPerformed(0); //number of tasks performed
+  CStaticManager tm; //thread manager
+
+  tm.SetNumThreads(2);
+
+  for(size_t i=0; i<500; i++){
+    CStaticCheckTask* p = new CStaticCheckTask;
+    p->m_pCount = &nPerformed;
+    tm.Insert(p);
+  } //for
+
+  tm.Spawn();
+  tm.Wait();
+  tm.Process();
+
+  CHECK(nPerformed == 500);
+  CHECK(tm.m_nNumProcessed == 500);
+} //CheckStaticDispatch
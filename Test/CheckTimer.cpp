@@ -0,0 +1,61 @@
+/// \file CheckTimer.cpp
+/// \brief Code for the behavioral checks of the timer.
+
+// MIT License
+//
+// Copyright (c) 2022 Ian Parberry
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include "Check.h"
+#include "Timer.h"
+
+/// Check CTimer. Elapsed time must include time spent sleeping, which must
+/// not count as CPU time, and a thread that spins must use CPU time no
+/// faster than time elapses, all of which must count towards the CPU time
+/// of the process.
+
+void CheckTimer(){
+  const uint64_t ms = 1000000; //nanoseconds in a millisecond
+  CTimer timer; //timer
+
+  timer.Start();
+  const uint64_t nThread0 = CTimer::GetThreadCPUTimeNs(); //thread CPU time
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  const uint64_t nSleep = timer.GetElapsedTimeNs(); //time while sleeping
+  CHECK(nSleep >= 20*ms);
+  CHECK(CTimer::GetThreadCPUTimeNs() - nThread0 < nSleep);
+
+  timer.Start();
+  const uint64_t nThread1 = CTimer::GetThreadCPUTimeNs(); //thread CPU time
+
+  while(CTimer::GetThreadCPUTimeNs() - nThread1 < 10*ms); //spin
+
+  const uint64_t nSpin = CTimer::GetThreadCPUTimeNs() - nThread1; //CPU time
+  CHECK(timer.GetElapsedTimeNs() >= nSpin);
+  CHECK(timer.GetCPUTimeNs() >= 10*ms);
+  CHECK(timer.GetParallelEfficiency(1) > 0.0);
+  CHECK(!timer.GetElapsedTime().empty() && !timer.GetCPUTime().empty());
+} //CheckTimer
@@ -24,10 +24,12 @@
 // DEALINGS IN THE SOFTWARE.
 
 #include <iostream>
+#include <string>
 
 #include "ThreadManager.h"
 #include "Task.h"
 #include "Timer.h"
+#include "Check.h"
 
 /// \brief Main.
 ///
@@ -35,10 +37,17 @@
 /// thread manager. Start the timer. Report current data and time, and the
 /// number of available threads. Spawn the threads and wait for them to
 /// terminate. Use the timer to report current time, elapsed time, and
-/// CPU time, then have the thread manager process the results.
-/// \return 0 (What could possibly go wrong?)
+/// CPU time, then have the thread manager process the results. If the
+/// command line includes `-check`, then run the behavioral checks instead.
+/// \param argc Number of command line arguments.
+/// \param argv Command line arguments.
+/// \return 0, or 1 if any of the checks failed.
+
+int main(int argc, char* argv[]){
+  for(int i=1; i<argc; i++)
+    if(std::string(argv[i]) == "-check")
+      return RunChecks() > 0? 1: 0;
 
-int main(){
   CThreadManager* pThreadManager = new CThreadManager; //thread manager
   CTimer* pTimer = new CTimer; //timer for elapsed and CPU time
 